@@ -27,23 +27,53 @@
 #if ENABLE_THREADS
 # if !__STDC_NO_THREADS__
 #  include <threads.h>
+#  include <stdatomic.h>
 # else
 #  error "Can't compile the SurgeScript CLI: threads.h is not found on this environment. Please change the environment or disable multithreading."
 # endif
 #endif
 
-static surgescript_vm_t* make_vm(int argc, char** argv, uint64_t* time_limit);
+/* command-line options */
+typedef struct options_t options_t;
+struct options_t
+{
+    uint64_t time_limit; /* in milliseconds */
+    int instances; /* number of independent VMs */
+    int threads; /* number of worker threads of the worker pool */
+    const char* output; /* if not NULL, compile the scripts to this bytecode file instead of running them */
+    const char* cache_directory; /* if not NULL, the directory of the compile cache */
+};
+
+/* a set of VMs that run concurrently */
+typedef struct worker_task_t worker_task_t;
+struct worker_task_t
+{
+    surgescript_workerpool_t* pool;
+#if ENABLE_THREADS
+    atomic_bool done;
+#endif
+};
+
+static surgescript_vm_t** make_vms(int argc, char** argv, options_t* options);
+static surgescript_vm_t* make_vm(int argc, char** argv, int first_arg, const char* code, const options_t* options, surgescript_vm_t* model);
 static void run_vm(surgescript_vm_t* vm, uint64_t time_limit);
+static void run_vms(surgescript_vm_t** vms, int count, int num_threads, uint64_t time_limit);
 static void destroy_vm(surgescript_vm_t* vm);
+static int compile_scripts(surgescript_vm_t* vm, int argc, char** argv, int first_arg, const char* code, const options_t* options);
+static bool compile_to_bytecode(int argc, char** argv, int first_arg, const char* code, const options_t* options);
+static bool is_bytecode(const char* filepath);
 static void print_to_stdout(const char* message);
 static void print_to_stderr(const char* message);
 static void discard_message(const char* message);
 static void show_help(const char* executable);
 static char* read_from_stdin();
 static int main_loop(void* arg);
+static int workers_loop(void* arg);
 
 /* default time limit, given in milliseconds */
 #define DEFAULT_TIME_LIMIT 30000
+#define show_time_limit_error() \
+    fprintf(stderr, "Time limit of %.1lf seconds exceeded.\n", (double)time_limit * 0.001)
 
 /*
  * main()
@@ -51,18 +81,23 @@ static int main_loop(void* arg);
  */
 int main(int argc, char* argv[])
 {
-    uint64_t time_limit = DEFAULT_TIME_LIMIT;
-
-    /* Create the VM and compile the input file(s) */
-    surgescript_vm_t* vm = make_vm(argc, argv, &time_limit);
-
-    /* got a VM? */
-    if(vm != NULL) {
-        /* run the VM */
-        run_vm(vm, time_limit);
-
-        /* destroy the VM */
-        destroy_vm(vm);
+    options_t options = { DEFAULT_TIME_LIMIT, 1, 0, NULL, NULL };
+
+    /* Create the VM(s) and compile the input file(s) */
+    surgescript_vm_t** vms = make_vms(argc, argv, &options);
+
+    /* got VMs? */
+    if(vms != NULL) {
+        /* run the VM(s) */
+        if(options.instances == 1)
+            run_vm(vms[0], options.time_limit);
+        else
+            run_vms(vms, options.instances, options.threads, options.time_limit);
+
+        /* destroy the VM(s) */
+        for(int i = 0; i < options.instances; i++)
+            destroy_vm(vms[i]);
+        ssfree(vms);
     }
 
     /* done! */
@@ -76,8 +111,6 @@ int main(int argc, char* argv[])
 void run_vm(surgescript_vm_t* vm, uint64_t time_limit)
 {
     uint64_t start_time = surgescript_util_gettickcount();
-    #define show_time_limit_error() \
-        fprintf(stderr, "Time limit of %.1lf seconds exceeded.\n", (double)time_limit * 0.001)
 
 #if !ENABLE_THREADS
 
@@ -117,6 +150,61 @@ void run_vm(surgescript_vm_t* vm, uint64_t time_limit)
 
 }
 
+/**
+ * run_vms()
+ * Run multiple independent VMs on a worker pool with a time limit
+ */
+void run_vms(surgescript_vm_t** vms, int count, int num_threads, uint64_t time_limit)
+{
+    uint64_t start_time = surgescript_util_gettickcount();
+    worker_task_t task;
+
+    /* create the worker pool */
+    task.pool = surgescript_workerpool_create(num_threads);
+    for(int i = 0; i < count; i++)
+        surgescript_workerpool_add(task.pool, vms[i]);
+
+#if !ENABLE_THREADS
+
+    /* main loop */
+    while(surgescript_workerpool_update(task.pool) > 0) {
+
+        /* time limit */
+        if(time_limit > 0 && surgescript_util_gettickcount() > start_time + time_limit) {
+            show_time_limit_error();
+            break;
+        }
+
+    }
+
+#else
+
+    /* step the worker pool on a separate thread */
+    thrd_t thread;
+    atomic_init(&task.done, false);
+    thrd_create(&thread, workers_loop, &task);
+
+    /* handle the time limit, if it's been set */
+    if(time_limit > 0) {
+        while(!atomic_load(&task.done)) {
+            if(surgescript_util_gettickcount() > start_time + time_limit) {
+                show_time_limit_error();
+                exit(1); /* a VM may be stuck in the middle of a frame */
+            }
+
+            thrd_sleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+        }
+    }
+
+    /* wait for the other thread to complete */
+    thrd_join(thread, NULL);
+
+#endif
+
+    /* destroy the worker pool */
+    surgescript_workerpool_destroy(task.pool);
+}
+
 /**
  * destroy_vm()
  * Destroy a SurgeScript VM
@@ -150,14 +238,39 @@ int main_loop(void* arg)
 #endif
 }
 
+/**
+ * workers_loop()
+ * Steps the worker pool until all VMs are done (multithreaded execution)
+ */
+int workers_loop(void* arg)
+{
+#if !ENABLE_THREADS
+
+    (void)arg;
+    return 0;
+
+#else
+
+    worker_task_t* task = (worker_task_t*)arg;
+
+    while(surgescript_workerpool_update(task->pool) > 0)
+        ;
+
+    atomic_store(&task->done, true);
+    return 0;
+
+#endif
+}
+
 /*
- * make_vm()
- * Parses the command line arguments and creates a VM
- * with the compiled scripts
+ * make_vms()
+ * Parses the command line arguments and creates
+ * options->instances VMs with the compiled scripts
  */
-surgescript_vm_t* make_vm(int argc, char** argv, uint64_t* time_limit)
+surgescript_vm_t** make_vms(int argc, char** argv, options_t* options)
 {
-    surgescript_vm_t* vm = NULL;
+    surgescript_vm_t** vms = NULL;
+    char* code = NULL;
     int i;
 
     /* disable debugging */
@@ -182,11 +295,31 @@ surgescript_vm_t* make_vm(int argc, char** argv, uint64_t* time_limit)
         }
         else if(strcmp(arg, "--timelimit") == 0 || strcmp(arg, "-t") == 0) {
             /* set time limit (maximum execution time) */
-            if(++i < argc && time_limit != NULL) {
+            if(++i < argc) {
                 double seconds = atof(argv[i]);
-                *time_limit = (seconds > 0.0) ? (uint64_t)(seconds * 1000.0) : 0;
+                options->time_limit = (seconds > 0.0) ? (uint64_t)(seconds * 1000.0) : 0;
             }
         }
+        else if(strcmp(arg, "--instances") == 0 || strcmp(arg, "-n") == 0) {
+            /* run multiple independent instances of the scripts */
+            if(++i < argc)
+                options->instances = ssmax(1, atoi(argv[i]));
+        }
+        else if(strcmp(arg, "--threads") == 0 || strcmp(arg, "-j") == 0) {
+            /* number of worker threads */
+            if(++i < argc)
+                options->threads = ssmax(0, atoi(argv[i]));
+        }
+        else if(strcmp(arg, "--compile") == 0 || strcmp(arg, "-c") == 0) {
+            /* compile the scripts to bytecode */
+            if(++i < argc)
+                options->output = argv[i];
+        }
+        else if(strcmp(arg, "--cache") == 0 || strcmp(arg, "-C") == 0) {
+            /* use a compile cache */
+            if(++i < argc)
+                options->cache_directory = argv[i];
+        }
         else if(strcmp(arg, "--") == 0) {
             /* user-specific command line arguments */
             break;
@@ -198,23 +331,50 @@ surgescript_vm_t* make_vm(int argc, char** argv, uint64_t* time_limit)
         }
     }
 
+    /* no files given? read the code from stdin */
+    if(!(i < argc && strcmp(argv[i], "--") != 0))
+        code = read_from_stdin();
+
+    /* compile the scripts to bytecode without running them */
+    if(options->output != NULL) {
+        if(!compile_to_bytecode(argc, argv, i, code, options))
+            fprintf(stderr, "Can't write bytecode to \"%s\".\n", options->output);
+        if(code != NULL)
+            ssfree(code);
+        return NULL;
+    }
+
+    /* create the VMs (the scripts are compiled only once) */
+    vms = ssmalloc(options->instances * sizeof(*vms));
+    for(int j = 0; j < options->instances; j++)
+        vms[j] = make_vm(argc, argv, i, code, options, j > 0 ? vms[0] : NULL);
+
+    /* done! */
+    if(code != NULL)
+        ssfree(code);
+    return vms;
+}
+
+/*
+ * make_vm()
+ * Creates a VM with the scripts given in the command line arguments,
+ * starting at argv[first_arg], or with the given code if it's not NULL.
+ * If model isn't NULL, the new VM shares its compiled scripts instead
+ */
+surgescript_vm_t* make_vm(int argc, char** argv, int first_arg, const char* code, const options_t* options, surgescript_vm_t* model)
+{
     /* create an empty VM */
-    vm = surgescript_vm_create();
+    surgescript_vm_t* vm = model ? surgescript_vm_create_shared(model) : surgescript_vm_create();
+    int i = first_arg;
 
     /* compile the scripts */
-    if(i < argc && strcmp(argv[i], "--") != 0) {
-        /* read files */
-        for(; i < argc && strcmp(argv[i], "--") != 0; i++) {
-            const char* file = argv[i];
-            surgescript_vm_compile(vm, file);
-        }
-    }
-    else {
-        /* read from stdin */
-        char* code = read_from_stdin();
-        surgescript_vm_compile_code_in_memory(vm, code);
-        ssfree(code);
+    if(model != NULL) {
+        /* already compiled */
+        while(i < argc && strcmp(argv[i], "--") != 0)
+            i++;
     }
+    else
+        i = compile_scripts(vm, argc, argv, first_arg, code, options);
 
     /* launch the VM */
     if(i < argc && strcmp(argv[i], "--") == 0) {
@@ -231,6 +391,76 @@ surgescript_vm_t* make_vm(int argc, char** argv, uint64_t* time_limit)
     return vm;
 }
 
+/*
+ * compile_scripts()
+ * Compiles the scripts given in the command line arguments, starting at
+ * argv[first_arg], or the given code if it's not NULL. Files with the
+ * bytecode extension are loaded without being parsed, and so are files
+ * found in the compile cache, if it's enabled. Returns the index
+ * of the first argument after the scripts
+ */
+int compile_scripts(surgescript_vm_t* vm, int argc, char** argv, int first_arg, const char* code, const options_t* options)
+{
+    int i = first_arg;
+
+    /* use the compile cache */
+    if(options->cache_directory != NULL)
+        surgescript_parser_set_cache_directory(surgescript_vm_parser(vm), options->cache_directory);
+
+    if(code == NULL) {
+        /* read files. Consecutive scripts are compiled together on multiple threads */
+        while(i < argc && strcmp(argv[i], "--") != 0) {
+            const char* file = argv[i];
+            int count = 0;
+
+            if(is_bytecode(file)) {
+                if(!surgescript_vm_load_bytecode(vm, file))
+                    fprintf(stderr, "Can't load \"%s\": invalid, incompatible or conflicting bytecode. Please compile the scripts again.\n", file);
+                i++;
+                continue;
+            }
+
+            while(i + count < argc && strcmp(argv[i + count], "--") != 0 && !is_bytecode(argv[i + count]))
+                count++;
+
+            surgescript_vm_compile_batch(vm, (const char**)(argv + i), count, options->threads);
+            i += count;
+        }
+    }
+    else {
+        /* compile code read from stdin */
+        surgescript_vm_compile_code_in_memory(vm, code);
+    }
+
+    return i;
+}
+
+/*
+ * compile_to_bytecode()
+ * Compiles the scripts and saves the bytecode to the output file
+ */
+bool compile_to_bytecode(int argc, char** argv, int first_arg, const char* code, const options_t* options)
+{
+    surgescript_vm_t* vm = surgescript_vm_create();
+    bool success;
+
+    compile_scripts(vm, argc, argv, first_arg, code, options);
+    success = surgescript_vm_save_bytecode(vm, options->output);
+    surgescript_vm_destroy(vm);
+
+    return success;
+}
+
+/*
+ * is_bytecode()
+ * Checks if a file is precompiled bytecode, given its extension
+ */
+bool is_bytecode(const char* filepath)
+{
+    const char* extension = strrchr(filepath, '.');
+    return extension != NULL && strcmp(extension, SURGESCRIPT_BYTECODE_EXTENSION) == 0;
+}
+
 /*
  * show_help()
  * Shows a help message
@@ -249,6 +479,10 @@ void show_help(const char* executable)
         "    -v, --version                         shows the version of SurgeScript\n"
         "    -D, --debug                           prints debugging information\n"
         "    -t, --timelimit                       sets a maximum execution time, in seconds (0 = no limit)\n"
+        "    -n, --instances                       runs multiple independent instances of the script(s) concurrently\n"
+        "    -j, --threads                         sets the number of worker threads used to compile and by --instances (0 = one per CPU core)\n"
+        "    -c, --compile <file.ssc>              compiles the script(s) to a bytecode file instead of running them\n"
+        "    -C, --cache <directory>               caches the compiled scripts in a directory, skipping the compilation of unchanged files\n"
         "    -h, --help                            shows this message\n"
         "\n"
         "Examples:\n"
@@ -257,6 +491,10 @@ void show_help(const char* executable)
         "    %s --debug test.ss           compiles and runs test.ss with debugging information\n"
         "    %s file.ss -- -x -y          passes custom arguments -x and -y to file.ss\n"
         "    %s -t 5                      runs a script read from stdin, with a time limit of 5 seconds\n"
+        "    %s -n 100 -j 8 sim.ss        runs 100 instances of sim.ss on 8 threads\n"
+        "    %s -c game.ssc *.ss          compiles all scripts to game.ssc\n"
+        "    %s game.ssc                  executes the precompiled scripts of game.ssc\n"
+        "    %s -C .sscache *.ss          compiles unchanged scripts only once\n"
         "\n"
         "Full documentation available at: <%s>\n",
         surgescript_util_version(),
@@ -269,6 +507,10 @@ void show_help(const char* executable)
         executable,
         executable,
         executable,
+        executable,
+        executable,
+        executable,
+        executable,
         surgescript_util_website()
     );
 }
@@ -33,10 +33,13 @@ extern "C" {
 #include "surgescript/runtime/object_manager.h"
 #include "surgescript/runtime/tag_system.h"
 #include "surgescript/runtime/vm_time.h"
+#include "surgescript/runtime/worker_pool.h"
 #include "surgescript/runtime/heap.h"
 #include "surgescript/runtime/stack.h"
 #include "surgescript/runtime/variable.h"
 #include "surgescript/compiler/parser.h"
+#include "surgescript/compiler/bytecode.h"
+#include "surgescript/compiler/batch.h"
 #include "surgescript/util/transform.h"
 #include "surgescript/util/ssarray.h"
 #include "surgescript/util/util.h"
@@ -21,11 +21,14 @@
 
 #include <ctype.h>
 #include <string.h>
+#include <math.h>
 #include "asm.h"
 #include "symtable.h"
 #include "../runtime/program.h"
 #include "../runtime/program_pool.h"
 #include "../runtime/object_manager.h"
+#include "../runtime/variable.h"
+#include "../runtime/sslib/sslib.h"
 #include "../util/util.h"
 
 #ifdef F
@@ -61,6 +64,25 @@
 #define T3                              U(3)
 #define BREAKPOINT(str)                 emit_breakpoint(context, (str))
 
+/* constant folding */
+static bool fold_unary(surgescript_nodecontext_t context, char op);
+static bool fold_binary(surgescript_nodecontext_t context, char op);
+static bool fold_math_getter(surgescript_nodecontext_t context, const char* getter_name);
+static bool fold_math_call(surgescript_nodecontext_t context, int num_params);
+static bool read_constant(surgescript_nodecontext_t context, int line, surgescript_var_t* value);
+static void emit_constant(surgescript_nodecontext_t context, int line, const surgescript_var_t* value);
+static bool is_line(surgescript_nodecontext_t context, int line, surgescript_program_operator_t op, unsigned a);
+static bool has_labels(surgescript_nodecontext_t context, int first_line, int last_line);
+#define NULLVAR                         { .raw = 0, .type = SSVAR_NULL } /* an inline null variable */
+
+/* hot reload */
+static void emit_layout_entry(const char* symbol, surgescript_heapptr_t address, void* context);
+
+/* expression temporaries */
+static void spill(surgescript_nodecontext_t context);
+static void fill(surgescript_nodecontext_t context);
+static int relocate_temporaries(surgescript_nodecontext_t context, int first_line, int num_locals);
+
 
 /* objects */
 void emit_object_header(surgescript_nodecontext_t context, surgescript_program_label_t start, surgescript_program_label_t end)
@@ -104,6 +126,29 @@ void emit_varsetter(surgescript_nodecontext_t context, const char* identifier)
     SSASM(SSOP_RET);
 }
 
+/* hot reload */
+void emit_object_layout(surgescript_nodecontext_t context)
+{
+    /* for each variable: its name, followed by a read of its address */
+    surgescript_symtable_foreach_heap_symbol(context.symtable, &context, emit_layout_entry);
+    SSASM(SSOP_RET);
+}
+
+void emit_varinit1(surgescript_nodecontext_t context, const char* identifier, surgescript_program_label_t next)
+{
+    SSASM(SSOP_SPEEK, T1, I(-1)); /* t1 is the name of the variable to be initialized */
+    SSASM(SSOP_MOVS, T0, TEXT(identifier));
+    SSASM(SSOP_CMP, T1, T0);
+    SSASM(SSOP_JNE, U(next));
+}
+
+void emit_varinit2(surgescript_nodecontext_t context, const char* identifier, surgescript_program_label_t next)
+{
+    surgescript_symtable_emit_write(context.symtable, identifier, context.program, 0);
+    SSASM(SSOP_RET);
+    LABEL(next);
+}
+
 /* expressions */
 void emit_assignexpr(surgescript_nodecontext_t context, const char* assignop, const char* identifier, int line)
 {
@@ -209,14 +254,14 @@ void emit_logicalandexpr2(surgescript_nodecontext_t context, surgescript_program
 
 void emit_equalityexpr1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_PUSH, T0);
+    spill(context);
 }
 
 void emit_equalityexpr2(surgescript_nodecontext_t context, const char* equalityop)
 {
     surgescript_program_label_t done = NEWLABEL();
 
-    SSASM(SSOP_POP, T1);
+    fill(context);
     if(strcmp(equalityop, "==") == 0) {
         SSASM(SSOP_CMP, T1, T0);
         SSASM(SSOP_LNOT, T0, T2);
@@ -250,14 +295,14 @@ void emit_equalityexpr2(surgescript_nodecontext_t context, const char* equalityo
 
 void emit_relationalexpr1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_PUSH, T0);
+    spill(context);
 }
 
 void emit_relationalexpr2(surgescript_nodecontext_t context, const char* relationalop)
 {
     surgescript_program_label_t done = NEWLABEL();
 
-    SSASM(SSOP_POP, T1);
+    fill(context);
     SSASM(SSOP_CMP, T1, T0);
     SSASM(SSOP_MOVB, T0, B(true));
     if(strcmp(relationalop, ">=") == 0) {
@@ -281,12 +326,15 @@ void emit_relationalexpr2(surgescript_nodecontext_t context, const char* relatio
 
 void emit_additiveexpr1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_PUSH, T0);
+    spill(context);
 }
 
 void emit_additiveexpr2(surgescript_nodecontext_t context, const char* additiveop)
 {
-    SSASM(SSOP_POP, T1);
+    if(fold_binary(context, *additiveop))
+        return;
+
+    fill(context);
     switch(*additiveop) {
         case '+': {
             surgescript_program_label_t cat = NEWLABEL();
@@ -319,12 +367,15 @@ void emit_additiveexpr2(surgescript_nodecontext_t context, const char* additiveo
 
 void emit_multiplicativeexpr1(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_PUSH, T0);
+    spill(context);
 }
 
 void emit_multiplicativeexpr2(surgescript_nodecontext_t context, const char* multiplicativeop)
 {
-    SSASM(SSOP_POP, T1);
+    if(fold_binary(context, *multiplicativeop))
+        return;
+
+    fill(context);
     switch(*multiplicativeop) {
         case '*':
             SSASM(SSOP_MUL, T0, T1);
@@ -348,7 +399,7 @@ void emit_multiplicativeexpr2(surgescript_nodecontext_t context, const char* mul
 
 void emit_unarysign(surgescript_nodecontext_t context, const char* op)
 {
-    if(*op == '-')
+    if(*op == '-' && !fold_unary(context, *op))
         SSASM(SSOP_NEG, T0, T0);
 }
 
@@ -368,7 +419,8 @@ void emit_unaryincdec(surgescript_nodecontext_t context, const char* op, const c
 
 void emit_unarynot(surgescript_nodecontext_t context)
 {
-    SSASM(SSOP_LNOT, T0, T0);
+    if(!fold_unary(context, '!'))
+        SSASM(SSOP_LNOT, T0, T0);
 }
 
 void emit_unarytype(surgescript_nodecontext_t context)
@@ -430,7 +482,8 @@ void emit_pushparam(surgescript_nodecontext_t context)
 
 void emit_popparams(surgescript_nodecontext_t context, int n)
 {
-    SSASM(SSOP_POPN, U(n));
+    if(!fold_math_call(context, n - 1))
+        SSASM(SSOP_POPN, U(n));
 }
 
 void emit_funcall(surgescript_nodecontext_t context, const char* fun_name, int num_params)
@@ -543,9 +596,11 @@ void emit_getter(surgescript_nodecontext_t context, const char* property_name)
 {
     char* getter_name = surgescript_util_accessorfun("get", property_name);
 
-    SSASM(SSOP_PUSH, T0); /* object pointer */
-    SSASM(SSOP_CALL, TEXT(getter_name), U(0));
-    SSASM(SSOP_POPN, U(1));
+    if(!fold_math_getter(context, getter_name)) {
+        SSASM(SSOP_PUSH, T0); /* object pointer */
+        SSASM(SSOP_CALL, TEXT(getter_name), U(0));
+        SSASM(SSOP_POPN, U(1));
+    }
 
     ssfree(getter_name);
 }
@@ -838,8 +893,10 @@ int emit_function_header(surgescript_nodecontext_t context)
 
 void emit_function_footer(surgescript_nodecontext_t context, int num_locals, int fun_header)
 {
-    if(num_locals > 0)
-        surgescript_program_chg_line(context.program, fun_header, SSOP_PUSHN, U(num_locals), U(0));
+    int num_temps = relocate_temporaries(context, fun_header, num_locals);
+
+    if(num_locals + num_temps > 0)
+        surgescript_program_chg_line(context.program, fun_header, SSOP_PUSHN, U(num_locals + num_temps), U(0));
     SSASM(SSOP_MOVN, T0); /* return null */
     /*SSASM(SSOP_POPN, U(num_locals));*/ /* not needed, since popenv() clears the stack frame for us */
     SSASM(SSOP_RET);
@@ -927,4 +984,300 @@ void emit_nop(surgescript_nodecontext_t context)
 void emit_breakpoint(surgescript_nodecontext_t context, const char* text)
 {
     SSASM(SSOP_NOP, I(-1), TEXT(text));
-}
\ No newline at end of file
+}
+
+
+
+/* -------------------------------
+ * expression temporaries
+ * ------------------------------- */
+
+/*
+ * The left operand of a binary expression is kept in a temporary while its
+ * right operand is evaluated. In functions and states, the temporaries are
+ * slots of the stack frame: the k-th one is addressed directly by sswap,
+ * which moves variables without copying them. Elsewhere, they're pushed
+ * onto the stack. The parser numbers the temporaries by nesting depth (see
+ * rightoperand()), and emit_function_footer() places them after the local
+ * variables once the number of locals is known.
+ */
+
+/* keeps the left operand of a binary expression, held in t0, in a temporary */
+void spill(surgescript_nodecontext_t context)
+{
+    if(context.temp >= 0)
+        SSASM(SSOP_SSWAP, T0, I(context.temp));
+    else
+        SSASM(SSOP_PUSH, T0);
+}
+
+/* moves the left operand of a binary expression from its temporary to t1 */
+void fill(surgescript_nodecontext_t context)
+{
+    if(context.temp >= 0)
+        SSASM(SSOP_SSWAP, T1, I(context.temp));
+    else
+        SSASM(SSOP_POP, T1);
+}
+
+/* places the temporaries of a function after its locals; returns the number of temporaries */
+int relocate_temporaries(surgescript_nodecontext_t context, int first_line, int num_locals)
+{
+    int length = surgescript_program_line_count(context.program);
+    int num_temps = 0;
+
+    for(int line = first_line; line < length; line++) {
+        surgescript_program_operator_t op;
+        surgescript_program_operand_t a, b;
+
+        if(surgescript_program_get_line(context.program, line, &op, &a, &b) && op == SSOP_SSWAP) {
+            num_temps = ssmax(num_temps, b.i + 1);
+            surgescript_program_chg_line(context.program, line, op, a, I(1 + num_locals + b.i));
+        }
+    }
+
+    return num_temps;
+}
+
+
+
+/* -------------------------------
+ * constant folding
+ * ------------------------------- */
+
+/*
+ * The parser emits code as it reads, so expressions of constants are folded
+ * by looking at the code that has just been emitted: if the operands of an
+ * operator have been compiled to loads of constants (one line each) and no
+ * jump lands after the first of them, the code is replaced by the result.
+ * The result is computed in the same way as it would be at runtime.
+ */
+
+/* <constant> <op>, where op is one of: - ! */
+bool fold_unary(surgescript_nodecontext_t context, char op)
+{
+    int line = surgescript_program_line_count(context.program) - 1;
+    surgescript_var_t x = NULLVAR;
+
+    if(!read_constant(context, line, &x) || has_labels(context, line + 1, line + 1))
+        return false;
+
+    if(op == '-')
+        surgescript_var_set_number(&x, -surgescript_var_get_number(&x));
+    else if(op == '!')
+        surgescript_var_set_bool(&x, !surgescript_var_get_bool(&x));
+
+    emit_constant(context, line, &x);
+    surgescript_var_set_null(&x);
+    return true;
+}
+
+/* <constant> <op> <constant>, where op is one of: + - * / % */
+bool fold_binary(surgescript_nodecontext_t context, char op)
+{
+    int line = surgescript_program_line_count(context.program) - 3;
+    surgescript_var_t x = NULLVAR, y = NULLVAR;
+    const int str = surgescript_var_type2code("string");
+
+    /* <constant>; push t0 (or sswap t0, k); <constant> */
+    if(!(is_line(context, line + 1, SSOP_PUSH, 0) || is_line(context, line + 1, SSOP_SSWAP, 0)) || !read_constant(context, line, &x) || !read_constant(context, line + 2, &y) || has_labels(context, line + 1, line + 3)) {
+        surgescript_var_set_null(&x);
+        surgescript_var_set_null(&y);
+        return false;
+    }
+
+    switch(op) {
+        case '+':
+            if(surgescript_var_typecheck(&x, str) & surgescript_var_typecheck(&y, str))
+                surgescript_var_set_number(&x, surgescript_var_get_number(&x) + surgescript_var_get_number(&y));
+            else {
+                /* String.concat() */
+                char* a = surgescript_var_get_string(&x, NULL);
+                char* b = surgescript_var_get_string(&y, NULL);
+                char* buf = ssmalloc((1 + strlen(a) + strlen(b)) * sizeof(*buf));
+                surgescript_var_set_string(&x, strcat(strcpy(buf, a), b));
+                ssfree(buf);
+                ssfree(b);
+                ssfree(a);
+            }
+            break;
+
+        case '-':
+            surgescript_var_set_number(&x, surgescript_var_get_number(&x) - surgescript_var_get_number(&y));
+            break;
+
+        case '*':
+            surgescript_var_set_number(&x, surgescript_var_get_number(&y) * surgescript_var_get_number(&x));
+            break;
+
+        case '/':
+            surgescript_var_set_number(&x, surgescript_var_get_number(&x) / surgescript_var_get_number(&y));
+            break;
+
+        case '%':
+            surgescript_var_set_number(&x, fmod(surgescript_var_get_number(&x), surgescript_var_get_number(&y)));
+            break;
+
+        default:
+            surgescript_var_set_null(&x);
+            surgescript_var_set_null(&y);
+            return false;
+    }
+
+    emit_constant(context, line, &x);
+    surgescript_var_set_null(&x);
+    surgescript_var_set_null(&y);
+    return true;
+}
+
+/* Math.<property>, where the getter is a pure function */
+bool fold_math_getter(surgescript_nodecontext_t context, const char* getter_name)
+{
+    int line = surgescript_program_line_count(context.program) - 1;
+    surgescript_var_t x = NULLVAR;
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+
+    /* movo t0, Math */
+    if(!surgescript_program_get_line(context.program, line, &op, &a, &b) || op != SSOP_MOVO || a.u != 0 || b.u != surgescript_objectmanager_system_object(NULL, "Math"))
+        return false;
+    else if(has_labels(context, line + 1, line + 1))
+        return false;
+
+    if(!surgescript_sslib_math_evaluate(getter_name, NULL, 0, &x))
+        return false;
+
+    emit_constant(context, line, &x);
+    surgescript_var_set_null(&x);
+    return true;
+}
+
+/* Math.<function>(<constant>, ..., <constant>), where the function is pure */
+bool fold_math_call(surgescript_nodecontext_t context, int num_params)
+{
+    int line = surgescript_program_line_count(context.program) - 3 - 2 * num_params;
+    surgescript_var_t* x = ssmalloc((1 + num_params) * sizeof(*x));
+    const surgescript_var_t** param = ssmalloc((1 + num_params) * sizeof(*param));
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    bool folded = false;
+
+    /* movo t0, Math; push t0; (<constant>; push t0) * num_params; call <function>, num_params */
+    for(int i = 0; i <= num_params; i++)
+        x[i] = (surgescript_var_t)NULLVAR;
+    if(
+        surgescript_program_get_line(context.program, line, &op, &a, &b) &&
+        op == SSOP_MOVO && a.u == 0 && b.u == surgescript_objectmanager_system_object(NULL, "Math") &&
+        is_line(context, line + 1, SSOP_PUSH, 0)
+    ) {
+        bool constant = true;
+
+        for(int i = 0; i < num_params && constant; i++) {
+            constant = read_constant(context, line + 2 + 2 * i, &x[i]) && is_line(context, line + 3 + 2 * i, SSOP_PUSH, 0);
+            param[i] = &x[i];
+        }
+
+        if(
+            constant &&
+            surgescript_program_get_line(context.program, line + 2 + 2 * num_params, &op, &a, &b) &&
+            op == SSOP_CALL && b.u == num_params &&
+            !has_labels(context, line + 1, line + 3 + 2 * num_params) &&
+            surgescript_sslib_math_evaluate(surgescript_program_get_text(context.program, a.u), param, num_params, &x[num_params])
+        ) {
+            emit_constant(context, line, &x[num_params]);
+            folded = true;
+        }
+    }
+
+    for(int i = 0; i <= num_params; i++)
+        surgescript_var_set_null(&x[i]);
+    ssfree(param);
+    ssfree(x);
+    return folded;
+}
+
+/* reads a load of a constant to t0 at the given line of code */
+bool read_constant(surgescript_nodecontext_t context, int line, surgescript_var_t* value)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+
+    if(!surgescript_program_get_line(context.program, line, &op, &a, &b) || a.u != 0)
+        return false;
+
+    switch(op) {
+        case SSOP_MOVN:
+            surgescript_var_set_null(value);
+            return true;
+
+        case SSOP_MOVB:
+            surgescript_var_set_bool(value, b.b);
+            return true;
+
+        case SSOP_MOVF:
+            surgescript_var_set_number(value, b.f);
+            return true;
+
+        case SSOP_MOVS:
+            surgescript_var_set_string(value, surgescript_program_get_text(context.program, b.u));
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* replaces the code from the given line onwards by a load of a constant to t0 */
+void emit_constant(surgescript_nodecontext_t context, int line, const surgescript_var_t* value)
+{
+    surgescript_program_remove_lines(context.program, line);
+
+    if(surgescript_var_is_string(value))
+        SSASM(SSOP_MOVS, T0, TEXT(surgescript_var_fast_get_string(value)));
+    else if(surgescript_var_is_number(value))
+        SSASM(SSOP_MOVF, T0, F(surgescript_var_get_number(value)));
+    else if(surgescript_var_is_bool(value))
+        SSASM(SSOP_MOVB, T0, B(surgescript_var_get_bool(value)));
+    else
+        SSASM(SSOP_MOVN, T0);
+}
+
+/* checks if the given line of code is op t[a] */
+bool is_line(surgescript_nodecontext_t context, int line, surgescript_program_operator_t op, unsigned a)
+{
+    surgescript_program_operator_t line_op;
+    surgescript_program_operand_t line_a, line_b;
+
+    return surgescript_program_get_line(context.program, line, &line_op, &line_a, &line_b) && line_op == op && line_a.u == a;
+}
+
+/* is there a label at any of the given lines? (i.e., may the code jump there?) */
+bool has_labels(surgescript_nodecontext_t context, int first_line, int last_line)
+{
+    for(int line = first_line; line <= last_line; line++) {
+        if(surgescript_program_has_label(context.program, line))
+            return true;
+    }
+
+    return false;
+}
+
+
+/* -------------------------------
+ * hot reload
+ * ------------------------------- */
+
+/*
+ * The layout program of an object lists its variables, in the order they
+ * were declared: each one is a MOVS of its name followed by a PEEK of its
+ * address. When an object is reloaded, its variables are matched by name
+ * with the new layout (see surgescript_object_reload()).
+ */
+
+/* writes an entry of the layout program */
+void emit_layout_entry(const char* symbol, surgescript_heapptr_t address, void* ctx)
+{
+    surgescript_nodecontext_t context = *((surgescript_nodecontext_t*)ctx);
+    SSASM(SSOP_MOVS, T0, TEXT(symbol));
+    SSASM(SSOP_PEEK, T0, U(address));
+}
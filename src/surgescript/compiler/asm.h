@@ -35,6 +35,11 @@ void emit_vardecl(surgescript_nodecontext_t context, const char* identifier);
 void emit_vargetter(surgescript_nodecontext_t context, const char* identifier);
 void emit_varsetter(surgescript_nodecontext_t context, const char* identifier);
 
+/* hot reload */
+void emit_object_layout(surgescript_nodecontext_t context);
+void emit_varinit1(surgescript_nodecontext_t context, const char* identifier, surgescript_program_label_t next);
+void emit_varinit2(surgescript_nodecontext_t context, const char* identifier, surgescript_program_label_t next);
+
 /* expressions */
 void emit_assignexpr(surgescript_nodecontext_t context, const char* assignop, const char* identifier, int line);
 void emit_conditionalexpr1(surgescript_nodecontext_t context, surgescript_program_label_t nope, surgescript_program_label_t done);
@@ -0,0 +1,298 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/batch.c
+ * SurgeScript Compiler: parses many files on multiple threads
+ */
+
+#include "batch.h"
+#include "parser.h"
+#include "../runtime/program_pool.h"
+#include "../runtime/program.h"
+#include "../runtime/tag_system.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+/* multithread support */
+#if !defined(SURGESCRIPT_DISABLE_THREADS) && !__STDC_NO_THREADS__
+#define USE_THREADS 1
+#include <threads.h>
+#else
+#define USE_THREADS 0
+#endif
+
+/*
+ * Each file is parsed by its own parser into its own program pool and tag
+ * system, which don't depend on the other files. The results are then merged
+ * in the order the files were given: the programs are moved to the program
+ * pool of the VM, and the tags, the objects and the plugins are copied.
+ *
+ * The parser imports the accessors of Object, the base object, to the symbol
+ * table of each object it reads, so each program pool of the batch gets a
+ * stand-in Object with the names of the programs of the actual one.
+ *
+ * The parser checks for duplicate objects when it reads them. A file that
+ * defines an object that already has code in the pool of the VM (defined by
+ * an earlier file, or by the host application) is parsed again, at merge time,
+ * by the parser of the VM, so that duplicates are reported (or skipped, or
+ * replaced, depending on the flags of the parser) exactly as usual.
+ */
+
+/* a file of the batch */
+typedef struct surgescript_batch_file_t surgescript_batch_file_t;
+struct surgescript_batch_file_t
+{
+    const char* absolute_path;
+    surgescript_programpool_t* program_pool;
+    surgescript_tagsystem_t* tag_system;
+    surgescript_parser_t* parser;
+};
+
+/* the batch */
+typedef struct surgescript_batch_t surgescript_batch_t;
+struct surgescript_batch_t
+{
+    surgescript_batch_file_t* file;
+    int count;
+#if USE_THREADS
+    mtx_t mutex; /* protects next */
+#endif
+    int next; /* index of the next file to be parsed */
+};
+
+/* names of programs */
+typedef struct surgescript_batch_names_t surgescript_batch_names_t;
+struct surgescript_batch_names_t
+{
+    SSARRAY(const char*, name);
+};
+
+/* merging */
+typedef struct surgescript_batch_merge_t surgescript_batch_merge_t;
+struct surgescript_batch_merge_t
+{
+    surgescript_batch_file_t* file;
+    surgescript_parser_t* parser;
+    surgescript_programpool_t* program_pool;
+    surgescript_tagsystem_t* tag_system;
+    const char* tag_name;
+    bool conflict;
+};
+
+#if USE_THREADS
+static int parse_files(void* batch);
+static int take_file(surgescript_batch_t* batch);
+#endif
+static void collect_name(const char* name, void* names);
+static surgescript_var_t* stand_in(surgescript_object_t* object, const surgescript_var_t* param[], int num_params);
+static void merge(surgescript_batch_file_t* file, surgescript_parser_t* parser, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system);
+static void find_conflict(const char* object_name, void* merge);
+static void move_object(const char* object_name, void* merge);
+static void copy_tag(const char* tag_name, void* merge);
+static void copy_tagged_object(const char* object_name, void* merge);
+static void copy_plugin(const char* object_name, void* merge);
+
+
+
+/*
+ * surgescript_batch_parsefiles()
+ * Parses the given files on num_threads threads (if zero, one per CPU core),
+ * adding their code to program_pool and tag_system. The results, including
+ * the errors and warnings about duplicate objects, are the same as if the
+ * files were parsed one by one, in order, by the given parser
+ */
+bool surgescript_batch_parsefiles(surgescript_parser_t* parser, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, const char** absolute_path, int count, int num_threads)
+{
+    surgescript_batch_names_t base;
+    surgescript_batch_t batch;
+    bool success = true;
+
+    /* how many threads? */
+    if(num_threads <= 0)
+        num_threads = surgescript_util_cpucount();
+    num_threads = ssmin(num_threads, count);
+
+    /* no need to create threads */
+    if(!USE_THREADS || num_threads <= 1) {
+        for(int i = 0; i < count; i++)
+            success = surgescript_parser_parsefile(parser, absolute_path[i]) && success;
+        return success;
+    }
+
+    /* create a parser for each file. Create them on this
+       thread, as creating a parser isn't thread-safe */
+    sslog("Parsing %d files on %d threads...", count, num_threads);
+    ssarray_init(base.name);
+    surgescript_programpool_foreach_ex(program_pool, "Object", &base, collect_name);
+    batch.file = ssmalloc(count * sizeof(*(batch.file)));
+    batch.count = count;
+    batch.next = 0;
+    for(int i = 0; i < count; i++) {
+        surgescript_batch_file_t* file = &(batch.file[i]);
+        file->absolute_path = absolute_path[i];
+        file->program_pool = surgescript_programpool_create();
+        file->tag_system = surgescript_tagsystem_create();
+        file->parser = surgescript_parser_create(file->program_pool, file->tag_system);
+        surgescript_parser_set_flags(file->parser, surgescript_parser_get_flags(parser));
+        surgescript_parser_set_cache_directory(file->parser, surgescript_parser_get_cache_directory(parser));
+        for(int j = 0; j < ssarray_length(base.name); j++)
+            surgescript_programpool_put(file->program_pool, "Object", base.name[j], surgescript_program_create_native(0, stand_in));
+    }
+    ssarray_release(base.name);
+
+#if USE_THREADS
+    /* parse the files */
+    {
+        thrd_t* thread = ssmalloc((num_threads - 1) * sizeof(*thread));
+
+        if(mtx_init(&batch.mutex, mtx_plain) != thrd_success)
+            ssfatal("Can't parse the files: synchronization error");
+
+        for(int i = 0; i < num_threads - 1; i++) {
+            if(thrd_create(&thread[i], parse_files, &batch) != thrd_success)
+                ssfatal("Can't parse the files: unable to create a thread");
+        }
+
+        parse_files(&batch); /* this thread helps too */
+
+        for(int i = 0; i < num_threads - 1; i++)
+            thrd_join(thread[i], NULL);
+
+        mtx_destroy(&batch.mutex);
+        ssfree(thread);
+    }
+#endif
+
+    /* merge the results in order */
+    for(int i = 0; i < count; i++) {
+        surgescript_batch_file_t* file = &(batch.file[i]);
+        merge(file, parser, program_pool, tag_system);
+        surgescript_parser_destroy(file->parser);
+        surgescript_tagsystem_destroy(file->tag_system);
+        surgescript_programpool_destroy(file->program_pool);
+    }
+
+    /* done! */
+    ssfree(batch.file);
+    return success;
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+#if USE_THREADS
+
+/* the routine of a thread: parses files until there are none left */
+int parse_files(void* arg)
+{
+    surgescript_batch_t* batch = (surgescript_batch_t*)arg;
+    int index;
+
+    while((index = take_file(batch)) >= 0) {
+        surgescript_batch_file_t* file = &(batch->file[index]);
+        surgescript_parser_parsefile(file->parser, file->absolute_path);
+    }
+
+    return 0;
+}
+
+/* takes the next file to be parsed; returns -1 if there is none */
+int take_file(surgescript_batch_t* batch)
+{
+    int index = -1;
+
+    mtx_lock(&batch->mutex);
+    if(batch->next < batch->count)
+        index = batch->next++;
+    mtx_unlock(&batch->mutex);
+
+    return index;
+}
+
+#endif
+
+/* adds a name to a list of names */
+void collect_name(const char* name, void* names)
+{
+    surgescript_batch_names_t* list = (surgescript_batch_names_t*)names;
+    ssarray_push(list->name, name);
+}
+
+/* a program of the stand-in Object; it's never called */
+surgescript_var_t* stand_in(surgescript_object_t* object, const surgescript_var_t* param[], int num_params)
+{
+    return NULL;
+}
+
+/* merges the results of a parsed file */
+void merge(surgescript_batch_file_t* file, surgescript_parser_t* parser, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system)
+{
+    surgescript_batch_merge_t m = { file, parser, program_pool, tag_system, NULL, false };
+
+    /* does the file define an object that already exists? */
+    surgescript_parser_foreach_object(file->parser, &m, find_conflict);
+    if(m.conflict) {
+        surgescript_parser_parsefile(parser, file->absolute_path);
+        return;
+    }
+
+    /* merge */
+    surgescript_parser_foreach_object(file->parser, &m, move_object);
+    surgescript_tagsystem_foreach_tag(file->tag_system, &m, copy_tag);
+    surgescript_parser_foreach_plugin(file->parser, &m, copy_plugin);
+}
+
+/* checks if an object has already been defined */
+void find_conflict(const char* object_name, void* merge)
+{
+    surgescript_batch_merge_t* m = (surgescript_batch_merge_t*)merge;
+    if(surgescript_programpool_is_compiled(m->program_pool, object_name))
+        m->conflict = true;
+}
+
+/* moves the programs of an object to the program pool of the VM */
+void move_object(const char* object_name, void* merge)
+{
+    surgescript_batch_merge_t* m = (surgescript_batch_merge_t*)merge;
+    surgescript_programpool_move(m->program_pool, m->file->program_pool, object_name);
+    surgescript_parser_add_object(m->parser, object_name);
+}
+
+/* copies a tag to the tag system of the VM */
+void copy_tag(const char* tag_name, void* merge)
+{
+    surgescript_batch_merge_t* m = (surgescript_batch_merge_t*)merge;
+    m->tag_name = tag_name;
+    surgescript_tagsystem_foreach_tagged_object(m->file->tag_system, tag_name, merge, copy_tagged_object);
+}
+
+/* tags an object in the tag system of the VM */
+void copy_tagged_object(const char* object_name, void* merge)
+{
+    surgescript_batch_merge_t* m = (surgescript_batch_merge_t*)merge;
+    surgescript_tagsystem_add_tag(m->tag_system, object_name, m->tag_name);
+}
+
+/* adds a plugin to the parser of the VM */
+void copy_plugin(const char* object_name, void* merge)
+{
+    surgescript_batch_merge_t* m = (surgescript_batch_merge_t*)merge;
+    surgescript_parser_add_plugin(m->parser, object_name);
+}
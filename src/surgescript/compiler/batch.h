@@ -0,0 +1,35 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/batch.h
+ * SurgeScript Compiler: parses many files on multiple threads
+ */
+
+#ifndef _SURGESCRIPT_COMPILER_BATCH_H
+#define _SURGESCRIPT_COMPILER_BATCH_H
+
+#include <stdbool.h>
+
+/* forward declarations */
+struct surgescript_programpool_t;
+struct surgescript_tagsystem_t;
+struct surgescript_parser_t;
+
+/* batch compilation */
+bool surgescript_batch_parsefiles(struct surgescript_parser_t* parser, struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, const char** absolute_path, int count, int num_threads); /* parses the files on num_threads threads (0 = one per CPU core), with the same results as parsing them one by one */
+
+#endif
@@ -0,0 +1,639 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/bytecode.c
+ * SurgeScript Compiler: precompiled bytecode (.ssc files)
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "bytecode.h"
+#include "parser.h"
+#include "../runtime/program.h"
+#include "../runtime/program_pool.h"
+#include "../runtime/tag_system.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+#define XXH_INLINE_ALL
+#include "../util/xxhash.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * File format
+ *
+ * header:
+ *     char[4]  magic = "SSC\x1a"
+ *     u32      format version
+ *     u32      byte order mark = 0x01020304
+ *     u32      signature of the instruction set
+ *     string   version of SurgeScript
+ * objects:
+ *     u32      number of objects
+ *     for each object:
+ *         string   object name
+ *         u32      number of programs
+ *         for each program:
+ *             string   program name
+ *             program  (see surgescript_program_write())
+ * tags:
+ *     u32      number of tagged objects
+ *     for each tagged object:
+ *         string   object name
+ *         string   tag name
+ * plugins:
+ *     u32      number of plugins
+ *     for each plugin:
+ *         string   object name
+ * trailer:
+ *     u32      checksum (XXH32) of all the preceding bytes
+ *
+ * A string is a u32 length followed by that many bytes (not zero-terminated).
+ * Integers are stored in the byte order of the machine that wrote the file.
+ * Files written by a different version of SurgeScript, or on a machine with a
+ * different byte order, are rejected: the scripts must be compiled again.
+ * So are files that don't match their checksum.
+ *
+ * Only programs written in SurgeScript are stored; native programs (such as
+ * those of the standard library) are bound when the VM is created.
+ *
+ * The file is mapped to memory and validated before anything is loaded: the
+ * instructions, their registers, texts, jump targets, stack offsets and call
+ * arities (see surgescript_program_read()), and the heap addresses of the
+ * variables of each object, which must be within its layout. The code and
+ * the texts of each program are copied once from the mapped file to their
+ * final block, because the mapping is released after loading and because
+ * the code is quickened in place when it runs.
+ */
+static const char MAGIC[4] = { 'S', 'S', 'C', '\x1a' };
+static const uint32_t FORMAT_VERSION = 2;
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/* a list of names */
+typedef struct surgescript_bytecode_names_t surgescript_bytecode_names_t;
+struct surgescript_bytecode_names_t
+{
+    SSARRAY(const char*, name);
+};
+
+/* a program read from a file, before being added to the pool */
+typedef struct surgescript_bytecode_entry_t surgescript_bytecode_entry_t;
+struct surgescript_bytecode_entry_t
+{
+    char* object_name;
+    char* program_name;
+    surgescript_program_t* program;
+};
+
+/* helpers */
+static uint32_t instruction_set_signature();
+static void write_u32(FILE* fp, uint32_t value);
+static void write_string(FILE* fp, const char* string);
+static bool read_u32(const char** data, const char* end, uint32_t* value);
+static char* read_string(const char** data, const char* end);
+static bool read_header(const char** data, const char* end);
+static bool read_checksum(const char** end, const char* data);
+static bool append_checksum(const char* absolute_path);
+static void collect_name(const char* name, void* names);
+static void collect_programs(surgescript_programpool_t* program_pool, const char* object_name, surgescript_bytecode_names_t* programs);
+static bool contains(const char** names, int count, const char* name);
+static bool has_scripts(surgescript_programpool_t* program_pool, const char* object_name);
+static int heap_size(const surgescript_bytecode_entry_t* entry, int entry_count, const char* object_name);
+static const char* map_file(const char* absolute_path, size_t* size);
+static void unmap_file(const char* data, size_t size);
+static bool load(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser, bool new_objects);
+static surgescript_var_t* empty_main(surgescript_object_t* object, const surgescript_var_t* param[], int num_params);
+
+
+
+/*
+ * surgescript_bytecode_save()
+ * Saves the scripts compiled by the parser to a file. Returns true on success
+ */
+bool surgescript_bytecode_save(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser)
+{
+    surgescript_bytecode_names_t objects;
+    bool success;
+
+    ssarray_init(objects.name);
+    surgescript_parser_foreach_object(parser, &objects, collect_name);
+    success = surgescript_bytecode_save_objects(absolute_path, program_pool, tag_system, parser, objects.name, ssarray_length(objects.name));
+    ssarray_release(objects.name);
+
+    return success;
+}
+
+/*
+ * surgescript_bytecode_save_objects()
+ * Saves the given objects, compiled by the parser, to a file (along with their
+ * tags and their plugin status). Returns true on success
+ */
+bool surgescript_bytecode_save_objects(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser, const char** object_name, int object_count)
+{
+    surgescript_bytecode_names_t programs, tag_names, pairs, plugins;
+    bool success;
+    FILE* fp;
+
+    /* open the file */
+    sslog("Writing bytecode to %s...", absolute_path);
+    if(NULL == (fp = surgescript_util_fopen_utf8(absolute_path, "wb"))) {
+        sslog("Can't write bytecode to \"%s\": %s", absolute_path, strerror(errno));
+        return false;
+    }
+
+    /* header */
+    fwrite(MAGIC, sizeof(MAGIC), 1, fp);
+    write_u32(fp, FORMAT_VERSION);
+    write_u32(fp, BYTE_ORDER_MARK);
+    write_u32(fp, instruction_set_signature());
+    write_string(fp, surgescript_util_version());
+
+    /* objects */
+    ssarray_init(programs.name);
+    write_u32(fp, object_count);
+    for(int i = 0; i < object_count; i++) {
+        ssarray_reset(programs.name);
+        collect_programs(program_pool, object_name[i], &programs);
+
+        write_string(fp, object_name[i]);
+        write_u32(fp, ssarray_length(programs.name));
+        for(int j = 0; j < ssarray_length(programs.name); j++) {
+            write_string(fp, programs.name[j]);
+            surgescript_program_write(surgescript_programpool_get(program_pool, object_name[i], programs.name[j]), fp);
+        }
+    }
+    ssarray_release(programs.name);
+
+    /* tags */
+    ssarray_init(tag_names.name);
+    ssarray_init(pairs.name);
+    surgescript_tagsystem_foreach_tag(tag_system, &tag_names, collect_name);
+    for(int i = 0; i < object_count; i++) {
+        for(int j = 0; j < ssarray_length(tag_names.name); j++) {
+            if(surgescript_tagsystem_has_tag(tag_system, object_name[i], tag_names.name[j])) {
+                ssarray_push(pairs.name, object_name[i]);
+                ssarray_push(pairs.name, tag_names.name[j]);
+            }
+        }
+    }
+
+    write_u32(fp, ssarray_length(pairs.name) / 2);
+    for(int i = 0; i < ssarray_length(pairs.name); i++)
+        write_string(fp, pairs.name[i]);
+    ssarray_release(pairs.name);
+    ssarray_release(tag_names.name);
+
+    /* plugins */
+    ssarray_init(plugins.name);
+    surgescript_parser_foreach_plugin(parser, &plugins, collect_name);
+    for(int i = ssarray_length(plugins.name) - 1; i >= 0; i--) {
+        if(!contains(object_name, object_count, plugins.name[i]))
+            ssarray_remove(plugins.name, i);
+    }
+
+    write_u32(fp, ssarray_length(plugins.name));
+    for(int i = 0; i < ssarray_length(plugins.name); i++)
+        write_string(fp, plugins.name[i]);
+    ssarray_release(plugins.name);
+
+    /* done! */
+    success = !ferror(fp);
+    if(fclose(fp) != 0 || !success || !append_checksum(absolute_path)) {
+        sslog("Can't write bytecode to \"%s\"", absolute_path);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * surgescript_bytecode_load()
+ * Loads precompiled scripts from a file. Returns false if the file can't be
+ * read or if it's invalid (e.g., written by another version of SurgeScript),
+ * in which case nothing is loaded and the scripts must be compiled again.
+ * Nothing is loaded either if the file defines an object that already exists
+ */
+bool surgescript_bytecode_load(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser)
+{
+    return load(absolute_path, program_pool, tag_system, parser, false);
+}
+
+/*
+ * surgescript_bytecode_load_new()
+ * Similar to surgescript_bytecode_load(), but nothing is loaded if the file
+ * defines an object that already has programs written in SurgeScript, because
+ * its code was compiled without them. Native programs (e.g., the functions
+ * bound to Application by the standard library) are allowed: the compile
+ * cache keeps different files for different sets of native programs
+ */
+bool surgescript_bytecode_load_new(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser)
+{
+    return load(absolute_path, program_pool, tag_system, parser, true);
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+/* loads precompiled scripts from a file */
+bool load(const char* absolute_path, surgescript_programpool_t* program_pool, surgescript_tagsystem_t* tag_system, surgescript_parser_t* parser, bool new_objects)
+{
+    SSARRAY(surgescript_bytecode_entry_t, entry);
+    SSARRAY(char*, object_name);
+    SSARRAY(char*, string);
+    uint32_t object_count = 0, tag_count = 0, plugin_count = 0;
+    const char *data, *p, *end;
+    bool success = true, conflict = false;
+    size_t size = 0;
+
+    /* map the file to memory */
+    sslog("Reading bytecode from %s...", absolute_path);
+    if(NULL == (data = map_file(absolute_path, &size))) {
+        sslog("Can't read bytecode from \"%s\": %s", absolute_path, strerror(errno));
+        return false;
+    }
+
+    ssarray_init(entry);
+    ssarray_init(object_name);
+    ssarray_init(string);
+    p = data;
+    end = data + size;
+
+    /* validate the checksum */
+    if(!read_checksum(&end, data)) {
+        sslog("Can't read bytecode from \"%s\": the file is corrupted", absolute_path);
+        end = p;
+    }
+
+    /* read the header and the programs */
+    success = read_header(&p, end) && read_u32(&p, end, &object_count);
+    for(uint32_t i = 0; success && i < object_count; i++) {
+        char* name = read_string(&p, end);
+        uint32_t program_count = 0;
+
+        if(name == NULL || !read_u32(&p, end, &program_count)) {
+            ssfree(name);
+            success = false;
+            break;
+        }
+
+        ssarray_push(object_name, name);
+        for(uint32_t j = 0; success && j < program_count; j++) {
+            surgescript_bytecode_entry_t e = { name, read_string(&p, end), NULL };
+            if(e.program_name != NULL && (e.program = surgescript_program_read(&p, end)) != NULL)
+                ssarray_push(entry, e);
+            else {
+                ssfree(e.program_name);
+                success = false;
+            }
+        }
+    }
+
+    /* read the tags and the plugins */
+    success = success && read_u32(&p, end, &tag_count);
+    for(uint32_t i = 0; success && i < 2 * tag_count; i++) {
+        char* s = read_string(&p, end);
+        if(s != NULL)
+            ssarray_push(string, s);
+        else
+            success = false;
+    }
+
+    success = success && read_u32(&p, end, &plugin_count);
+    for(uint32_t i = 0; success && i < plugin_count; i++) {
+        char* s = read_string(&p, end);
+        if(s != NULL)
+            ssarray_push(string, s);
+        else
+            success = false;
+    }
+
+    /* the whole file must have been read */
+    success = success && (p == end);
+    unmap_file(data, size);
+
+    /* the programs may only access the variables of their objects */
+    for(int i = 0; success && i < ssarray_length(entry); i++)
+        success = (surgescript_program_heap_size(entry[i].program) <= heap_size(entry, ssarray_length(entry), entry[i].object_name));
+
+    /* objects can't be defined twice */
+    for(int i = 0; success && i < ssarray_length(object_name); i++) {
+        if(surgescript_programpool_exists(program_pool, object_name[i], "state:main")) {
+            sslog("Can't read bytecode from \"%s\": object \"%s\" is already defined", absolute_path, object_name[i]);
+            conflict = true;
+            success = false;
+        }
+        else if(new_objects && has_scripts(program_pool, object_name[i])) {
+            sslog("Can't read bytecode from \"%s\": object \"%s\" already exists", absolute_path, object_name[i]);
+            conflict = true;
+            success = false;
+        }
+    }
+
+    /* load the scripts */
+    if(success) {
+        for(int i = 0; i < ssarray_length(entry); i++)
+            surgescript_programpool_put(program_pool, entry[i].object_name, entry[i].program_name, entry[i].program);
+
+        for(int i = 0; i < ssarray_length(object_name); i++) {
+            /* objects without a "main" state get an empty one, as in the parser */
+            if(!surgescript_programpool_exists(program_pool, object_name[i], "state:main") && strcmp(object_name[i], "Application") != 0)
+                surgescript_programpool_put(program_pool, object_name[i], "state:main", surgescript_program_create_native(0, empty_main));
+            surgescript_parser_add_object(parser, object_name[i]);
+        }
+
+        for(uint32_t i = 0; i < tag_count; i++)
+            surgescript_tagsystem_add_tag(tag_system, string[2 * i], string[2 * i + 1]);
+
+        for(uint32_t i = 0; i < plugin_count; i++)
+            surgescript_parser_add_plugin(parser, string[2 * tag_count + i]);
+    }
+    else {
+        if(!conflict)
+            sslog("Can't read bytecode from \"%s\": invalid or incompatible file", absolute_path);
+        for(int i = 0; i < ssarray_length(entry); i++)
+            surgescript_program_destroy(entry[i].program);
+    }
+
+    /* release the temporary data */
+    for(int i = 0; i < ssarray_length(entry); i++)
+        ssfree(entry[i].program_name);
+    for(int i = 0; i < ssarray_length(object_name); i++)
+        ssfree(object_name[i]);
+    for(int i = 0; i < ssarray_length(string); i++)
+        ssfree(string[i]);
+    ssarray_release(string);
+    ssarray_release(object_name);
+    ssarray_release(entry);
+
+    /* done! */
+    return success;
+}
+
+/* a hash of the names of the instructions, so that files written
+   with a different instruction set are rejected */
+uint32_t instruction_set_signature()
+{
+    #define NAME(x, y) y,
+    static const char* instruction_name[] = { SURGESCRIPT_PROGRAM_OPERATORS(NAME) };
+    #undef NAME
+    const int count = sizeof(instruction_name) / sizeof(instruction_name[0]);
+    uint32_t signature = count;
+
+    for(int i = 0; i < count; i++)
+        signature = XXH32(instruction_name[i], strlen(instruction_name[i]) + 1, signature);
+
+    return signature;
+}
+
+/* reads and validates the header */
+bool read_header(const char** data, const char* end)
+{
+    uint32_t version = 0, byte_order = 0, signature = 0;
+    bool valid = false;
+    char* ss_version;
+
+    /* magic number */
+    if((size_t)(end - *data) < sizeof(MAGIC) || memcmp(*data, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    *data += sizeof(MAGIC);
+
+    /* versions and the like */
+    if(!read_u32(data, end, &version) || !read_u32(data, end, &byte_order) || !read_u32(data, end, &signature))
+        return false;
+    else if(NULL == (ss_version = read_string(data, end)))
+        return false;
+
+    valid = (version == FORMAT_VERSION && byte_order == BYTE_ORDER_MARK &&
+             signature == instruction_set_signature() && strcmp(ss_version, surgescript_util_version()) == 0);
+    ssfree(ss_version);
+    return valid;
+}
+
+/* checks the checksum at the end of the data, moving *end before it. Returns false if it doesn't match */
+bool read_checksum(const char** end, const char* data)
+{
+    uint32_t checksum;
+    const char* p;
+
+    if((size_t)(*end - data) < sizeof(checksum))
+        return false;
+
+    p = *end - sizeof(checksum);
+    memcpy(&checksum, p, sizeof(checksum));
+    if(checksum != XXH32(data, p - data, 0))
+        return false;
+
+    *end = p;
+    return true;
+}
+
+/* appends the checksum of a file to itself */
+bool append_checksum(const char* absolute_path)
+{
+    size_t size = 0;
+    uint32_t checksum;
+    const char* data;
+    FILE* fp;
+
+    if(NULL == (data = map_file(absolute_path, &size)))
+        return false;
+
+    checksum = XXH32(data, size, 0);
+    unmap_file(data, size);
+
+    if(NULL == (fp = surgescript_util_fopen_utf8(absolute_path, "ab")))
+        return false;
+
+    write_u32(fp, checksum);
+    return fclose(fp) == 0;
+}
+
+/* writes an integer (byte order of the host) */
+void write_u32(FILE* fp, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+/* writes a string */
+void write_string(FILE* fp, const char* string)
+{
+    uint32_t length = strlen(string);
+    write_u32(fp, length);
+    fwrite(string, sizeof(char), length, fp);
+}
+
+/* reads an integer from memory, advancing *data. Returns false if there is not enough data */
+bool read_u32(const char** data, const char* end, uint32_t* value)
+{
+    if((size_t)(end - *data) < sizeof(*value))
+        return false;
+
+    memcpy(value, *data, sizeof(*value));
+    *data += sizeof(*value);
+    return true;
+}
+
+/* reads a string from memory, advancing *data. Returns a new zero-terminated string, or NULL on error */
+char* read_string(const char** data, const char* end)
+{
+    uint32_t length;
+    char* string;
+
+    if(!read_u32(data, end, &length) || (size_t)(end - *data) < length)
+        return NULL;
+
+    string = ssmalloc((length + 1) * sizeof(char));
+    memcpy(string, *data, length * sizeof(char));
+    string[length] = '\0';
+    *data += length;
+    return string;
+}
+
+/* adds a name to a list of names */
+void collect_name(const char* name, void* names)
+{
+    surgescript_bytecode_names_t* list = (surgescript_bytecode_names_t*)names;
+    ssarray_push(list->name, name);
+}
+
+/* collects the names of the programs of an object that are written in SurgeScript */
+void collect_programs(surgescript_programpool_t* program_pool, const char* object_name, surgescript_bytecode_names_t* programs)
+{
+    surgescript_programpool_foreach_ex(program_pool, object_name, programs, collect_name);
+    for(int i = ssarray_length(programs->name) - 1; i >= 0; i--) {
+        surgescript_program_t* program = surgescript_programpool_get(program_pool, object_name, programs->name[i]);
+        if(surgescript_program_is_native(program))
+            ssarray_remove(programs->name, i);
+    }
+}
+
+/* checks if an object has any programs written in SurgeScript */
+bool has_scripts(surgescript_programpool_t* program_pool, const char* object_name)
+{
+    surgescript_bytecode_names_t programs;
+    bool result;
+
+    ssarray_init(programs.name);
+    collect_programs(program_pool, object_name, &programs);
+    result = ssarray_length(programs.name) > 0;
+    ssarray_release(programs.name);
+
+    return result;
+}
+
+/* checks if a name is in a list of names */
+bool contains(const char** names, int count, const char* name)
+{
+    for(int i = 0; i < count; i++) {
+        if(strcmp(names[i], name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/* the number of variables of an object, as laid out by the compiler (see surgescript_object_layout()) */
+int heap_size(const surgescript_bytecode_entry_t* entry, int entry_count, const char* object_name)
+{
+    for(int i = 0; i < entry_count; i++) {
+        if(strcmp(entry[i].object_name, object_name) == 0 && strcmp(entry[i].program_name, "__sslayout") == 0)
+            return surgescript_program_heap_size(entry[i].program);
+    }
+
+    return 0;
+}
+
+/* maps a file to memory (read-only). Returns NULL on error */
+const char* map_file(const char* absolute_path, size_t* size)
+{
+#if !defined(_WIN32)
+    struct stat st;
+    void* data;
+    int fd;
+
+    if((fd = open(absolute_path, O_RDONLY)) < 0)
+        return NULL;
+    else if(fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    data = (*size > 0) ? mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd); /* the mapping remains valid */
+
+    if(data == MAP_FAILED)
+        return NULL;
+    else if(data == NULL)
+        return ssmalloc(1); /* empty file */
+
+    return (const char*)data;
+#else
+    /* read the whole file */
+    FILE* fp = surgescript_util_fopen_utf8(absolute_path, "rb");
+    char* data = NULL;
+    long length;
+
+    if(fp == NULL)
+        return NULL;
+
+    if(fseek(fp, 0, SEEK_END) != 0 || (length = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    *size = (size_t)length;
+    data = ssmalloc(*size + 1);
+    if(fread(data, sizeof(char), *size, fp) != *size) {
+        fclose(fp);
+        ssfree(data);
+        return NULL;
+    }
+
+    fclose(fp);
+    return data;
+#endif
+}
+
+/* releases a file mapped with map_file() */
+void unmap_file(const char* data, size_t size)
+{
+#if !defined(_WIN32)
+    if(size > 0)
+        munmap((void*)data, size);
+    else
+        ssfree((void*)data);
+#else
+    ssfree((void*)data);
+#endif
+}
+
+/* an empty "main" state */
+surgescript_var_t* empty_main(surgescript_object_t* object, const surgescript_var_t* param[], int num_params)
+{
+    return NULL;
+}
@@ -0,0 +1,41 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * compiler/bytecode.h
+ * SurgeScript Compiler: precompiled bytecode (.ssc files)
+ */
+
+#ifndef _SURGESCRIPT_COMPILER_BYTECODE_H
+#define _SURGESCRIPT_COMPILER_BYTECODE_H
+
+#include <stdbool.h>
+
+/* forward declarations */
+struct surgescript_programpool_t;
+struct surgescript_tagsystem_t;
+struct surgescript_parser_t;
+
+/* the usual extension of precompiled bytecode files */
+#define SURGESCRIPT_BYTECODE_EXTENSION ".ssc"
+
+/* save & load (the loaded code is validated and copied from the file, which is not kept open) */
+bool surgescript_bytecode_save(const char* absolute_path, struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_parser_t* parser); /* saves the compiled scripts to a file */
+bool surgescript_bytecode_save_objects(const char* absolute_path, struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_parser_t* parser, const char** object_name, int object_count); /* saves only the given objects */
+bool surgescript_bytecode_load(const char* absolute_path, struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_parser_t* parser); /* loads precompiled scripts from a file; returns false (and loads nothing) if the file is invalid or if it redefines an object */
+bool surgescript_bytecode_load_new(const char* absolute_path, struct surgescript_programpool_t* program_pool, struct surgescript_tagsystem_t* tag_system, struct surgescript_parser_t* parser); /* same as above, but also refuses objects that already have programs written in SurgeScript */
+
+#endif
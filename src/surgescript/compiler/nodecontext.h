@@ -36,13 +36,22 @@ typedef struct surgescript_nodecontext_t
     surgescript_program_t* program;
     surgescript_program_label_t loop_begin;
     surgescript_program_label_t loop_end;
+    int temp; /* next free slot of the stack frame for expression temporaries; negative if they are spilled onto the stack */
 } surgescript_nodecontext_t;
 
 /* node context constructor */
 static inline surgescript_nodecontext_t nodecontext(const char* source_file, const char* object_name, const char* program_name, struct surgescript_symtable_t* symbol_table, surgescript_program_t* program)
 {
-    surgescript_nodecontext_t ctx = { source_file, object_name, program_name, symbol_table, program, SURGESCRIPT_PROGRAM_UNDEFINED_LABEL, SURGESCRIPT_PROGRAM_UNDEFINED_LABEL };
+    surgescript_nodecontext_t ctx = { source_file, object_name, program_name, symbol_table, program, SURGESCRIPT_PROGRAM_UNDEFINED_LABEL, SURGESCRIPT_PROGRAM_UNDEFINED_LABEL, -1 };
     return ctx;
 }
 
+/* the context of the right operand of a binary expression, whose left operand is kept in a temporary */
+static inline surgescript_nodecontext_t rightoperand(surgescript_nodecontext_t context)
+{
+    if(context.temp >= 0)
+        context.temp++;
+    return context;
+}
+
 #endif
\ No newline at end of file
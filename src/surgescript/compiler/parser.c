@@ -31,6 +31,7 @@
 #include "nodecontext.h"
 #include "symtable.h"
 #include "asm.h"
+#include "bytecode.h"
 #include "../runtime/object.h"
 #include "../runtime/object_manager.h"
 #include "../runtime/tag_system.h"
@@ -38,6 +39,8 @@
 #include "../runtime/program.h"
 #include "../util/util.h"
 #include "../util/ssarray.h"
+#define XXH_INLINE_ALL
+#include "../util/xxhash.h"
 
 /* the parser */
 struct surgescript_parser_t
@@ -50,17 +53,27 @@ struct surgescript_parser_t
     surgescript_tagsystem_t* tag_system; /* reference to the tag system */
     surgescript_symtable_t* base_table; /* valid symbols in the current file (code unit) */
     SSARRAY(char*, known_plugins); /* known plugins in all files (the names of the objects) */
+    SSARRAY(char*, known_objects); /* objects defined in all files, in order of definition */
     surgescript_parser_flags_t flags;
+    char* cache_directory; /* compile cache (NULL if disabled) */
+    bool cacheable; /* can the current file be stored in the compile cache? */
 };
 
 /* helpers */
 static void parse(surgescript_parser_t* parser);
+static void parse_cached(surgescript_parser_t* parser, const char* code, size_t length);
+static char* cache_filepath(const surgescript_parser_t* parser, const char* code, size_t length);
+static void hash_name(const char* name, void* state);
+static void hash_native_object(const char* object_name, void* data);
+static bool is_native_object(surgescript_programpool_t* pool, const char* object_name);
+static void check_native(const char* program_name, void* data);
 static inline bool got_type(surgescript_parser_t* parser, surgescript_tokentype_t symbol);
 static inline bool has_token(surgescript_parser_t* parser);
 static void match(surgescript_parser_t* parser, surgescript_tokentype_t symbol);
 static bool optmatch(surgescript_parser_t* parser, surgescript_tokentype_t symbol);
 static void match_exactly(surgescript_parser_t* parser, surgescript_tokentype_t symbol, const char* lexeme);
 static void unmatch(surgescript_parser_t* parser);
+static void rewind_to(surgescript_parser_t* parser, surgescript_token_t* token);
 static void expect(surgescript_parser_t* parser, surgescript_tokentype_t symbol);
 static void expect_something(surgescript_parser_t* parser);
 static void expect_exactly(surgescript_parser_t* parser, surgescript_tokentype_t symbol, const char* lexeme);
@@ -74,6 +87,8 @@ static void make_accessor(const char* fun_name, void* symtable);
 static void init_plugins_list(surgescript_parser_t* parser);
 static void add_to_plugins_list(surgescript_parser_t* parser, const char* plugin_name);
 static void release_plugins_list(surgescript_parser_t* parser);
+static void add_to_objects_list(surgescript_parser_t* parser, const char* object_name, bool check_repeated);
+static void release_objects_list(surgescript_parser_t* parser);
 static surgescript_symtable_t* configure_base_table(surgescript_symtable_t* base_table);
 static void read_annotations(surgescript_parser_t* parser, char*** annotations);
 static void release_annotations(char** annotations);
@@ -94,8 +109,8 @@ static void object(surgescript_parser_t* parser);
 static void objectdecl(surgescript_parser_t* parser, surgescript_nodecontext_t context);
 static void qualifiers(surgescript_parser_t* parser, surgescript_nodecontext_t context);
 
-static void vardecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context);
-static void vardecl(surgescript_parser_t* parser, surgescript_nodecontext_t context);
+static void vardecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context, surgescript_nodecontext_t init_context);
+static void vardecl(surgescript_parser_t* parser, surgescript_nodecontext_t context, surgescript_nodecontext_t init_context);
 static void statedecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context);
 static void statedecl(surgescript_parser_t* parser, surgescript_nodecontext_t context);
 static void fundecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context);
@@ -160,7 +175,10 @@ surgescript_parser_t* surgescript_parser_create(surgescript_programpool_t* progr
     parser->tag_system = tag_system;
     parser->base_table = NULL;
     parser->flags = SSPARSER_DEFAULTS;
+    parser->cache_directory = NULL;
+    parser->cacheable = false;
     init_plugins_list(parser);
+    ssarray_init(parser->known_objects);
     setlocale(LC_NUMERIC, "C"); /* use '.' as the decimal separator on atof() */
     return parser;
 }
@@ -171,6 +189,8 @@ surgescript_parser_t* surgescript_parser_create(surgescript_programpool_t* progr
  */
 surgescript_parser_t* surgescript_parser_destroy(surgescript_parser_t* parser)
 {
+    if(parser->cache_directory)
+        ssfree(parser->cache_directory);
     ssfree(parser->filename);
     surgescript_lexer_destroy(parser->lexer);
     if(parser->lookahead)
@@ -179,6 +199,7 @@ surgescript_parser_t* surgescript_parser_destroy(surgescript_parser_t* parser)
         surgescript_token_destroy(parser->previous);
     if(parser->base_table)
         surgescript_symtable_destroy(parser->base_table);
+    release_objects_list(parser);
     release_plugins_list(parser);
     return ssfree(parser);
 }
@@ -194,22 +215,38 @@ bool surgescript_parser_parsefile(surgescript_parser_t* parser, const char* abso
         const size_t BUFSIZE = 1024;
         char* data = NULL;
         size_t read_chars = 0, data_size = 0;
+        long file_size;
 
-        /* read file to data[] */
+        /* get the size of the file, if possible */
+        if(fseek(fp, 0, SEEK_END) == 0 && (file_size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+            data_size = (size_t)file_size;
+
+        /* read file to data[] (in a single call if we know its size) */
         sslog("Reading file %s...", absolute_path);
-        do {
+        data = ssmalloc(data_size + 1);
+        for(;;) {
+            int c;
+            read_chars += fread(data + read_chars, sizeof(char), data_size - read_chars, fp);
+            if(read_chars < data_size || (c = fgetc(fp)) == EOF)
+                break;
+
+            /* the size of the file is unknown */
             data_size += BUFSIZE;
             data = ssrealloc(data, data_size + 1);
-            read_chars += fread(data + read_chars, sizeof(char), BUFSIZE, fp);
-            data[read_chars] = '\0';
-        } while(read_chars == data_size);
+            data[read_chars++] = c;
+        }
+        data[read_chars] = '\0';
         fclose(fp);
 
         /* parse it */
         ssfree(parser->filename);
         parser->filename = ssstrdup(surgescript_util_basename(absolute_path));
-        surgescript_lexer_set(parser->lexer, data);
-        parse(parser);
+        if(parser->cache_directory == NULL) {
+            surgescript_lexer_set(parser->lexer, data);
+            parse(parser);
+        }
+        else
+            parse_cached(parser, data, read_chars);
 
         /* done! */
         ssfree(data);
@@ -257,6 +294,37 @@ void surgescript_parser_foreach_plugin(surgescript_parser_t* parser, void* data,
         fun(parser->known_plugins[i], data);
 }
 
+/*
+ * surgescript_parser_foreach_object()
+ * Calls fun() for each object defined in any parsed script, in order of definition
+ */
+void surgescript_parser_foreach_object(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*))
+{
+    for(int i = 0; i < ssarray_length(parser->known_objects); i++)
+        fun(parser->known_objects[i], data);
+}
+
+/*
+ * surgescript_parser_add_object()
+ * Adds an object to the list of defined objects, as if it had been found
+ * in a parsed script (used when loading precompiled bytecode). The object
+ * must not be in the list already
+ */
+void surgescript_parser_add_object(surgescript_parser_t* parser, const char* object_name)
+{
+    add_to_objects_list(parser, object_name, false);
+}
+
+/*
+ * surgescript_parser_add_plugin()
+ * Adds a plugin to the list of known plugins, as if it had been found
+ * in a parsed script (used when loading precompiled bytecode)
+ */
+void surgescript_parser_add_plugin(surgescript_parser_t* parser, const char* object_name)
+{
+    add_to_plugins_list(parser, object_name);
+}
+
 
 
 /*
@@ -279,6 +347,30 @@ surgescript_parser_flags_t surgescript_parser_get_flags(surgescript_parser_t* pa
 }
 
 
+/*
+ * surgescript_parser_set_cache_directory()
+ * Enables the compile cache: the output of the compiler is stored in the
+ * given directory, so that unchanged files are loaded from there the next
+ * time they're parsed instead of being compiled again. Pass NULL to disable
+ */
+void surgescript_parser_set_cache_directory(surgescript_parser_t* parser, const char* directory)
+{
+    if(parser->cache_directory)
+        ssfree(parser->cache_directory);
+
+    parser->cache_directory = directory ? ssstrdup(directory) : NULL;
+}
+
+/*
+ * surgescript_parser_get_cache_directory()
+ * The directory of the compile cache, or NULL if it's disabled
+ */
+const char* surgescript_parser_get_cache_directory(surgescript_parser_t* parser)
+{
+    return parser->cache_directory;
+}
+
+
 /* privates & helpers */
 
 
@@ -293,6 +385,132 @@ void parse(surgescript_parser_t* parser)
     parser->base_table = surgescript_symtable_destroy(parser->base_table);
 }
 
+/* parses a script read from a file, using the compile cache */
+void parse_cached(surgescript_parser_t* parser, const char* code, size_t length)
+{
+    char* filepath = cache_filepath(parser, code, length);
+    char* tmp_filepath;
+    FILE* fp;
+    int first_object;
+
+    /* other flags make the output depend on the scripts parsed before */
+    if(parser->flags != SSPARSER_DEFAULTS) {
+        surgescript_lexer_set(parser->lexer, code);
+        parse(parser);
+        ssfree(filepath);
+        return;
+    }
+
+    /* is the file in the cache? */
+    if(NULL != (fp = surgescript_util_fopen_utf8(filepath, "rb"))) {
+        fclose(fp);
+        if(surgescript_bytecode_load_new(filepath, parser->program_pool, parser->tag_system, parser)) {
+            sslog("Loaded %s from the compile cache", parser->filename);
+            ssfree(filepath);
+            return;
+        }
+    }
+
+    /* it isn't; parse it */
+    first_object = ssarray_length(parser->known_objects);
+    parser->cacheable = true;
+    surgescript_lexer_set(parser->lexer, code);
+    parse(parser);
+
+    /* the code of an object depends on the programs it already had (native
+       accessors are part of the key of the cache, but not other programs) */
+    if(!parser->cacheable) {
+        ssfree(filepath);
+        return;
+    }
+
+    /* store the objects of the file in the cache. Write to a temporary
+       file first, so that an incomplete file is never read */
+    tmp_filepath = ssmalloc((strlen(filepath) + 5) * sizeof(char));
+    strcpy(tmp_filepath, filepath);
+    strcat(tmp_filepath, ".tmp");
+    if(!surgescript_util_mkdir_utf8(parser->cache_directory))
+        sslog("Can't create the compile cache at \"%s\"", parser->cache_directory);
+    else if(!surgescript_bytecode_save_objects(tmp_filepath, parser->program_pool, parser->tag_system, parser, (const char**)(parser->known_objects + first_object), ssarray_length(parser->known_objects) - first_object))
+        remove(tmp_filepath);
+    else if(!surgescript_util_rename_utf8(tmp_filepath, filepath)) {
+        sslog("Can't write \"%s\" to the compile cache", filepath);
+        remove(tmp_filepath);
+    }
+
+    /* done */
+    ssfree(tmp_filepath);
+    ssfree(filepath);
+}
+
+/* the path of the cached output of a script. The file is named after a hash of
+   the code, of the name of the script, of the version of SurgeScript, of the
+   programs of Object, whose accessors are imported by all objects, and of the
+   programs of the objects that only have native programs (bound by the host or
+   by the standard library, e.g., Application), whose accessors are imported
+   by the scripts that define these objects */
+char* cache_filepath(const surgescript_parser_t* parser, const char* code, size_t length)
+{
+    const char* version = surgescript_util_version();
+    size_t size = strlen(parser->cache_directory) + 32 + sizeof(SURGESCRIPT_BYTECODE_EXTENSION);
+    char* filepath = ssmalloc(size * sizeof(char));
+    XXH64_state_t state;
+    void* data[] = { parser->program_pool, &state };
+    uint64_t hash;
+
+    XXH64_reset(&state, 0);
+    XXH64_update(&state, version, strlen(version) + 1);
+    XXH64_update(&state, parser->filename, strlen(parser->filename) + 1);
+    surgescript_programpool_foreach_ex(parser->program_pool, "Object", &state, hash_name);
+    surgescript_programpool_foreach_object(parser->program_pool, data, hash_native_object);
+    XXH64_update(&state, code, length);
+    hash = XXH64_digest(&state);
+
+    snprintf(filepath, size, "%s/%08x%08x%s", parser->cache_directory,
+        (unsigned)(hash >> 32), (unsigned)(hash & 0xFFFFFFFF), SURGESCRIPT_BYTECODE_EXTENSION);
+    return filepath;
+}
+
+/* adds a name to a hash */
+void hash_name(const char* name, void* state)
+{
+    XXH64_update((XXH64_state_t*)state, name, strlen(name) + 1);
+}
+
+/* adds the name of an object and the names of its programs to a hash, if it only has native programs */
+void hash_native_object(const char* object_name, void* data)
+{
+    surgescript_programpool_t* pool = (surgescript_programpool_t*)(((void**)data)[0]);
+    XXH64_state_t* state = (XXH64_state_t*)(((void**)data)[1]);
+
+    if(is_native_object(pool, object_name)) {
+        hash_name(object_name, state);
+        surgescript_programpool_foreach_ex(pool, object_name, state, hash_name);
+    }
+}
+
+/* does the object only have native programs? */
+bool is_native_object(surgescript_programpool_t* pool, const char* object_name)
+{
+    bool native = true;
+    void* data[] = { pool, (void*)object_name, &native };
+
+    surgescript_programpool_foreach_ex(pool, object_name, data, check_native);
+    return native;
+}
+
+/* clears a flag if a program of an object isn't native */
+void check_native(const char* program_name, void* data)
+{
+    surgescript_programpool_t* pool = (surgescript_programpool_t*)(((void**)data)[0]);
+    const char* object_name = (const char*)(((void**)data)[1]);
+    bool* native = (bool*)(((void**)data)[2]);
+    const surgescript_program_t* program = surgescript_programpool_get(pool, object_name, program_name);
+
+    if(program != NULL && !surgescript_program_is_native(program))
+        *native = false;
+}
+
 /* does the lookahead symbol have the given type? */
 bool got_type(surgescript_parser_t* parser, surgescript_tokentype_t symbol)
 {
@@ -345,6 +563,15 @@ void unmatch(surgescript_parser_t* parser)
         ssfatal("Parse Error: can\'t unmatch symbol on %s.", parser->filename);
 }
 
+/* rewinds the parser, so that the given token is the lookahead again */
+void rewind_to(surgescript_parser_t* parser, surgescript_token_t* token)
+{
+    surgescript_lexer_unscan(parser->lexer, token);
+    if(parser->lookahead)
+        surgescript_token_destroy(parser->lookahead);
+    parser->lookahead = surgescript_lexer_scan(parser->lexer);
+}
+
 /* throw an error if the lookahead is not of the expected type */
 void expect(surgescript_parser_t* parser, surgescript_tokentype_t symbol)
 {
@@ -632,13 +859,20 @@ void object(surgescript_parser_t* parser)
         surgescript_program_create(0) /* object constructor */
     );
 
+    /* the compile cache knows about the native programs an object already has
+       (see cache_filepath()), but not about the ones written in SurgeScript */
+    if(!is_native_object(parser->program_pool, object_name))
+        parser->cacheable = false;
+
     /* validate */
     if(is_large_name(object_name))
         ssfatal("Compile Error: object name \"%s\" is too large at %s:%d", object_name, parser->filename, surgescript_token_linenumber(parser->lookahead));
     else if(!is_valid_name(object_name))
         ssfatal("Compile Error: invalid object name \"%s\" in %s:%d.", object_name, parser->filename, surgescript_token_linenumber(parser->lookahead));
     else if((duplicate = surgescript_programpool_exists(parser->program_pool, object_name, "state:main"))) {
-        if(parser->flags & SSPARSER_SKIP_DUPLICATES) {
+        if((parser->flags & SSPARSER_REPLACE_DUPLICATES) && (!forbid_duplicates(parser, object_name) || strcmp(object_name, "Application") == 0))
+            remove_object_definition(parser->program_pool, object_name); /* hot reload (the Application is also written in SurgeScript) */
+        else if(parser->flags & SSPARSER_SKIP_DUPLICATES) {
             char buf[32] = { '.', 'd', 'u', 'p', '.' };
             sslog("Warning: skipping duplicate definition of object \"%s\" in %s:%d.", object_name, parser->filename, surgescript_token_linenumber(parser->lookahead));
             ssfree(object_name);
@@ -662,6 +896,7 @@ void object(surgescript_parser_t* parser)
 
     /* object configuration */
     process_annotations(parser, annotations, object_name);
+    surgescript_program_optimize(context.program);
     surgescript_programpool_put(parser->program_pool, object_name, "__ssconstructor", context.program);
     if(!surgescript_programpool_shallowcheck(parser->program_pool, object_name, "get___file"))
         surgescript_programpool_put(parser->program_pool, object_name, "get___file", make_file_program(context.source_file));
@@ -669,6 +904,8 @@ void object(surgescript_parser_t* parser)
     /* cleanup */
     if(duplicate && (parser->flags & SSPARSER_SKIP_DUPLICATES))
         remove_object_definition(parser->program_pool, object_name);
+    else
+        add_to_objects_list(parser, object_name, duplicate);
     surgescript_symtable_destroy(context.symtable);
     release_annotations(annotations);
     ssfree(object_name);
@@ -678,6 +915,11 @@ void objectdecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 {
     surgescript_program_label_t start = surgescript_program_new_label(context.program);
     surgescript_program_label_t end = surgescript_program_new_label(context.program);
+    surgescript_nodecontext_t layout_context, init_context;
+
+    /* the initializers of the variables may be run one by one (hot reload) */
+    init_context = nodecontext(context.source_file, context.object_name, "__ssinitvar", context.symtable, surgescript_program_create(1));
+    layout_context = nodecontext(context.source_file, context.object_name, "__sslayout", context.symtable, surgescript_program_create(0));
 
     /* import properties */
     import_public_vars(parser, context, "Object");
@@ -687,7 +929,7 @@ void objectdecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
     emit_object_header(context, start, end);
 
     /* read non-terminals */
-    vardecllist(parser, context);
+    vardecllist(parser, context, init_context);
     statedecllist(parser, context);
     fundecllist(parser, context);
 
@@ -696,6 +938,13 @@ void objectdecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
 
     /* tell the program how many variables should be allocated */
     emit_object_footer(context, start, end);
+
+    /* describe the variables for a hot reload */
+    emit_ret(init_context);
+    emit_object_layout(layout_context);
+    surgescript_program_optimize(init_context.program);
+    surgescript_programpool_put(parser->program_pool, context.object_name, init_context.program_name, init_context.program);
+    surgescript_programpool_put(parser->program_pool, context.object_name, layout_context.program_name, layout_context.program);
 }
 
 void qualifiers(surgescript_parser_t* parser, surgescript_nodecontext_t context)
@@ -761,24 +1010,35 @@ void importlist(surgescript_parser_t* parser)
     }
 }
 
-void vardecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context)
+void vardecllist(surgescript_parser_t* parser, surgescript_nodecontext_t context, surgescript_nodecontext_t init_context)
 {
     while(got_type(parser, SSTOK_IDENTIFIER) || got_type(parser, SSTOK_PUBLIC))
-        vardecl(parser, context);
+        vardecl(parser, context, init_context);
 }
 
-void vardecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
+void vardecl(surgescript_parser_t* parser, surgescript_nodecontext_t context, surgescript_nodecontext_t init_context)
 {
     bool public_var = optmatch(parser, SSTOK_PUBLIC);
     bool readonly_var = optmatch(parser, SSTOK_READONLY);
     char* id = ssstrdup(surgescript_token_lexeme(parser->lookahead));
+    surgescript_program_label_t next = surgescript_program_new_label(init_context.program);
+    surgescript_token_t* initializer;
 
     match(parser, SSTOK_IDENTIFIER);
     match_exactly(parser, SSTOK_ASSIGNOP, "=");
+    expect_something(parser);
+
+    /* the initializer is compiled twice: in the constructor and alone */
+    initializer = surgescript_token_clone(parser->lookahead);
     conditionalexpr(parser, context);
+    rewind_to(parser, initializer);
+    emit_varinit1(init_context, id, next);
+    conditionalexpr(parser, init_context);
+    surgescript_token_destroy(initializer);
     match(parser, SSTOK_SEMICOLON);
 
     emit_vardecl(context, id);
+    emit_varinit2(init_context, id, next);
     if(public_var) {
         create_getter(parser, context, id);
         if(!readonly_var)
@@ -822,6 +1082,7 @@ void statedecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
         surgescript_symtable_create(context.symtable), /* new symbol table for local variables */
         surgescript_program_create(0)
     );
+    context.temp = 0; /* expression temporaries are kept in the stack frame */
 
     /* duplicate check */
     if(surgescript_programpool_shallowcheck(parser->program_pool, context.object_name, program_name))
@@ -835,6 +1096,7 @@ void statedecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
     match(parser, SSTOK_RCURLY);
 
     /* register the function and cleanup */
+    surgescript_program_optimize(context.program);
     surgescript_programpool_put(parser->program_pool, context.object_name, program_name, context.program);
     surgescript_symtable_destroy(context.symtable);
     ssfree(program_name);
@@ -887,6 +1149,7 @@ void fundecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
         surgescript_symtable_create(context.symtable), /* new symbol table for local variables */
         surgescript_program_create(num_arguments)
     );
+    context.temp = 0; /* expression temporaries are kept in the stack frame */
 
     /* write list of arguments to the symbol table */
     for(i = 0; i < num_arguments; i++) {
@@ -902,6 +1165,7 @@ void fundecl(surgescript_parser_t* parser, surgescript_nodecontext_t context)
     match(parser, SSTOK_RCURLY);
 
     /* register the function and cleanup */
+    surgescript_program_optimize(context.program);
     surgescript_programpool_put(parser->program_pool, context.object_name, program_name, context.program);
     surgescript_symtable_destroy(context.symtable);
     ssarray_release(arg);
@@ -1020,7 +1284,7 @@ void equalityexpr(surgescript_parser_t* parser, surgescript_nodecontext_t contex
         char* op = ssstrdup(surgescript_token_lexeme(parser->lookahead));
         match(parser, SSTOK_EQUALITYOP);
         emit_equalityexpr1(context);
-        relationalexpr(parser, context);
+        relationalexpr(parser, rightoperand(context));
         emit_equalityexpr2(context, op);
         ssfree(op);
     }
@@ -1033,7 +1297,7 @@ void relationalexpr(surgescript_parser_t* parser, surgescript_nodecontext_t cont
         char* op = ssstrdup(surgescript_token_lexeme(parser->lookahead));
         match(parser, SSTOK_RELATIONALOP);
         emit_relationalexpr1(context);
-        additiveexpr(parser, context);
+        additiveexpr(parser, rightoperand(context));
         emit_relationalexpr2(context, op);
         ssfree(op);
     }
@@ -1046,7 +1310,7 @@ void additiveexpr(surgescript_parser_t* parser, surgescript_nodecontext_t contex
         char* op = ssstrdup(surgescript_token_lexeme(parser->lookahead));
         match(parser, SSTOK_ADDITIVEOP);
         emit_additiveexpr1(context);
-        multiplicativeexpr(parser, context);
+        multiplicativeexpr(parser, rightoperand(context));
         emit_additiveexpr2(context, op);
         ssfree(op);
     }
@@ -1059,7 +1323,7 @@ void multiplicativeexpr(surgescript_parser_t* parser, surgescript_nodecontext_t
         char* op = ssstrdup(surgescript_token_lexeme(parser->lookahead));
         match(parser, SSTOK_MULTIPLICATIVEOP);
         emit_multiplicativeexpr1(context);
-        unaryexpr(parser, context);
+        unaryexpr(parser, rightoperand(context));
         emit_multiplicativeexpr2(context, op);
         ssfree(op);
     }
@@ -1680,6 +1944,27 @@ void add_to_plugins_list(surgescript_parser_t* parser, const char* plugin_name)
     ssarray_push(parser->known_plugins, ssstrdup(plugin_name));
 }
 
+void add_to_objects_list(surgescript_parser_t* parser, const char* object_name, bool check_repeated)
+{
+    /* a redefined object keeps its place in the list */
+    if(check_repeated) {
+        for(int i = 0; i < ssarray_length(parser->known_objects); i++) {
+            if(strcmp(parser->known_objects[i], object_name) == 0)
+                return;
+        }
+    }
+
+    /* add to the objects list */
+    ssarray_push(parser->known_objects, ssstrdup(object_name));
+}
+
+void release_objects_list(surgescript_parser_t* parser)
+{
+    for(int i = 0; i < ssarray_length(parser->known_objects); i++)
+        ssfree(parser->known_objects[i]);
+    ssarray_release(parser->known_objects);
+}
+
 surgescript_symtable_t* configure_base_table(surgescript_symtable_t* base_table)
 {
     const char** builtins = surgescript_objectmanager_builtin_objects(NULL);
@@ -142,6 +142,7 @@ typedef enum surgescript_parser_flags_t {
     SSPARSER_DEFAULTS = 0, /* default configuration */
     SSPARSER_ALLOW_DUPLICATES = 1, /* allow duplicate objects */
     SSPARSER_SKIP_DUPLICATES = 2, /* skip duplicate objects */
+    SSPARSER_REPLACE_DUPLICATES = 4, /* silently replace duplicate objects (hot reload) */
 } surgescript_parser_flags_t;
 
 /* create & destroy */
@@ -152,7 +153,12 @@ surgescript_parser_t* surgescript_parser_destroy(surgescript_parser_t* parser);
 bool surgescript_parser_parsefile(surgescript_parser_t* parser, const char* absolute_path); /* parse a script file */
 bool surgescript_parser_parsemem(surgescript_parser_t* parser, const char* code_in_memory); /* parse a script (in memory) */
 void surgescript_parser_foreach_plugin(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*)); /* foreach plugin object found in any parsed script, run fun(object_name, data) */
+void surgescript_parser_foreach_object(surgescript_parser_t* parser, void* data, void (*fun)(const char*,void*)); /* foreach object defined in any parsed script, run fun(object_name, data) */
+void surgescript_parser_add_object(surgescript_parser_t* parser, const char* object_name); /* adds a known object (e.g., read from precompiled bytecode) */
+void surgescript_parser_add_plugin(surgescript_parser_t* parser, const char* object_name); /* adds a known plugin (e.g., read from precompiled bytecode) */
 void surgescript_parser_set_flags(surgescript_parser_t* parser, surgescript_parser_flags_t flags); /* set parser options (flags) */
 surgescript_parser_flags_t surgescript_parser_get_flags(surgescript_parser_t* parser); /* get parser flags */
+void surgescript_parser_set_cache_directory(surgescript_parser_t* parser, const char* directory); /* enable the compile cache (NULL disables it) */
+const char* surgescript_parser_get_cache_directory(surgescript_parser_t* parser); /* the directory of the compile cache, or NULL */
 
 #endif
@@ -27,11 +27,18 @@
 #include "../runtime/object.h"
 #include "../util/ssarray.h"
 #include "../util/util.h"
+#define XXH_INLINE_ALL
+#include "../util/xxhash.h"
 
 /* utilities */
 typedef struct surgescript_symtable_entry_t surgescript_symtable_entry_t;
 typedef struct surgescript_symtable_entry_vtable_t surgescript_symtable_entry_vtable_t;
 static int indexof_symbol(surgescript_symtable_t* symtable, const char* symbol);
+static int find_symbol(const surgescript_symtable_t* symtable, const char* symbol, uint32_t hash);
+static void add_entry(surgescript_symtable_t* symtable, surgescript_symtable_entry_t entry);
+static void grow_buckets(surgescript_symtable_t* symtable);
+static inline uint32_t hash_symbol(const char* symbol);
+static const int INITIAL_BUCKET_COUNT = 16; /* must be a power of two */
 static void read_from_heap(surgescript_symtable_entry_t* entry, surgescript_program_t* program, unsigned k);
 static void read_from_stack(surgescript_symtable_entry_t* entry, surgescript_program_t* program, unsigned k);
 static void write_to_heap(surgescript_symtable_entry_t* entry, surgescript_program_t* program, unsigned k);
@@ -62,6 +69,7 @@ static const surgescript_symtable_entry_vtable_t staticvt = { read_static, write
 struct surgescript_symtable_entry_t
 {
     char* symbol;
+    uint32_t hash; /* hash of the symbol */
     union {
         surgescript_heapptr_t heapaddr;
         surgescript_stackptr_t stackaddr;
@@ -74,6 +82,8 @@ struct surgescript_symtable_t
 {
     surgescript_symtable_t* parent; /* pointer to its parent (parent scope) */
     SSARRAY(surgescript_symtable_entry_t, entry); /* an entry of the symbol table */
+    int* bucket; /* open addressing: bucket[j] is 1 + the index of an entry, or 0 if it's empty */
+    int bucket_mask; /* number of buckets - 1 (the number of buckets is a power of two) */
 };
 
 
@@ -88,6 +98,9 @@ surgescript_symtable_t* surgescript_symtable_create(surgescript_symtable_t* pare
     surgescript_symtable_t* symtable = ssmalloc(sizeof *symtable);
     symtable->parent = parent;
     ssarray_init(symtable->entry);
+    symtable->bucket = ssmalloc(INITIAL_BUCKET_COUNT * sizeof(*(symtable->bucket)));
+    symtable->bucket_mask = INITIAL_BUCKET_COUNT - 1;
+    memset(symtable->bucket, 0, INITIAL_BUCKET_COUNT * sizeof(*(symtable->bucket)));
     return symtable;
 }
 
@@ -101,6 +114,7 @@ surgescript_symtable_t* surgescript_symtable_destroy(surgescript_symtable_t* sym
         ssfree(symtable->entry[i].symbol);
 
     ssarray_release(symtable->entry);
+    ssfree(symtable->bucket);
     return ssfree(symtable); /* don't mess with the parent */
 }
 
@@ -110,8 +124,10 @@ surgescript_symtable_t* surgescript_symtable_destroy(surgescript_symtable_t* sym
  */
 bool surgescript_symtable_has_symbol(surgescript_symtable_t* symtable, const char* symbol)
 {
+    uint32_t hash = hash_symbol(symbol);
+
     while(symtable) {
-        if(indexof_symbol(symtable, symbol) >= 0)
+        if(find_symbol(symtable, symbol, hash) >= 0)
             return true;
         symtable = symtable->parent;
     }
@@ -137,7 +153,7 @@ void surgescript_symtable_put_heap_symbol(surgescript_symtable_t* symtable, cons
     if(indexof_symbol(symtable, symbol) < 0) {
         char* symname = ssstrdup(symbol);
         surgescript_symtable_entry_t entry = { .symbol = symname, .heapaddr = address, .vtable = &heapvt };
-        ssarray_push(symtable->entry, entry);
+        add_entry(symtable, entry);
     }
     else
         ssfatal("Compile Error: duplicate entry of symbol \"%s\".", symbol);
@@ -152,7 +168,7 @@ void surgescript_symtable_put_stack_symbol(surgescript_symtable_t* symtable, con
     if(indexof_symbol(symtable, symbol) < 0) {
         char* symname = ssstrdup(symbol);
         surgescript_symtable_entry_t entry = { .symbol = symname, .stackaddr = address, .vtable = &stackvt };
-        ssarray_push(symtable->entry, entry);
+        add_entry(symtable, entry);
     }
     else
         ssfatal("Compile Error: duplicate entry of symbol \"%s\".", symbol);
@@ -167,7 +183,7 @@ void surgescript_symtable_put_accessor_symbol(surgescript_symtable_t* symtable,
     if(indexof_symbol(symtable, symbol) < 0) {
         char* symname = ssstrdup(symbol);
         surgescript_symtable_entry_t entry = { .symbol = symname, .vtable = &accvt };
-        ssarray_push(symtable->entry, entry);
+        add_entry(symtable, entry);
     }
     else
         ssfatal("Compile Error: duplicate entry of symbol \"%s\".", symbol);
@@ -182,7 +198,7 @@ void surgescript_symtable_put_plugin_symbol(surgescript_symtable_t* symtable, co
     if(indexof_symbol(symtable, plugin_symbol(path)) < 0) {
         char* symname = pack_plugin_path(path);
         surgescript_symtable_entry_t entry = { .symbol = symname, .vtable = &pluginvt };
-        ssarray_push(symtable->entry, entry);
+        add_entry(symtable, entry);
     }
     else
         ssfatal("Compile Error: found duplicate symbol \"%s\" when importing \"%s\" in %s.", plugin_symbol(path), path, filename);
@@ -197,7 +213,7 @@ void surgescript_symtable_put_static_symbol(surgescript_symtable_t* symtable, co
     if(indexof_symbol(symtable, symbol) < 0) {
         char* symname = ssstrdup(symbol);
         surgescript_symtable_entry_t entry = { .symbol = symname, .vtable = &staticvt };
-        ssarray_push(symtable->entry, entry);
+        add_entry(symtable, entry);
     }
     else
         ssfatal("Compile Error: duplicate entry of symbol \"%s\".", symbol);
@@ -209,16 +225,19 @@ void surgescript_symtable_put_static_symbol(surgescript_symtable_t* symtable, co
  */
 void surgescript_symtable_emit_write(surgescript_symtable_t* symtable, const char* symbol, surgescript_program_t* program, unsigned k)
 {
+    uint32_t hash = hash_symbol(symbol);
     int j;
 
-    if((j = indexof_symbol(symtable, symbol)) >= 0) {
-        surgescript_symtable_entry_t* entry = &(symtable->entry[j]);
-        entry->vtable->write(entry, program, k);
+    /* look for the symbol in this scope, then in the parent scopes */
+    for(; symtable != NULL; symtable = symtable->parent) {
+        if((j = find_symbol(symtable, symbol, hash)) >= 0) {
+            surgescript_symtable_entry_t* entry = &(symtable->entry[j]);
+            entry->vtable->write(entry, program, k);
+            return;
+        }
     }
-    else if(symtable->parent)
-        surgescript_symtable_emit_write(symtable->parent, symbol, program, k);
-    else
-        ssfatal("Compile Error: undefined symbol \"%s\".", symbol);
+
+    ssfatal("Compile Error: undefined symbol \"%s\".", symbol);
 }
 
 /*
@@ -227,16 +246,19 @@ void surgescript_symtable_emit_write(surgescript_symtable_t* symtable, const cha
  */
 void surgescript_symtable_emit_read(surgescript_symtable_t* symtable, const char* symbol, surgescript_program_t* program, unsigned k)
 {
+    uint32_t hash = hash_symbol(symbol);
     int j;
 
-    if((j = indexof_symbol(symtable, symbol)) >= 0) {
-        surgescript_symtable_entry_t* entry = &(symtable->entry[j]);
-        entry->vtable->read(entry, program, k);
+    /* look for the symbol in this scope, then in the parent scopes */
+    for(; symtable != NULL; symtable = symtable->parent) {
+        if((j = find_symbol(symtable, symbol, hash)) >= 0) {
+            surgescript_symtable_entry_t* entry = &(symtable->entry[j]);
+            entry->vtable->read(entry, program, k);
+            return;
+        }
     }
-    else if(symtable->parent)
-        surgescript_symtable_emit_read(symtable->parent, symbol, program, k);
-    else
-        ssfatal("Compile Error: undefined symbol \"%s\".", symbol);
+
+    ssfatal("Compile Error: undefined symbol \"%s\".", symbol);
 }
 
 /*
@@ -267,20 +289,80 @@ bool surgescript_symtable_has_parent(surgescript_symtable_t* symtable)
     return symtable->parent != NULL;
 }
 
+/*
+ * surgescript_symtable_foreach_heap_symbol()
+ * Iterates over the symbols stored on the heap, in the order they were put
+ * on this table. The symbols of the parent tables are not included
+ */
+void surgescript_symtable_foreach_heap_symbol(surgescript_symtable_t* symtable, void* data, void (*callback)(const char* symbol, surgescript_heapptr_t address, void* data))
+{
+    for(int i = 0; i < ssarray_length(symtable->entry); i++) {
+        const surgescript_symtable_entry_t* entry = &(symtable->entry[i]);
+        if(entry->vtable == &heapvt)
+            callback(entry->symbol, entry->heapaddr, data);
+    }
+}
+
 
 /* private stuff */
 
 /* returns i such that symtable->entry[i].symbol == symbol, or -1 if not found */
 int indexof_symbol(surgescript_symtable_t* symtable, const char* symbol)
 {
-    for(int i = 0; i < ssarray_length(symtable->entry); i++) {
-        if(strcmp(symtable->entry[i].symbol, symbol) == 0)
-            return i;
+    return find_symbol(symtable, symbol, hash_symbol(symbol));
+}
+
+/* indexof_symbol() given the hash of the symbol (no parent scopes) */
+int find_symbol(const surgescript_symtable_t* symtable, const char* symbol, uint32_t hash)
+{
+    for(uint32_t j = hash & symtable->bucket_mask; symtable->bucket[j] != 0; j = (j + 1) & symtable->bucket_mask) {
+        const surgescript_symtable_entry_t* entry = &(symtable->entry[symtable->bucket[j] - 1]);
+        if(entry->hash == hash && strcmp(entry->symbol, symbol) == 0)
+            return symtable->bucket[j] - 1;
     }
 
     return -1;
 }
 
+/* adds an entry whose symbol isn't in the table */
+void add_entry(surgescript_symtable_t* symtable, surgescript_symtable_entry_t entry)
+{
+    uint32_t j;
+
+    /* keep the load factor at 1/2 at most */
+    if(2 * (ssarray_length(symtable->entry) + 1) > symtable->bucket_mask + 1)
+        grow_buckets(symtable);
+
+    entry.hash = hash_symbol(entry.symbol);
+    ssarray_push(symtable->entry, entry);
+
+    for(j = entry.hash & symtable->bucket_mask; symtable->bucket[j] != 0; j = (j + 1) & symtable->bucket_mask);
+    symtable->bucket[j] = ssarray_length(symtable->entry);
+}
+
+/* doubles the number of buckets, rehashing the entries */
+void grow_buckets(surgescript_symtable_t* symtable)
+{
+    int count = 2 * (symtable->bucket_mask + 1);
+
+    symtable->bucket = ssrealloc(symtable->bucket, count * sizeof(*(symtable->bucket)));
+    symtable->bucket_mask = count - 1;
+    memset(symtable->bucket, 0, count * sizeof(*(symtable->bucket)));
+
+    for(int i = 0; i < ssarray_length(symtable->entry); i++) {
+        uint32_t j = symtable->entry[i].hash & symtable->bucket_mask;
+        while(symtable->bucket[j] != 0)
+            j = (j + 1) & symtable->bucket_mask;
+        symtable->bucket[j] = i + 1;
+    }
+}
+
+/* hashes the symbol (the symbol of a plugin is followed by its path; see pack_plugin_path()) */
+uint32_t hash_symbol(const char* symbol)
+{
+    return XXH32(symbol, strlen(symbol), 0);
+}
+
 void read_from_heap(surgescript_symtable_entry_t* entry, surgescript_program_t* program, unsigned k)
 {
     surgescript_heapptr_t address = entry->heapaddr;
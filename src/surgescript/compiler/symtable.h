@@ -57,4 +57,7 @@ int surgescript_symtable_count(surgescript_symtable_t* symtable); /* including p
 /* does this table have a parent? */
 bool surgescript_symtable_has_parent(surgescript_symtable_t* symtable);
 
+/* iterate over the symbols stored on the heap, in the order they were put (not including parents) */
+void surgescript_symtable_foreach_heap_symbol(surgescript_symtable_t* symtable, void* data, void (*callback)(const char* symbol, surgescript_heapptr_t address, void* data));
+
 #endif
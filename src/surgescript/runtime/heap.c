@@ -19,22 +19,42 @@
  * SurgeScript heap
  */
 
+#include <string.h>
 #include "heap.h"
 #include "variable.h"
+#include "../util/slab.h"
 #include "../util/util.h"
 
 /* constants */
 static const size_t SSHEAP_INITIAL_SIZE = 8;
 static const size_t SSHEAP_MAX_SIZE = 10 * 1024 * 1024; /* 10M cells max */
+static const surgescript_heapptr_t NIL = ~0u; /* end of the list of free cells */
 
-/* heap structure */
-struct surgescript_heap_t
+/* the state of a memory cell */
+typedef struct surgescript_heapcell_t surgescript_heapcell_t;
+struct surgescript_heapcell_t
 {
-    size_t size;                /* size of the heap */
-    surgescript_heapptr_t ptr;  /* allocation pointer */
-    surgescript_var_t** mem;    /* data memory */
+    bool in_use;                /* is the cell allocated? */
+    surgescript_heapptr_t prev; /* free cells below the top are doubly linked */
+    surgescript_heapptr_t next;
 };
 
+/*
+ * The cells at the top of the heap or above it are free. Allocating one of
+ * them increments the top. The free cells below the top (the holes) are kept
+ * in a list, which is used first. Freeing the cell just below the top lowers
+ * the top instead, absorbing the holes below it, and the heap shrinks if
+ * most of it is unused. Therefore, a heap that grows and shrinks at its end
+ * (e.g., an Array) always gets the lowest free address when allocating.
+ */
+
+/* the memory of a heap of the given size, in bytes */
+#define HEAP_BYTES(size)    ((size) * (sizeof(surgescript_var_t) + sizeof(surgescript_heapcell_t)))
+
+static void resize_heap(surgescript_heap_t* heap, size_t new_size);
+static inline void link_hole(surgescript_heap_t* heap, surgescript_heapptr_t ptr);
+static inline void unlink_hole(surgescript_heap_t* heap, surgescript_heapptr_t ptr);
+
 
 /* -------------------------------
  * public methods
@@ -47,15 +67,7 @@ struct surgescript_heap_t
 surgescript_heap_t* surgescript_heap_create()
 {
     surgescript_heap_t* heap = ssmalloc(sizeof *heap);
-    size_t size = SSHEAP_INITIAL_SIZE;
-
-    heap->mem = ssmalloc(size * sizeof(*(heap->mem)));
-    heap->size = size;
-    heap->ptr = size;
-    while(heap->ptr)
-        heap->mem[--heap->ptr] = NULL;
-
-    return heap;
+    return surgescript_heap_init(heap, NULL);
 }
 
 /*
@@ -64,13 +76,47 @@ surgescript_heap_t* surgescript_heap_create()
  */
 surgescript_heap_t* surgescript_heap_destroy(surgescript_heap_t* heap)
 {
-    for(heap->ptr = 0; heap->ptr < heap->size; heap->ptr++) {
-        if(heap->mem[heap->ptr] != NULL)
-            surgescript_var_destroy(heap->mem[heap->ptr]);
+    surgescript_heap_release(heap);
+    return ssfree(heap);
+}
+
+/*
+ * surgescript_heap_init()
+ * Initializes a heap stored in memory owned by the caller. If slab
+ * isn't NULL, the cells of the heap will be allocated from it
+ */
+surgescript_heap_t* surgescript_heap_init(surgescript_heap_t* heap, surgescript_slab_t* slab)
+{
+    heap->mem = NULL;
+    heap->cell = NULL;
+    heap->slab = slab;
+    heap->size = 0;
+    heap->top = 0;
+    heap->hole = NIL;
+    resize_heap(heap, SSHEAP_INITIAL_SIZE);
+
+    return heap;
+}
+
+/*
+ * surgescript_heap_release()
+ * Releases the cells of a heap initialized with surgescript_heap_init()
+ */
+void surgescript_heap_release(surgescript_heap_t* heap)
+{
+    for(surgescript_heapptr_t ptr = 0; ptr < heap->top; ptr++) {
+        if(heap->cell[ptr].in_use)
+            surgescript_var_set_null(&(heap->mem[ptr]));
     }
 
-    ssfree(heap->mem);
-    return ssfree(heap);
+    if(heap->slab != NULL)
+        surgescript_slab_free(heap->slab, heap->mem, HEAP_BYTES(heap->size));
+    else
+        ssfree(heap->mem);
+
+    heap->mem = NULL;
+    heap->cell = NULL;
+    heap->size = heap->top = 0;
 }
 
 /*
@@ -79,26 +125,30 @@ surgescript_heap_t* surgescript_heap_destroy(surgescript_heap_t* heap)
  */
 surgescript_heapptr_t surgescript_heap_malloc(surgescript_heap_t* heap)
 {
-    for(; heap->ptr < heap->size; heap->ptr++) {
-        if(heap->mem[heap->ptr] == NULL) {
-            heap->mem[heap->ptr] = surgescript_var_create();
-            return heap->ptr;
-        }
-    }
+    surgescript_heapptr_t ptr = heap->hole;
 
-    if(heap->size * 2 >= SSHEAP_MAX_SIZE) { /* just in case... */
-        ssfatal("surgescript_heap_malloc(): max size exceeded.");
-        return heap->size - 1;
+    if(ptr != NIL) {
+        /* fill a hole */
+        unlink_hole(heap, ptr);
     }
+    else {
+        /* allocate at the top */
+        if(heap->top == heap->size) {
+            if(heap->size * 2 >= SSHEAP_MAX_SIZE) { /* just in case... */
+                ssfatal("surgescript_heap_malloc(): max size exceeded.");
+                return heap->size - 1;
+            }
 
+            if(heap->size * 2 >= 256)
+                sslog("surgescript_heap_malloc(): resizing heap to %d cells.", heap->size * 2);
+            resize_heap(heap, heap->size * 2);
+        }
 
-    if(heap->size * 2 >= 256)
-        sslog("surgescript_heap_malloc(): resizing heap to %d cells.", heap->size * 2);
-    heap->mem = ssrealloc(heap->mem, (heap->size * 2) * sizeof(*(heap->mem)));
-    while(heap->ptr)
-        heap->mem[heap->size + --(heap->ptr)] = NULL;
-    heap->size *= 2;
-    return surgescript_heap_malloc(heap);
+        ptr = heap->top++;
+    }
+
+    heap->cell[ptr].in_use = true; /* free cells are null */
+    return ptr;
 }
 
 /*
@@ -107,9 +157,21 @@ surgescript_heapptr_t surgescript_heap_malloc(surgescript_heap_t* heap)
  */
 surgescript_heapptr_t surgescript_heap_free(surgescript_heap_t* heap, surgescript_heapptr_t ptr)
 {
-    if(ptr >= 0 && ptr < heap->size && heap->mem[ptr] != NULL) {
-        heap->mem[ptr] = surgescript_var_destroy(heap->mem[ptr]);
-        heap->ptr = ptr;
+    if(ptr >= 0 && ptr < heap->size && heap->cell[ptr].in_use) {
+        surgescript_var_set_null(&(heap->mem[ptr]));
+        heap->cell[ptr].in_use = false;
+
+        if(ptr + 1 == heap->top) {
+            /* lower the top, absorbing the holes below it */
+            while(--heap->top > 0 && !heap->cell[heap->top - 1].in_use)
+                unlink_hole(heap, heap->top - 1);
+
+            /* shrink the heap if most of it is unused */
+            if(heap->size > SSHEAP_INITIAL_SIZE && heap->top <= heap->size / 4)
+                resize_heap(heap, heap->size / 2);
+        }
+        else
+            link_hole(heap, ptr);
     }
 
     return 0;
@@ -117,12 +179,14 @@ surgescript_heapptr_t surgescript_heap_free(surgescript_heap_t* heap, surgescrip
 
 /*
  * surgescript_heap_at()
- * Returns the memory cell pointed by ptr
+ * Returns the memory cell pointed by ptr. The returned pointer is
+ * invalidated if the heap grows or shrinks (see surgescript_heap_malloc
+ * and surgescript_heap_free)
  */
 surgescript_var_t* surgescript_heap_at(const surgescript_heap_t* heap, surgescript_heapptr_t ptr)
 {
-    if(ptr >= 0 && ptr < heap->size && heap->mem[ptr] != NULL)
-        return heap->mem[ptr];
+    if(ptr >= 0 && ptr < heap->size && heap->cell[ptr].in_use)
+        return &(heap->mem[ptr]);
 
     ssfatal("surgescript_heap_at(0x%X): null pointer exception.", ptr);
     return NULL;
@@ -134,12 +198,12 @@ surgescript_var_t* surgescript_heap_at(const surgescript_heap_t* heap, surgescri
  */
 void surgescript_heap_scan_objects(surgescript_heap_t* heap, void* userdata, bool (*callback)(unsigned,void*))
 {
-    for(surgescript_heapptr_t ptr = 0; ptr < heap->size; ptr++) {
-        if(heap->mem[ptr] != NULL) {
-            unsigned handle = surgescript_var_get_objecthandle(heap->mem[ptr]);
+    for(surgescript_heapptr_t ptr = 0; ptr < heap->top; ptr++) {
+        if(heap->cell[ptr].in_use) {
+            unsigned handle = surgescript_var_get_objecthandle(&(heap->mem[ptr]));
             if(handle != 0) { /* if heap->mem[ptr] is an object and not null */
                 if(!callback(handle, userdata)) /* if the handle is broken */
-                    surgescript_var_set_null(heap->mem[ptr]); /* fix it */
+                    surgescript_var_set_null(&(heap->mem[ptr])); /* fix it */
             }
         }
     }
@@ -160,7 +224,7 @@ size_t surgescript_heap_size(const surgescript_heap_t* heap)
  */
 bool surgescript_heap_validaddress(const surgescript_heap_t* heap, surgescript_heapptr_t ptr)
 {
-    return (ptr >= 0 && ptr < heap->size && heap->mem[ptr] != NULL);
+    return (ptr >= 0 && ptr < heap->size && heap->cell[ptr].in_use);
 }
 
 /*
@@ -171,10 +235,67 @@ size_t surgescript_heap_memspent(const surgescript_heap_t* heap)
 {
     size_t size = 0;
 
-    for(surgescript_heapptr_t ptr = 0; ptr < heap->size; ptr++) {
-        if(heap->mem[ptr] != NULL)
-            size += surgescript_var_size(heap->mem[ptr]);
+    for(surgescript_heapptr_t ptr = 0; ptr < heap->top; ptr++) {
+        if(heap->cell[ptr].in_use)
+            size += surgescript_var_size(&(heap->mem[ptr]));
     }
 
     return size;
-}
\ No newline at end of file
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+/* resizes the heap to new_size cells. New cells are free & null.
+   When shrinking, the removed cells must be at the top or above it */
+void resize_heap(surgescript_heap_t* heap, size_t new_size)
+{
+    size_t kept = ssmin(heap->size, new_size);
+    surgescript_var_t* mem = heap->slab != NULL ? surgescript_slab_alloc(heap->slab, HEAP_BYTES(new_size)) : ssmalloc(HEAP_BYTES(new_size));
+    surgescript_heapcell_t* cell = (surgescript_heapcell_t*)(mem + new_size);
+
+    /* mem & cell are allocated together */
+    if(kept > 0) {
+        memcpy(mem, heap->mem, kept * sizeof(*mem));
+        memcpy(cell, heap->cell, kept * sizeof(*cell));
+    }
+    memset(mem + kept, 0, (new_size - kept) * sizeof(*mem));
+    memset(cell + kept, 0, (new_size - kept) * sizeof(*cell));
+
+    /* release the previous memory */
+    if(heap->slab != NULL)
+        surgescript_slab_free(heap->slab, heap->mem, HEAP_BYTES(heap->size));
+    else
+        ssfree(heap->mem);
+
+    heap->mem = mem;
+    heap->cell = cell;
+    heap->size = new_size;
+}
+
+/* adds a free cell below the top to the list of holes */
+void link_hole(surgescript_heap_t* heap, surgescript_heapptr_t ptr)
+{
+    heap->cell[ptr].prev = NIL;
+    heap->cell[ptr].next = heap->hole;
+    if(heap->hole != NIL)
+        heap->cell[heap->hole].prev = ptr;
+    heap->hole = ptr;
+}
+
+/* removes a cell from the list of holes */
+void unlink_hole(surgescript_heap_t* heap, surgescript_heapptr_t ptr)
+{
+    surgescript_heapcell_t* cell = &(heap->cell[ptr]);
+
+    if(cell->prev != NIL)
+        heap->cell[cell->prev].next = cell->next;
+    else
+        heap->hole = cell->next;
+
+    if(cell->next != NIL)
+        heap->cell[cell->next].prev = cell->prev;
+}
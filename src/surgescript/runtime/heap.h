@@ -27,15 +27,30 @@
 
 /* types */
 typedef struct surgescript_heap_t surgescript_heap_t;
-struct surgescript_heap_t;
 typedef unsigned surgescript_heapptr_t;
 
 /* forward declarations */
 struct surgescript_var_t;
+struct surgescript_heapcell_t;
+struct surgescript_slab_t;
+
+/* the heap structure. It's declared here so that it may be stored inline
+   (see object.c), but please use the functions below instead */
+struct surgescript_heap_t
+{
+    size_t size;                         /* size of the heap */
+    surgescript_heapptr_t top;           /* the cells at top or above it are free */
+    surgescript_heapptr_t hole;          /* the first free cell below the top, or NIL */
+    struct surgescript_var_t* mem;       /* data memory (variables are stored inline) */
+    struct surgescript_heapcell_t* cell; /* cell[i] is the state of mem[i]; stored right after mem */
+    struct surgescript_slab_t* slab;     /* the allocator of mem & cell, or NULL */
+};
 
 /* public methods */
 surgescript_heap_t* surgescript_heap_create();
 surgescript_heap_t* surgescript_heap_destroy(surgescript_heap_t* heap);
+surgescript_heap_t* surgescript_heap_init(surgescript_heap_t* heap, struct surgescript_slab_t* slab); /* initializes a heap stored in memory owned by the caller; slab may be NULL */
+void surgescript_heap_release(surgescript_heap_t* heap); /* releases the cells of a heap initialized with surgescript_heap_init() */
 surgescript_heapptr_t surgescript_heap_malloc(surgescript_heap_t* heap);
 surgescript_heapptr_t surgescript_heap_free(surgescript_heap_t* heap, surgescript_heapptr_t ptr);
 struct surgescript_var_t* surgescript_heap_at(const surgescript_heap_t* heap, surgescript_heapptr_t ptr);
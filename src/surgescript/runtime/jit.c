@@ -0,0 +1,1061 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/jit.c
+ * SurgeScript JIT compiler: translates hot programs to x86-64 machine code
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "jit.h"
+#include "program.h"
+#include "variable.h"
+#include "stack.h"
+#include "heap.h"
+#include "object.h"
+#include "renv.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+/* the JIT is available on x86-64 Linux */
+#if defined(__x86_64__) && defined(__linux__) && !defined(SURGESCRIPT_DISABLE_JIT)
+#define USE_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define USE_JIT 0
+#endif
+
+/*
+ * This is a baseline (template) compiler: each line of code is translated
+ * on its own, in a single pass. Numeric arithmetic, comparisons and jumps
+ * are translated to machine code that works directly on the temps, guarded
+ * by type checks. Everything else, as well as the guards that fail, calls
+ * a helper that does what the interpreter does for that operation. Programs
+ * with an operation that can't be translated are left to the interpreter.
+ *
+ * The compiled code is a function that takes a surgescript_jit_frame_t*.
+ * It keeps the address of the temps in rbx, the frame in r12 and the stack
+ * in r13. The code is written to writable pages, which are then made
+ * executable, but no longer writable (W^X).
+ */
+
+/* compiled code */
+struct surgescript_jit_t
+{
+    void (*entry)(surgescript_jit_frame_t*); /* the compiled function */
+    void* memory; /* executable pages */
+    size_t size; /* size of the pages, in bytes */
+};
+
+/* a helper: runs an operation in the same way as the interpreter */
+typedef void (*surgescript_jit_helper_t)(surgescript_jit_frame_t*, uint64_t, uint64_t);
+
+/* a jump to be resolved */
+typedef struct surgescript_jit_patch_t surgescript_jit_patch_t;
+struct surgescript_jit_patch_t
+{
+    int position; /* position of the 32-bit displacement in the code */
+    unsigned line; /* target line */
+};
+
+/* machine code being generated */
+typedef struct surgescript_jit_buffer_t surgescript_jit_buffer_t;
+struct surgescript_jit_buffer_t
+{
+    SSARRAY(uint8_t, byte); /* machine code */
+    SSARRAY(int, offset); /* offset[j] is the position of the code of line j */
+    SSARRAY(surgescript_jit_patch_t, patch); /* jumps to lines of code */
+};
+
+#if USE_JIT
+
+/* helpers */
+static void op_self(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_state(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_caller(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_mov(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movb(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movf(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movs(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movo(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_movx(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_xchg(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_alloc(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_peek(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_poke(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_push(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_pop(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_speek(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_spoke(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_sswap(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_pushn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_popn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_inc(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_dec(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_add(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_sub(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_mul(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_div(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_mod(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_neg(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_lnot(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_lnot2(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_not(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_and(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_or(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_xor(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_test(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_tchk(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_tc01(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_tcmp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_cmp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_call(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_callp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_get(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_cat(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+static void op_tset(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b);
+
+/* the helper of each operation (NULL if there is none) */
+static const surgescript_jit_helper_t helper[] = {
+    [SSOP_SELF] = op_self,
+    [SSOP_STATE] = op_state,
+    [SSOP_CALLER] = op_caller,
+    [SSOP_MOV] = op_mov,
+    [SSOP_MOVN] = op_movn,
+    [SSOP_MOVB] = op_movb,
+    [SSOP_MOVF] = op_movf,
+    [SSOP_MOVS] = op_movs,
+    [SSOP_MOVO] = op_movo,
+    [SSOP_MOVX] = op_movx,
+    [SSOP_XCHG] = op_xchg,
+    [SSOP_ALLOC] = op_alloc,
+    [SSOP_PEEK] = op_peek,
+    [SSOP_POKE] = op_poke,
+    [SSOP_PUSH] = op_push,
+    [SSOP_POP] = op_pop,
+    [SSOP_SPEEK] = op_speek,
+    [SSOP_SPOKE] = op_spoke,
+    [SSOP_SSWAP] = op_sswap,
+    [SSOP_PUSHN] = op_pushn,
+    [SSOP_POPN] = op_popn,
+    [SSOP_INC] = op_inc,
+    [SSOP_DEC] = op_dec,
+    [SSOP_ADD] = op_add,
+    [SSOP_SUB] = op_sub,
+    [SSOP_MUL] = op_mul,
+    [SSOP_DIV] = op_div,
+    [SSOP_MOD] = op_mod,
+    [SSOP_NEG] = op_neg,
+    [SSOP_LNOT] = op_lnot,
+    [SSOP_LNOT2] = op_lnot2,
+    [SSOP_NOT] = op_not,
+    [SSOP_AND] = op_and,
+    [SSOP_OR] = op_or,
+    [SSOP_XOR] = op_xor,
+    [SSOP_TEST] = op_test,
+    [SSOP_TCHK] = op_tchk,
+    [SSOP_TC01] = op_tc01,
+    [SSOP_TCMP] = op_tcmp,
+    [SSOP_CMP] = op_cmp,
+    [SSOP_CALL] = op_call,
+    [SSOP_CALLP] = op_callp,
+    [SSOP_GET] = op_get,
+    [SSOP_CAT] = op_cat,
+    [SSOP_TJE] = op_tset,
+    [SSOP_TJNE] = op_tset,
+    [SSOP_ADDN] = op_add,
+    [SSOP_SUBN] = op_sub,
+    [SSOP_MULN] = op_mul,
+    [SSOP_DIVN] = op_div,
+    [SSOP_INCN] = op_inc,
+    [SSOP_DECN] = op_dec,
+    [SSOP_CMPN] = op_cmp,
+    [SSOP_TC01N] = op_tc01,
+};
+
+static bool translate(surgescript_jit_buffer_t* buf, const surgescript_program_t* program, int ip);
+static bool is_addition(const surgescript_program_t* program, int ip);
+static void emit_bytes(surgescript_jit_buffer_t* buf, const uint8_t* bytes, int count);
+static void emit_u32(surgescript_jit_buffer_t* buf, uint32_t value);
+static void emit_u64(surgescript_jit_buffer_t* buf, uint64_t value);
+static void emit_load_temp(surgescript_jit_buffer_t* buf, int reg, unsigned k);
+static void emit_helper_call(surgescript_jit_buffer_t* buf, surgescript_jit_helper_t fun, uint64_t a, uint64_t b);
+static int emit_forward_jump(surgescript_jit_buffer_t* buf, uint8_t opcode);
+static void emit_jump_to_line(surgescript_jit_buffer_t* buf, uint8_t opcode, unsigned line);
+static void resolve_forward_jump(surgescript_jit_buffer_t* buf, int position);
+static void emit_arithmetic(surgescript_jit_buffer_t* buf, uint8_t sse_opcode, unsigned a, unsigned b, surgescript_jit_helper_t slow, uint64_t op_a, uint64_t op_b);
+static void emit_stack_cell(surgescript_jit_buffer_t* buf, int offset, int* exit);
+static void emit_copy_number(surgescript_jit_buffer_t* buf, int dst, int src, int* exit);
+static void emit_increment(surgescript_jit_buffer_t* buf, uint8_t sse_opcode, unsigned a, surgescript_jit_helper_t slow, uint64_t op_a, uint64_t op_b);
+static surgescript_jit_t* load(const surgescript_jit_buffer_t* buf);
+#define EMIT(...)                   emit_bytes(buf, (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ }))
+#endif
+
+/* registers */
+enum { RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7 };
+
+/* condition codes (second byte of the near jcc; 0xE9 is jmp) */
+enum { JMP = 0xE9, JAE = 0x83, JE = 0x84, JNE = 0x85, JS = 0x88, JL = 0x8C, JGE = 0x8D, JLE = 0x8E, JG = 0x8F };
+
+/* scalar double operations */
+enum { ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5C, DIVSD = 0x5E };
+
+/* helper macros */
+#define T(k)                        (frame->t[(k) & 3])
+#define OPERAND(x)                  ((surgescript_program_operand_t){ ._u = (x) })
+#define STACK                       surgescript_renv_stack(frame->renv)
+#define HEAP                        surgescript_renv_heap(frame->renv)
+#define OWNER                       surgescript_renv_owner(frame->renv)
+
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_jit_is_available()
+ * Can programs be compiled to machine code on this platform?
+ */
+bool surgescript_jit_is_available()
+{
+    return USE_JIT;
+}
+
+/*
+ * surgescript_jit_compile()
+ * Compiles a frozen program to machine code (jumps must refer to lines of
+ * code). Returns NULL if the program can't be compiled, in which case it
+ * should be run by the interpreter
+ */
+surgescript_jit_t* surgescript_jit_compile(const surgescript_program_t* program)
+{
+#if USE_JIT
+    int length = surgescript_program_line_count(program);
+    surgescript_jit_buffer_t buffer, *buf = &buffer;
+    surgescript_jit_t* jit = NULL;
+    bool success = true;
+
+    /* the compiled code reads the variables directly */
+    if(sizeof(surgescript_var_t) != 16 || offsetof(surgescript_var_t, type) != 8 || sizeof(enum surgescript_vartype_t) != 4)
+        return NULL;
+
+    ssarray_init(buf->byte);
+    ssarray_init(buf->offset);
+    ssarray_init(buf->patch);
+
+    /* prologue: push rbx; push r12; push r13; mov r12, rdi; mov rbx, [rdi]; mov r13, [rdi + stack] */
+    EMIT(0x53, 0x41, 0x54, 0x41, 0x55, 0x49, 0x89, 0xFC, 0x48, 0x8B, 0x1F);
+    EMIT(0x4C, 0x8B, 0x6F, offsetof(surgescript_jit_frame_t, stack));
+
+    /* translate each line of code */
+    for(int ip = 0; ip < length && success; ip++) {
+        ssarray_push(buf->offset, ssarray_length(buf->byte));
+        success = translate(buf, program, ip);
+    }
+
+    /* epilogue: pop r13; pop r12; pop rbx; ret */
+    ssarray_push(buf->offset, ssarray_length(buf->byte));
+    EMIT(0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+
+    /* resolve the jumps and load the code */
+    if(success) {
+        for(int i = 0; i < ssarray_length(buf->patch); i++) {
+            const surgescript_jit_patch_t* patch = &(buf->patch[i]);
+            int target = buf->offset[ssmin(patch->line, (unsigned)length)];
+            int32_t displacement = target - (patch->position + 4);
+            memcpy(buf->byte + patch->position, &displacement, 4);
+        }
+
+        jit = load(buf);
+    }
+
+    ssarray_release(buf->patch);
+    ssarray_release(buf->offset);
+    ssarray_release(buf->byte);
+    return jit;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * surgescript_jit_destroy()
+ * Releases the compiled code
+ */
+surgescript_jit_t* surgescript_jit_destroy(surgescript_jit_t* jit)
+{
+#if USE_JIT
+    munmap(jit->memory, jit->size);
+#endif
+    ssfree(jit);
+    return NULL;
+}
+
+/*
+ * surgescript_jit_run()
+ * Runs the compiled code
+ */
+void surgescript_jit_run(const surgescript_jit_t* jit, surgescript_jit_frame_t* frame)
+{
+    jit->entry(frame);
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+#if USE_JIT
+
+/* translates a line of code; returns false if it can't be translated */
+bool translate(surgescript_jit_buffer_t* buf, const surgescript_program_t* program, int ip)
+{
+    surgescript_program_operator_t op;
+    surgescript_program_operand_t a, b;
+    int slow, done, not_number;
+
+    surgescript_program_get_line(program, ip, &op, &a, &b);
+    switch(op) {
+        case SSOP_NOP:
+            return true;
+
+        case SSOP_RET:
+            emit_jump_to_line(buf, JMP, surgescript_program_line_count(program));
+            return true;
+
+        case SSOP_JMP:
+            emit_jump_to_line(buf, JMP, a.u);
+            return true;
+
+        case SSOP_JE:
+        case SSOP_JNE:
+        case SSOP_JL:
+        case SSOP_JG:
+        case SSOP_JLE:
+        case SSOP_JGE: {
+            static const uint8_t cc[] = { [SSOP_JE] = JE, [SSOP_JNE] = JNE, [SSOP_JL] = JL, [SSOP_JG] = JG, [SSOP_JLE] = JLE, [SSOP_JGE] = JGE };
+
+            /* mov rdx, t[2]; mov rax, [rdx]; test rax, rax */
+            emit_load_temp(buf, RDX, 2);
+            EMIT(0x48, 0x8B, 0x02, 0x48, 0x85, 0xC0);
+            emit_jump_to_line(buf, cc[op], a.u);
+            return true;
+        }
+
+        case SSOP_TJE:
+        case SSOP_TJNE:
+            /* t[2] = rawbits(t[b]), unless t[2] is a string */
+            emit_load_temp(buf, RCX, b.u);
+            emit_load_temp(buf, RDX, 2);
+            EMIT(0x83, 0x7A, 0x08, SSVAR_STRING); /* cmp dword [rdx+8], SSVAR_STRING */
+            slow = emit_forward_jump(buf, JE);
+            EMIT(0x48, 0x8B, 0x01, 0x48, 0x89, 0x02); /* mov rax, [rcx]; mov [rdx], rax */
+            EMIT(0xC7, 0x42, 0x08); emit_u32(buf, SSVAR_RAW); /* mov dword [rdx+8], SSVAR_RAW */
+            done = emit_forward_jump(buf, JMP);
+            resolve_forward_jump(buf, slow);
+            emit_helper_call(buf, op_tset, a._u, b._u);
+            resolve_forward_jump(buf, done);
+
+            /* jump */
+            emit_load_temp(buf, RDX, 2);
+            EMIT(0x48, 0x8B, 0x02, 0x48, 0x85, 0xC0);
+            emit_jump_to_line(buf, op == SSOP_TJE ? JE : JNE, a.u);
+            return true;
+
+        case SSOP_ADD:
+        case SSOP_ADDN:
+            emit_arithmetic(buf, ADDSD, a.u, b.u, op_add, a._u, b._u);
+            return true;
+
+        case SSOP_SUB:
+        case SSOP_SUBN:
+            emit_arithmetic(buf, SUBSD, a.u, b.u, op_sub, a._u, b._u);
+            return true;
+
+        case SSOP_MUL:
+        case SSOP_MULN:
+            emit_arithmetic(buf, MULSD, a.u, b.u, op_mul, a._u, b._u);
+            return true;
+
+        case SSOP_DIV:
+        case SSOP_DIVN:
+            emit_arithmetic(buf, DIVSD, a.u, b.u, op_div, a._u, b._u);
+            return true;
+
+        case SSOP_INC:
+        case SSOP_INCN:
+            if((a.u & 3) == 2) /* t[2] is a counter */
+                emit_helper_call(buf, op_inc, a._u, b._u);
+            else
+                emit_increment(buf, ADDSD, a.u, op_inc, a._u, b._u);
+            return true;
+
+        case SSOP_DEC:
+        case SSOP_DECN:
+            if((a.u & 3) == 2)
+                emit_helper_call(buf, op_dec, a._u, b._u);
+            else
+                emit_increment(buf, SUBSD, a.u, op_dec, a._u, b._u);
+            return true;
+
+        case SSOP_CMP:
+        case SSOP_CMPN: {
+            int not_a, not_b, is_string;
+
+            /* both numbers and t[2] isn't a string */
+            emit_load_temp(buf, RAX, a.u);
+            emit_load_temp(buf, RCX, b.u);
+            emit_load_temp(buf, RDX, 2);
+            EMIT(0x83, 0x78, 0x08, SSVAR_NUMBER); /* cmp dword [rax+8], SSVAR_NUMBER */
+            not_a = emit_forward_jump(buf, JNE);
+            EMIT(0x83, 0x79, 0x08, SSVAR_NUMBER); /* cmp dword [rcx+8], SSVAR_NUMBER */
+            not_b = emit_forward_jump(buf, JNE);
+            EMIT(0x83, 0x7A, 0x08, SSVAR_STRING); /* cmp dword [rdx+8], SSVAR_STRING */
+            is_string = emit_forward_jump(buf, JE);
+
+            /* t[2] = isgreater(x, y) - isless(x, y) */
+            EMIT(0x31, 0xF6, 0x31, 0xFF); /* xor esi, esi; xor edi, edi */
+            EMIT(0xF2, 0x0F, 0x10, 0x00, 0xF2, 0x0F, 0x10, 0x09); /* movsd xmm0, [rax]; movsd xmm1, [rcx] */
+            EMIT(0x66, 0x0F, 0x2E, 0xC1, 0x40, 0x0F, 0x97, 0xC6); /* ucomisd xmm0, xmm1; seta sil */
+            EMIT(0x66, 0x0F, 0x2E, 0xC8, 0x40, 0x0F, 0x97, 0xC7); /* ucomisd xmm1, xmm0; seta dil */
+            EMIT(0x48, 0x29, 0xFE, 0x48, 0x89, 0x32); /* sub rsi, rdi; mov [rdx], rsi */
+            EMIT(0xC7, 0x42, 0x08); emit_u32(buf, SSVAR_RAW); /* mov dword [rdx+8], SSVAR_RAW */
+            done = emit_forward_jump(buf, JMP);
+
+            resolve_forward_jump(buf, not_a);
+            resolve_forward_jump(buf, not_b);
+            resolve_forward_jump(buf, is_string);
+            emit_helper_call(buf, op_cmp, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+        }
+
+        case SSOP_TC01:
+        case SSOP_TC01N:
+            if(is_addition(program, ip)) {
+                surgescript_program_operator_t jmp_op;
+                surgescript_program_operand_t jmp_a, jmp_b;
+                int not_a, not_b;
+
+                /* if t[0] and t[1] are numbers, add them and skip the concatenation */
+                surgescript_program_get_line(program, ip + 3, &jmp_op, &jmp_a, &jmp_b);
+                emit_load_temp(buf, RAX, 0);
+                emit_load_temp(buf, RCX, 1);
+                EMIT(0x83, 0x78, 0x08, SSVAR_NUMBER);
+                not_a = emit_forward_jump(buf, JNE);
+                EMIT(0x83, 0x79, 0x08, SSVAR_NUMBER);
+                not_b = emit_forward_jump(buf, JNE);
+                EMIT(0xF2, 0x0F, 0x10, 0x00, 0xF2, 0x0F, ADDSD, 0x01, 0xF2, 0x0F, 0x11, 0x00); /* movsd xmm0, [rax]; addsd xmm0, [rcx]; movsd [rax], xmm0 */
+                emit_jump_to_line(buf, JMP, jmp_a.u);
+                resolve_forward_jump(buf, not_a);
+                resolve_forward_jump(buf, not_b);
+            }
+            emit_helper_call(buf, op_tc01, a._u, b._u);
+            return true;
+
+        case SSOP_MOVF:
+            /* t[a] = number, unless t[a] is a string */
+            emit_load_temp(buf, RAX, a.u);
+            EMIT(0x83, 0x78, 0x08, SSVAR_STRING);
+            slow = emit_forward_jump(buf, JE);
+            EMIT(0x48, 0xBA); emit_u64(buf, b._u); /* mov rdx, imm64 */
+            EMIT(0x48, 0x89, 0x10); /* mov [rax], rdx */
+            EMIT(0xC7, 0x40, 0x08); emit_u32(buf, SSVAR_NUMBER); /* mov dword [rax+8], SSVAR_NUMBER */
+            done = emit_forward_jump(buf, JMP);
+            resolve_forward_jump(buf, slow);
+            emit_helper_call(buf, op_movf, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+
+        case SSOP_MOV:
+            /* t[a] = t[b], if t[b] is a number and t[a] isn't a string */
+            emit_load_temp(buf, RAX, a.u);
+            emit_load_temp(buf, RCX, b.u);
+            EMIT(0x83, 0x78, 0x08, SSVAR_STRING);
+            slow = emit_forward_jump(buf, JE);
+            EMIT(0x83, 0x79, 0x08, SSVAR_NUMBER);
+            not_number = emit_forward_jump(buf, JNE);
+            EMIT(0x48, 0x8B, 0x11, 0x48, 0x89, 0x10); /* mov rdx, [rcx]; mov [rax], rdx */
+            EMIT(0xC7, 0x40, 0x08); emit_u32(buf, SSVAR_NUMBER);
+            done = emit_forward_jump(buf, JMP);
+            resolve_forward_jump(buf, slow);
+            resolve_forward_jump(buf, not_number);
+            emit_helper_call(buf, op_mov, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+
+        case SSOP_MOVB:
+            /* t[a] = bool, unless t[a] is a string */
+            emit_load_temp(buf, RAX, a.u);
+            EMIT(0x83, 0x78, 0x08, SSVAR_STRING);
+            slow = emit_forward_jump(buf, JE);
+            EMIT(0x48, 0xC7, 0x00); emit_u32(buf, b.b ? 1 : 0); /* mov qword [rax], imm32 */
+            EMIT(0xC7, 0x40, 0x08); emit_u32(buf, SSVAR_BOOL); /* mov dword [rax+8], SSVAR_BOOL */
+            done = emit_forward_jump(buf, JMP);
+            resolve_forward_jump(buf, slow);
+            emit_helper_call(buf, op_movb, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+
+        case SSOP_SPEEK:
+        case SSOP_SPOKE: {
+            int exit[4];
+
+            /* copy a number between t[a] and stack[bp + b] */
+            emit_load_temp(buf, RAX, a.u);
+            emit_stack_cell(buf, b.i, exit);
+            if(op == SSOP_SPEEK)
+                emit_copy_number(buf, RAX, RSI, exit + 2);
+            else
+                emit_copy_number(buf, RSI, RAX, exit + 2);
+            done = emit_forward_jump(buf, JMP);
+
+            for(int i = 0; i < 4; i++)
+                resolve_forward_jump(buf, exit[i]);
+            emit_helper_call(buf, helper[op], a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+        }
+
+        case SSOP_SSWAP: {
+            int exit[2];
+
+            /* swap the 16 bytes of t[a] and stack[bp + b] */
+            emit_load_temp(buf, RAX, a.u);
+            emit_stack_cell(buf, b.i, exit);
+            EMIT(0xF3, 0x0F, 0x6F, 0x00, 0xF3, 0x0F, 0x6F, 0x0E); /* movdqu xmm0, [rax]; movdqu xmm1, [rsi] */
+            EMIT(0xF3, 0x0F, 0x7F, 0x08, 0xF3, 0x0F, 0x7F, 0x06); /* movdqu [rax], xmm1; movdqu [rsi], xmm0 */
+            done = emit_forward_jump(buf, JMP);
+
+            for(int i = 0; i < 2; i++)
+                resolve_forward_jump(buf, exit[i]);
+            emit_helper_call(buf, op_sswap, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+        }
+
+        case SSOP_PUSH: {
+            int not_number, overflow;
+
+            /* push a number; the cells above sp are null */
+            emit_load_temp(buf, RAX, a.u);
+            EMIT(0x83, 0x78, 0x08, SSVAR_NUMBER); /* cmp dword [rax+8], SSVAR_NUMBER */
+            not_number = emit_forward_jump(buf, JNE);
+            EMIT(0x49, 0x63, 0x75, offsetof(surgescript_stack_t, sp)); /* movsxd rsi, [r13 + sp] */
+            EMIT(0x48, 0xFF, 0xC6); /* inc rsi */
+            EMIT(0x49, 0x3B, 0x75, offsetof(surgescript_stack_t, size)); /* cmp rsi, [r13 + size] */
+            overflow = emit_forward_jump(buf, JAE);
+            EMIT(0x41, 0x89, 0x75, offsetof(surgescript_stack_t, sp)); /* mov [r13 + sp], esi */
+            EMIT(0x48, 0xC1, 0xE6, 0x04); /* shl rsi, 4 */
+            EMIT(0x49, 0x03, 0x75, offsetof(surgescript_stack_t, data)); /* add rsi, [r13 + data] */
+            EMIT(0x48, 0x8B, 0x10, 0x48, 0x89, 0x16); /* mov rdx, [rax]; mov [rsi], rdx */
+            EMIT(0xC7, 0x46, 0x08); emit_u32(buf, SSVAR_NUMBER); /* mov dword [rsi+8], SSVAR_NUMBER */
+            done = emit_forward_jump(buf, JMP);
+
+            resolve_forward_jump(buf, not_number);
+            resolve_forward_jump(buf, overflow);
+            emit_helper_call(buf, op_push, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+        }
+
+        case SSOP_POP: {
+            int exit[3];
+
+            /* pop a number, if sp > bp */
+            emit_load_temp(buf, RAX, a.u);
+            EMIT(0x49, 0x63, 0x75, offsetof(surgescript_stack_t, sp)); /* movsxd rsi, [r13 + sp] */
+            EMIT(0x49, 0x63, 0x7D, offsetof(surgescript_stack_t, bp)); /* movsxd rdi, [r13 + bp] */
+            EMIT(0x48, 0x39, 0xFE); /* cmp rsi, rdi */
+            exit[0] = emit_forward_jump(buf, JLE);
+            EMIT(0x48, 0xC1, 0xE6, 0x04); /* shl rsi, 4 */
+            EMIT(0x49, 0x03, 0x75, offsetof(surgescript_stack_t, data)); /* add rsi, [r13 + data] */
+            emit_copy_number(buf, RAX, RSI, exit + 1);
+            EMIT(0x31, 0xD2, 0x48, 0x89, 0x16, 0x48, 0x89, 0x56, 0x08); /* xor edx, edx; mov [rsi], rdx; mov [rsi+8], rdx */
+            EMIT(0x41, 0xFF, 0x4D, offsetof(surgescript_stack_t, sp)); /* dec dword [r13 + sp] */
+            done = emit_forward_jump(buf, JMP);
+
+            for(int i = 0; i < 3; i++)
+                resolve_forward_jump(buf, exit[i]);
+            emit_helper_call(buf, op_pop, a._u, b._u);
+            resolve_forward_jump(buf, done);
+            return true;
+        }
+
+        case SSOP_XCHG:
+            /* swap the 16 bytes of the variables */
+            emit_load_temp(buf, RAX, a.u);
+            emit_load_temp(buf, RCX, b.u);
+            EMIT(0xF3, 0x0F, 0x6F, 0x00, 0xF3, 0x0F, 0x6F, 0x09); /* movdqu xmm0, [rax]; movdqu xmm1, [rcx] */
+            EMIT(0xF3, 0x0F, 0x7F, 0x08, 0xF3, 0x0F, 0x7F, 0x01); /* movdqu [rax], xmm1; movdqu [rcx], xmm0 */
+            return true;
+
+        case SSOP_MOVS:
+            if(b.u >= (unsigned)surgescript_program_text_count(program))
+                return false;
+            emit_helper_call(buf, op_movs, a._u, b._u);
+            return true;
+
+        case SSOP_CALL:
+        case SSOP_CALLP:
+        case SSOP_GET:
+        case SSOP_CAT:
+            if(a.u >= (unsigned)surgescript_program_text_count(program))
+                return false;
+            emit_helper_call(buf, helper[op], a._u, b._u);
+            return true;
+
+        default:
+            if(op < 0 || op >= sizeof(helper) / sizeof(helper[0]) || helper[op] == NULL)
+                return false;
+            emit_helper_call(buf, helper[op], a._u, b._u);
+            return true;
+    }
+}
+
+/* is the given line the start of the code of an addition? (see asm.c) */
+bool is_addition(const surgescript_program_t* program, int ip)
+{
+    surgescript_program_operator_t op[4];
+    surgescript_program_operand_t a[4], b[4];
+
+    for(int i = 0; i < 4; i++) {
+        if(!surgescript_program_get_line(program, ip + i, &op[i], &a[i], &b[i]))
+            return false;
+    }
+
+    return (op[0] == SSOP_TC01 || op[0] == SSOP_TC01N) && a[0].i == surgescript_var_type2code("string")
+        && op[1] == SSOP_JE
+        && (op[2] == SSOP_ADD || op[2] == SSOP_ADDN) && (a[2].u & 3) == 0 && (b[2].u & 3) == 1
+        && op[3] == SSOP_JMP;
+}
+
+/* emits bytes of code */
+void emit_bytes(surgescript_jit_buffer_t* buf, const uint8_t* bytes, int count)
+{
+    for(int i = 0; i < count; i++)
+        ssarray_push(buf->byte, bytes[i]);
+}
+
+/* emits a 32-bit little-endian value */
+void emit_u32(surgescript_jit_buffer_t* buf, uint32_t value)
+{
+    for(int i = 0; i < 4; i++)
+        ssarray_push(buf->byte, (value >> (8 * i)) & 0xFF);
+}
+
+/* emits a 64-bit little-endian value */
+void emit_u64(surgescript_jit_buffer_t* buf, uint64_t value)
+{
+    for(int i = 0; i < 8; i++)
+        ssarray_push(buf->byte, (value >> (8 * i)) & 0xFF);
+}
+
+/* mov reg, [rbx + 8k], i.e., reg = t[k] */
+void emit_load_temp(surgescript_jit_buffer_t* buf, int reg, unsigned k)
+{
+    EMIT(0x48, 0x8B, 0x43 | (reg << 3), 8 * (k & 3));
+}
+
+/* calls fun(frame, a, b) */
+void emit_helper_call(surgescript_jit_buffer_t* buf, surgescript_jit_helper_t fun, uint64_t a, uint64_t b)
+{
+    EMIT(0x4C, 0x89, 0xE7); /* mov rdi, r12 */
+    EMIT(0x48, 0xBE); emit_u64(buf, a); /* mov rsi, imm64 */
+    EMIT(0x48, 0xBA); emit_u64(buf, b); /* mov rdx, imm64 */
+    EMIT(0x48, 0xB8); emit_u64(buf, (uint64_t)(uintptr_t)fun); /* mov rax, imm64 */
+    EMIT(0xFF, 0xD0); /* call rax */
+}
+
+/* emits a jump (or jcc) to a position that is not yet known; returns the position of its displacement */
+int emit_forward_jump(surgescript_jit_buffer_t* buf, uint8_t opcode)
+{
+    if(opcode == JMP)
+        EMIT(JMP);
+    else
+        EMIT(0x0F, opcode);
+
+    emit_u32(buf, 0);
+    return ssarray_length(buf->byte) - 4;
+}
+
+/* emits a jump (or jcc) to a line of code */
+void emit_jump_to_line(surgescript_jit_buffer_t* buf, uint8_t opcode, unsigned line)
+{
+    surgescript_jit_patch_t patch = { emit_forward_jump(buf, opcode), line };
+    ssarray_push(buf->patch, patch);
+}
+
+/* makes a forward jump land on the current position */
+void resolve_forward_jump(surgescript_jit_buffer_t* buf, int position)
+{
+    int32_t displacement = ssarray_length(buf->byte) - (position + 4);
+    memcpy(buf->byte + position, &displacement, 4);
+}
+
+/* t[a] = t[a] <op> t[b], if both are numbers */
+void emit_arithmetic(surgescript_jit_buffer_t* buf, uint8_t sse_opcode, unsigned a, unsigned b, surgescript_jit_helper_t slow, uint64_t op_a, uint64_t op_b)
+{
+    int not_a, not_b, done;
+
+    emit_load_temp(buf, RAX, a);
+    emit_load_temp(buf, RCX, b);
+    EMIT(0x83, 0x78, 0x08, SSVAR_NUMBER); /* cmp dword [rax+8], SSVAR_NUMBER */
+    not_a = emit_forward_jump(buf, JNE);
+    EMIT(0x83, 0x79, 0x08, SSVAR_NUMBER); /* cmp dword [rcx+8], SSVAR_NUMBER */
+    not_b = emit_forward_jump(buf, JNE);
+    EMIT(0xF2, 0x0F, 0x10, 0x00); /* movsd xmm0, [rax] */
+    EMIT(0xF2, 0x0F, sse_opcode, 0x01); /* <op>sd xmm0, [rcx] */
+    EMIT(0xF2, 0x0F, 0x11, 0x00); /* movsd [rax], xmm0 */
+    done = emit_forward_jump(buf, JMP);
+
+    resolve_forward_jump(buf, not_a);
+    resolve_forward_jump(buf, not_b);
+    emit_helper_call(buf, slow, op_a, op_b);
+    resolve_forward_jump(buf, done);
+}
+
+/* rsi = &stack[bp + offset]; jumps to exit[0 .. 1] if out of bounds */
+void emit_stack_cell(surgescript_jit_buffer_t* buf, int offset, int* exit)
+{
+    EMIT(0x49, 0x63, 0x75, offsetof(surgescript_stack_t, bp)); /* movsxd rsi, [r13 + bp] */
+    EMIT(0x48, 0x81, 0xC6); emit_u32(buf, offset); /* add rsi, offset */
+    exit[0] = emit_forward_jump(buf, JS);
+    EMIT(0x49, 0x63, 0x7D, offsetof(surgescript_stack_t, sp)); /* movsxd rdi, [r13 + sp] */
+    EMIT(0x48, 0x39, 0xFE); /* cmp rsi, rdi */
+    exit[1] = emit_forward_jump(buf, JG);
+    EMIT(0x48, 0xC1, 0xE6, 0x04); /* shl rsi, 4 */
+    EMIT(0x49, 0x03, 0x75, offsetof(surgescript_stack_t, data)); /* add rsi, [r13 + data] */
+}
+
+/* *dst = *src, if src is a number and dst isn't a string; jumps to exit[0 .. 1] otherwise */
+void emit_copy_number(surgescript_jit_buffer_t* buf, int dst, int src, int* exit)
+{
+    /* registers: rax (0) and rsi (6) */
+    EMIT(0x83, 0x78 | src, 0x08, SSVAR_NUMBER); /* cmp dword [src+8], SSVAR_NUMBER */
+    exit[0] = emit_forward_jump(buf, JNE);
+    EMIT(0x83, 0x78 | dst, 0x08, SSVAR_STRING); /* cmp dword [dst+8], SSVAR_STRING */
+    exit[1] = emit_forward_jump(buf, JE);
+    EMIT(0x48, 0x8B, 0x10 | src); /* mov rdx, [src] */
+    EMIT(0x48, 0x89, 0x10 | dst); /* mov [dst], rdx */
+    EMIT(0xC7, 0x40 | dst, 0x08); emit_u32(buf, SSVAR_NUMBER); /* mov dword [dst+8], SSVAR_NUMBER */
+}
+
+/* t[a] = t[a] <op> 1, if it's a number */
+void emit_increment(surgescript_jit_buffer_t* buf, uint8_t sse_opcode, unsigned a, surgescript_jit_helper_t slow, uint64_t op_a, uint64_t op_b)
+{
+    const double one = 1.0;
+    uint64_t one_bits;
+    int not_a, done;
+
+    memcpy(&one_bits, &one, sizeof(one_bits));
+    emit_load_temp(buf, RAX, a);
+    EMIT(0x83, 0x78, 0x08, SSVAR_NUMBER);
+    not_a = emit_forward_jump(buf, JNE);
+    EMIT(0xF2, 0x0F, 0x10, 0x00); /* movsd xmm0, [rax] */
+    EMIT(0x48, 0xBA); emit_u64(buf, one_bits); /* mov rdx, 1.0 */
+    EMIT(0x66, 0x48, 0x0F, 0x6E, 0xCA); /* movq xmm1, rdx */
+    EMIT(0xF2, 0x0F, sse_opcode, 0xC1); /* <op>sd xmm0, xmm1 */
+    EMIT(0xF2, 0x0F, 0x11, 0x00); /* movsd [rax], xmm0 */
+    done = emit_forward_jump(buf, JMP);
+
+    resolve_forward_jump(buf, not_a);
+    emit_helper_call(buf, slow, op_a, op_b);
+    resolve_forward_jump(buf, done);
+}
+
+/* copies the code to executable memory */
+surgescript_jit_t* load(const surgescript_jit_buffer_t* buf)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t length = ssarray_length(buf->byte);
+    size_t size = ((length + page_size - 1) / page_size) * page_size;
+    surgescript_jit_t* jit;
+    void* memory;
+
+    /* write the code to writable memory */
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED)
+        return NULL;
+    memcpy(memory, buf->byte, length);
+
+    /* then make it executable, but no longer writable */
+    if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return NULL;
+    }
+
+    jit = ssmalloc(sizeof *jit);
+    jit->memory = memory;
+    jit->size = size;
+    *(void**)(&jit->entry) = memory;
+    return jit;
+}
+
+/* helpers: these do what the interpreter does (see program.c) */
+void op_self(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_objecthandle(T(a), surgescript_object_handle(OWNER));
+}
+
+void op_state(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    if(OPERAND(b).i == -1) {
+        char state[256] = "";
+        surgescript_var_to_string(T(a), state, sizeof(state));
+        surgescript_object_set_state(OWNER, state);
+    }
+    else
+        surgescript_var_set_string(T(a), surgescript_object_state(OWNER));
+}
+
+void op_caller(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_objecthandle(T(a), surgescript_renv_caller(frame->renv));
+}
+
+void op_mov(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(T(a), T(b));
+}
+
+void op_movn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_null(T(a));
+}
+
+void op_movb(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_bool(T(a), OPERAND(b).b);
+}
+
+void op_movf(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), OPERAND(b).f);
+}
+
+void op_movs(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(T(a), &(frame->literal[OPERAND(b).u])); /* shares the string */
+}
+
+void op_movo(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_objecthandle(T(a), OPERAND(b).u);
+}
+
+void op_movx(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(a), OPERAND(b).u);
+}
+
+void op_xchg(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_swap(T(a), T(b));
+}
+
+void op_alloc(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), surgescript_heap_malloc(HEAP));
+}
+
+void op_peek(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(T(a), surgescript_heap_at(HEAP, OPERAND(b).u));
+}
+
+void op_poke(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(surgescript_heap_at(HEAP, OPERAND(b).u), T(a));
+}
+
+void op_push(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_push_copy(STACK, T(a));
+}
+
+void op_pop(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(T(a), surgescript_stack_top(STACK));
+    surgescript_stack_pop(STACK);
+}
+
+void op_speek(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_copy(T(a), surgescript_stack_peek(STACK, OPERAND(b).i));
+}
+
+void op_spoke(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_poke(STACK, OPERAND(b).i, T(a));
+}
+
+void op_sswap(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_swap(STACK, OPERAND(b).i, T(a));
+}
+
+void op_pushn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_pushn(STACK, OPERAND(a).u);
+}
+
+void op_popn(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_popn(STACK, OPERAND(a).u);
+}
+
+void op_inc(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    if(OPERAND(a).u != 2)
+        surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) + 1);
+    else
+        surgescript_var_set_rawbits(T(a), surgescript_var_get_rawbits(T(a)) + 1);
+}
+
+void op_dec(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    if(OPERAND(a).u != 2)
+        surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) - 1);
+    else
+        surgescript_var_set_rawbits(T(a), surgescript_var_get_rawbits(T(a)) - 1);
+}
+
+void op_add(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) + surgescript_var_get_number(T(b)));
+}
+
+void op_sub(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) - surgescript_var_get_number(T(b)));
+}
+
+void op_mul(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) * surgescript_var_get_number(T(b)));
+}
+
+void op_div(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), surgescript_var_get_number(T(a)) / surgescript_var_get_number(T(b)));
+}
+
+void op_mod(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), fmod(surgescript_var_get_number(T(a)), surgescript_var_get_number(T(b))));
+}
+
+void op_neg(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_number(T(a), -surgescript_var_get_number(T(b)));
+}
+
+void op_lnot(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_bool(T(a), !surgescript_var_get_bool(T(b)));
+}
+
+void op_lnot2(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_bool(T(a), surgescript_var_get_bool(T(b)));
+}
+
+void op_not(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(a), ~surgescript_var_get_rawbits(T(b)));
+}
+
+void op_and(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(a), surgescript_var_get_rawbits(T(a)) & surgescript_var_get_rawbits(T(b)));
+}
+
+void op_or(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(a), surgescript_var_get_rawbits(T(a)) | surgescript_var_get_rawbits(T(b)));
+}
+
+void op_xor(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(a), surgescript_var_get_rawbits(T(a)) ^ surgescript_var_get_rawbits(T(b)));
+}
+
+void op_test(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_get_rawbits(T(a)) & surgescript_var_get_rawbits(T(b)));
+}
+
+void op_tchk(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_typecheck(T(a), OPERAND(b).i));
+}
+
+void op_tc01(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_typecheck(T(0), OPERAND(a).i) & surgescript_var_typecheck(T(1), OPERAND(a).i));
+}
+
+void op_tcmp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_typecode(T(a)) ^ surgescript_var_typecode(T(b)));
+}
+
+void op_cmp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_compare(T(a), T(b)));
+}
+
+void op_call(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    frame->call(frame->renv, frame->program, OPERAND(a).u, OPERAND(b).u);
+}
+
+void op_callp(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    frame->call(frame->renv, frame->program, OPERAND(a).u, OPERAND(b).u);
+    surgescript_stack_popn(STACK, OPERAND(b).u + 1);
+}
+
+void op_get(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_stack_push_copy(STACK, T(b));
+    frame->call(frame->renv, frame->program, OPERAND(a).u, 0);
+    surgescript_stack_popn(STACK, 1);
+}
+
+void op_cat(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_objecthandle(T(2), OPERAND(b).u);
+    surgescript_stack_push_copy(STACK, T(2));
+    surgescript_stack_push_copy(STACK, T(1));
+    surgescript_stack_push_copy(STACK, T(0));
+    frame->call(frame->renv, frame->program, OPERAND(a).u, 2);
+    surgescript_stack_popn(STACK, 3);
+}
+
+void op_tset(surgescript_jit_frame_t* frame, uint64_t a, uint64_t b)
+{
+    surgescript_var_set_rawbits(T(2), surgescript_var_get_rawbits(T(b)));
+}
+
+#endif
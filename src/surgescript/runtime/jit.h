@@ -0,0 +1,58 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/jit.h
+ * SurgeScript JIT compiler: translates hot programs to x86-64 machine code
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_JIT_H
+#define _SURGESCRIPT_RUNTIME_JIT_H
+
+#include <stdbool.h>
+
+/* types */
+typedef struct surgescript_jit_t surgescript_jit_t;
+struct surgescript_jit_t;
+
+/* forward declarations */
+struct surgescript_program_t;
+struct surgescript_renv_t;
+struct surgescript_stack_t;
+struct surgescript_var_t;
+
+/* calls the program named text[text_index] of the caller (see SSOP_CALL) */
+typedef void (*surgescript_jit_callfun_t)(struct surgescript_renv_t*, struct surgescript_program_t*, unsigned, int);
+
+/* the state of a program being run by compiled code */
+typedef struct surgescript_jit_frame_t surgescript_jit_frame_t;
+struct surgescript_jit_frame_t
+{
+    struct surgescript_var_t** t; /* temporary variables (registers); must be the first field */
+    struct surgescript_renv_t* renv; /* runtime environment */
+    struct surgescript_stack_t* stack; /* the stack of the runtime environment */
+    struct surgescript_program_t* program; /* the program being run */
+    const struct surgescript_var_t* literal; /* literal[j] is a string variable storing text[j] */
+    surgescript_jit_callfun_t call; /* calls another program */
+};
+
+/* public methods */
+bool surgescript_jit_is_available(); /* can programs be compiled to machine code on this platform? */
+surgescript_jit_t* surgescript_jit_compile(const struct surgescript_program_t* program); /* compiles a frozen program; returns NULL if it can't be compiled */
+surgescript_jit_t* surgescript_jit_destroy(surgescript_jit_t* jit); /* releases the compiled code */
+void surgescript_jit_run(const surgescript_jit_t* jit, surgescript_jit_frame_t* frame); /* runs the compiled code */
+
+#endif
@@ -31,13 +31,15 @@
 #include "vm_time.h"
 #include "../util/transform.h"
 #include "../util/ssarray.h"
+#include "../util/slab.h"
 #include "../util/util.h"
 
 /* object structure */
 struct surgescript_object_t
 {
     /* general properties */
-    char* name; /* my name */
+    const char* name; /* my name (interned) */
+    int class_id; /* id of my name in the program pool (objects with the same name share the same id) */
     surgescript_heap_t* heap; /* each object has its own heap */
     surgescript_renv_t* renv; /* runtime environment */
 
@@ -49,7 +51,7 @@ struct surgescript_object_t
 
     /* inner state */
     surgescript_program_t* current_state; /* current state */
-    char* state_name; /* current state name */
+    const char* state_name; /* current state name (interned) */
     bool is_active; /* can i run programs? */
     bool is_killed; /* am i scheduled to be destroyed? */
     bool is_reachable; /* is this object reachable through some other? (garbage-collection) */
@@ -60,21 +62,119 @@ struct surgescript_object_t
     uint64_t time_spent; /* how much time did this object consume since the last state change */
 
     /* local transform */
-    surgescript_transform_t* transform;
+    surgescript_transform_t* transform; /* NULL if it has never been changed */
 
     /* user-data */
     void* user_data; /* custom user-data */
+
+    /* my heap, my runtime environment and my local transform are
+       allocated together with me, in a single block of the slab */
+    surgescript_heap_t heap_data;
+    surgescript_renv_t renv_data;
+    surgescript_var_t* tmp[SURGESCRIPT_RENV_MAX_TMPVARS];
+    surgescript_var_t tmp_data[SURGESCRIPT_RENV_MAX_TMPVARS];
+    surgescript_transform_t transform_data;
+};
+
+/* the names of the variables of an object, indexed by their addresses in the heap */
+struct surgescript_objectlayout_t
+{
+    SSARRAY(char*, name); /* name[address] may be NULL */
 };
 
 /* functions */
 void surgescript_object_release(surgescript_object_t* object);
 
+/* object manager methods accessible by me */
+extern surgescript_slab_t* surgescript_objectmanager_slab(const surgescript_objectmanager_t* manager); /* the allocator of the objects */
+extern const char* surgescript_objectmanager_intern(surgescript_objectmanager_t* manager, const char* name); /* interns a name of an object or of a state */
+
 /* private stuff */
 #define MAIN_STATE "main"
 static char* state2fun(const char* state);
 static uint64_t run_current_state(const surgescript_object_t* object);
 static surgescript_program_t* get_state_program(const surgescript_object_t* object, const char* state_name);
-static bool object_exists(surgescript_programpool_t* program_pool, const char* object_name);
+static void change_state(surgescript_object_t* object, const char* state_name);
+static void grow_heap(const char* program_name, void* object);
+static void relayout_heap(surgescript_object_t* object, const surgescript_objectlayout_t* old_layout, const surgescript_objectlayout_t* new_layout);
+static int find_variable(const surgescript_objectlayout_t* layout, const char* name);
+static bool same_layout(const surgescript_objectlayout_t* a, const surgescript_objectlayout_t* b);
+static /* moves the variables of an object from their old addresses to the new ones, matching them by name */
+void relayout_heap(surgescript_object_t* object, const surgescript_objectlayout_t* old_layout, const surgescript_objectlayout_t* new_layout)
+{
+    static const char* INIT_FUN = "__ssinitvar"; /* written by the compiler */
+    int old_count = ssarray_length(old_layout->name), new_count = ssarray_length(new_layout->name);
+    surgescript_var_t** value = ssmalloc(ssmax(old_count, 1) * sizeof(*value));
+    surgescript_heap_t* heap = object->heap;
+    SSARRAY(int, added);
+    ssarray_init(added);
+
+    /* take the values out of the heap */
+    for(int i = 0; i < old_count; i++) {
+        value[i] = NULL;
+        if(old_layout->name[i] != NULL && surgescript_heap_validaddress(heap, i)) {
+            value[i] = surgescript_var_clone(surgescript_heap_at(heap, i));
+            surgescript_var_set_null(surgescript_heap_at(heap, i));
+        }
+    }
+
+    /* put them back at their new addresses */
+    for(int i = 0; i < new_count; i++) {
+        if(new_layout->name[i] != NULL && surgescript_heap_validaddress(heap, i)) {
+            int j = find_variable(old_layout, new_layout->name[i]);
+            if(j >= 0 && value[j] != NULL)
+                surgescript_var_copy(surgescript_heap_at(heap, i), value[j]);
+            else
+                ssarray_push(added, i);
+        }
+    }
+
+    for(int i = 0; i < old_count; i++) {
+        if(value[i] != NULL)
+            surgescript_var_destroy(value[i]);
+    }
+    ssfree(value);
+
+    /* initialize the new variables, in the order they were declared */
+    for(int i = 0; i < ssarray_length(added); i++) {
+        surgescript_var_t* name = surgescript_var_set_string(surgescript_var_create(), new_layout->name[added[i]]);
+        const surgescript_var_t* param[] = { name };
+        surgescript_object_call_function(object, INIT_FUN, param, 1, NULL);
+        surgescript_var_destroy(name);
+    }
+
+    ssarray_release(added);
+}
+
+/* the address of the variable with the given name in a layout, or -1 if there is no such variable */
+int find_variable(const surgescript_objectlayout_t* layout, const char* name)
+{
+    for(int i = 0; i < ssarray_length(layout->name); i++) {
+        if(layout->name[i] != NULL && strcmp(layout->name[i], name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/* checks if two layouts are the same */
+bool same_layout(const surgescript_objectlayout_t* a, const surgescript_objectlayout_t* b)
+{
+    if(ssarray_length(a->name) != ssarray_length(b->name))
+        return false;
+
+    for(int i = 0; i < ssarray_length(a->name); i++) {
+        if((a->name[i] == NULL) != (b->name[i] == NULL))
+            return false;
+        else if(a->name[i] != NULL && strcmp(a->name[i], b->name[i]) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool object_exists(surgescript_programpool_t* program_pool, const char* object_name);
+static surgescript_program_t* find_program(const surgescript_object_t* object, const char* fun_name);
 static bool simple_traversal(surgescript_object_t* object, void* data);
 
 /* -------------------------------
@@ -95,22 +195,30 @@ static bool simple_traversal(surgescript_object_t* object, void* data);
  */
 surgescript_object_t* surgescript_object_create(const char* name, unsigned handle, surgescript_objectmanager_t* object_manager, surgescript_programpool_t* program_pool, surgescript_stack_t* stack, const surgescript_vmtime_t* vmtime, void* user_data)
 {
-    surgescript_object_t* obj = ssmalloc(sizeof *obj);
+    surgescript_slab_t* slab = surgescript_objectmanager_slab(object_manager);
+    surgescript_object_t* obj;
 
     if(!object_exists(program_pool, name))
         ssfatal("Runtime Error: can't spawn object \"%s\" - it doesn't exist!", name);
 
-    obj->name = ssstrdup(name);
-    obj->heap = surgescript_heap_create();
-    obj->renv = surgescript_renv_create(obj, stack, obj->heap, program_pool, object_manager, NULL);
+    obj = surgescript_slab_alloc(slab, sizeof *obj);
+    obj->name = surgescript_objectmanager_intern(object_manager, name);
+    obj->class_id = surgescript_programpool_object_id(program_pool, name);
+    obj->heap = surgescript_heap_init(&(obj->heap_data), slab);
+
+    /* the runtime environment has its own temporary variables */
+    memset(obj->tmp_data, 0, sizeof(obj->tmp_data)); /* fill with nulls */
+    for(int i = 0; i < SURGESCRIPT_RENV_MAX_TMPVARS; i++)
+        obj->tmp[i] = &(obj->tmp_data[i]);
+    obj->renv = surgescript_renv_init(&(obj->renv_data), obj, stack, obj->heap, program_pool, object_manager, obj->tmp);
 
     obj->handle = handle; /* handle == parent implies I am a root */
     obj->parent = handle;
-    ssarray_init(obj->child);
+    obj->child = NULL; /* allocated when the first child is added */
+    obj->child_len = obj->child_cap = 0;
     obj->depth = 0;
 
-    obj->state_name = ssstrdup(MAIN_STATE);
-    obj->current_state = get_state_program(obj, obj->state_name);
+    change_state(obj, MAIN_STATE);
     obj->is_active = true;
     obj->is_killed = false;
     obj->is_reachable = false;
@@ -151,16 +259,10 @@ surgescript_object_t* surgescript_object_destroy(surgescript_object_t* obj)
     }
     ssarray_release(obj->child);
 
-    /* clear up the local transform, if any */
-    if(obj->transform != NULL)
-        surgescript_transform_destroy(obj->transform);
-
     /* clear up some data */
-    surgescript_renv_destroy(obj->renv);
-    surgescript_heap_destroy(obj->heap);
-    ssfree(obj->state_name);
-    ssfree(obj->name);
-    ssfree(obj);
+    surgescript_renv_release(obj->renv);
+    surgescript_heap_release(obj->heap);
+    surgescript_slab_free(surgescript_objectmanager_slab(manager), obj, sizeof *obj);
 
     /* done! */
     return NULL;
@@ -183,6 +285,15 @@ const char* surgescript_object_name(const surgescript_object_t* object)
     return object->name;
 }
 
+/*
+ * surgescript_object_class_id()
+ * A number that identifies my class, i.e., it's the same for all objects with my name
+ */
+int surgescript_object_class_id(const surgescript_object_t* object)
+{
+    return object->class_id;
+}
+
 /*
  * surgescript_object_heap()
  * Each object has its own heap. This gets mine.
@@ -500,6 +611,8 @@ void surgescript_object_add_child(surgescript_object_t* object, unsigned child_h
     }
 
     /* add it */
+    if(object->child == NULL)
+        ssarray_init(object->child);
     ssarray_push(object->child, child->handle);
     child->parent = object->handle;
     child->depth = 1 + object->depth;
@@ -561,6 +674,91 @@ void surgescript_object_set_active(surgescript_object_t* object, bool active)
     object->is_active = active;
 }
 
+/*
+ * surgescript_object_layout()
+ * The names of my variables and their addresses in my heap, as laid out by
+ * my current code. Returns NULL if unknown (e.g., I am written in C)
+ */
+surgescript_objectlayout_t* surgescript_object_layout(const surgescript_object_t* object)
+{
+    static const char* LAYOUT_FUN = "__sslayout"; /* written by the compiler */
+    const surgescript_program_t* program = find_program(object, LAYOUT_FUN);
+    surgescript_program_operator_t op, next_op;
+    surgescript_program_operand_t a, b, next_a, next_b;
+    surgescript_objectlayout_t* layout;
+
+    if(program == NULL)
+        return NULL;
+
+    /* each variable is a MOVS of its name followed by a PEEK of its address */
+    layout = ssmalloc(sizeof *layout);
+    ssarray_init(layout->name);
+    for(int i = 0; surgescript_program_get_line(program, i + 1, &next_op, &next_a, &next_b); i++) {
+        if(surgescript_program_get_line(program, i, &op, &a, &b) && op == SSOP_MOVS && next_op == SSOP_PEEK) {
+            const char* name = surgescript_program_get_text(program, b.i);
+            while(ssarray_length(layout->name) <= next_b.u)
+                ssarray_push(layout->name, NULL);
+            if(layout->name[next_b.u] == NULL)
+                layout->name[next_b.u] = ssstrdup(name);
+        }
+    }
+
+    return layout;
+}
+
+/*
+ * surgescript_objectlayout_destroy()
+ * Destroys a layout returned by surgescript_object_layout()
+ */
+surgescript_objectlayout_t* surgescript_objectlayout_destroy(surgescript_objectlayout_t* layout)
+{
+    for(int i = 0; i < ssarray_length(layout->name); i++) {
+        if(layout->name[i] != NULL)
+            ssfree(layout->name[i]);
+    }
+
+    ssarray_release(layout->name);
+    return ssfree(layout);
+}
+
+/*
+ * surgescript_object_reload()
+ * Picks up my code after it has been replaced in the program pool (hot
+ * reload). I keep my state and my variables. Given old_layout, the layout
+ * of my variables before the reload, they're matched by name with the new
+ * code: variables that moved keep their values, removed variables are
+ * discarded and new variables are initialized as declared. If old_layout
+ * is NULL, variables are matched by position and new variables are null.
+ * If my state no longer exists, I go back to the main state
+ */
+void surgescript_object_reload(surgescript_object_t* object, const surgescript_objectlayout_t* old_layout)
+{
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    char* fun_name = state2fun(object->state_name);
+
+    /* find the program of the current state again */
+    if(NULL == (object->current_state = find_program(object, fun_name))) {
+        sslog("Warning: state \"%s\" of object \"%s\" no longer exists.", object->state_name, object->name);
+        change_state(object, MAIN_STATE);
+        object->last_state_change = surgescript_vmtime_time(object->vmtime);
+        object->time_spent = 0;
+    }
+    ssfree(fun_name);
+
+    /* the new code may have new variables */
+    surgescript_programpool_foreach_ex(program_pool, object->name, object, grow_heap);
+
+    /* the variables may have been inserted, removed or reordered */
+    if(old_layout != NULL) {
+        surgescript_objectlayout_t* new_layout = surgescript_object_layout(object);
+        if(new_layout != NULL) {
+            if(!same_layout(old_layout, new_layout))
+                relayout_heap(object, old_layout, new_layout);
+            surgescript_objectlayout_destroy(new_layout);
+        }
+    }
+}
+
 /*
  * surgescript_object_state()
  * each object is a state machine. in which state am i in?
@@ -576,10 +774,11 @@ const char* surgescript_object_state(const surgescript_object_t *object)
  */
 void surgescript_object_set_state(surgescript_object_t* object, const char* state_name)
 {
+    if(state_name == NULL)
+        state_name = MAIN_STATE;
+
     if(strcmp(object->state_name, state_name) != 0) {
-        ssfree(object->state_name);
-        object->state_name = ssstrdup(state_name ? state_name : MAIN_STATE);
-        object->current_state = get_state_program(object, object->state_name);
+        change_state(object, state_name);
         object->last_state_change = surgescript_vmtime_time(object->vmtime);
         object->time_spent = 0;
     }
@@ -651,24 +850,28 @@ void surgescript_object_peek_transform(const surgescript_object_t* object, surge
  */
 void surgescript_object_poke_transform(surgescript_object_t* object, const surgescript_transform_t* transform)
 {
-    if(object->transform == NULL)
-        object->transform = surgescript_transform_create();
+    if(object->transform == NULL) {
+        object->transform = &(object->transform_data);
+        surgescript_transform_reset(object->transform);
+    }
 
     surgescript_transform_copy(object->transform, transform);
 }
 
 /*
  * surgescript_object_transform()
- * Returns the inner pointer to the local transform. If there is no local
- * transform allocated, this function will allocate one.
+ * Returns the inner pointer to the local transform. If the local transform
+ * has never been changed, it will be set to the identity transform.
  * Usage of surgescript_object_peek_transform() is preferred over this, as
- * it saves space. Only use this function if you are going to modify the
- * transform and want to optimize for speed.
+ * the transform is marked as changed. Only use this function if you are
+ * going to modify the transform and want to optimize for speed.
  */
 surgescript_transform_t* surgescript_object_transform(surgescript_object_t* object)
 {
-    if(object->transform == NULL)
-        object->transform = surgescript_transform_create();
+    if(object->transform == NULL) {
+        object->transform = &(object->transform_data);
+        surgescript_transform_reset(object->transform);
+    }
 
     return object->transform;
 }
@@ -695,16 +898,14 @@ void surgescript_object_init(surgescript_object_t* object)
     static const char* CONSTRUCTOR_FUN = "constructor"; /* regular constructor */
     static const char* PRE_CONSTRUCTOR_FUN = "__ssconstructor"; /* a constructor reserved for the VM */
     surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
-    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    surgescript_program_t* pre_constructor = find_program(object, PRE_CONSTRUCTOR_FUN);
+    surgescript_program_t* constructor = find_program(object, CONSTRUCTOR_FUN);
     surgescript_stack_push(stack, surgescript_var_set_objecthandle(surgescript_var_create(), object->handle));
 
-    if(surgescript_programpool_exists(program_pool, object->name, PRE_CONSTRUCTOR_FUN)) {
-        surgescript_program_t* pre_constructor = surgescript_programpool_get(program_pool, object->name, PRE_CONSTRUCTOR_FUN);
+    if(pre_constructor != NULL)
         surgescript_program_call(pre_constructor, object->renv, 0);
-    }
 
-    if(surgescript_programpool_exists(program_pool, object->name, CONSTRUCTOR_FUN)) {
-        surgescript_program_t* constructor = surgescript_programpool_get(program_pool, object->name, CONSTRUCTOR_FUN);
+    if(constructor != NULL) {
         if(surgescript_program_arity(constructor) != 0)
             ssfatal("Runtime Error: Object \"%s\"'s %s() cannot receive parameters", object->name, CONSTRUCTOR_FUN);
         surgescript_program_call(constructor, object->renv, 0);
@@ -720,12 +921,11 @@ void surgescript_object_init(surgescript_object_t* object)
 void surgescript_object_release(surgescript_object_t* object)
 {
     static const char* DESTRUCTOR_FUN = "destructor";
-    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    surgescript_program_t* destructor = find_program(object, DESTRUCTOR_FUN);
 
-    if(surgescript_programpool_exists(program_pool, object->name, DESTRUCTOR_FUN)) {
+    if(destructor != NULL) {
         surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
-        surgescript_program_t* destructor = surgescript_programpool_get(program_pool, object->name, DESTRUCTOR_FUN);
-        
+
         if(surgescript_program_arity(destructor) != 0)
             ssfatal("Runtime Error: Object \"%s\"'s %s() cannot receive parameters", object->name, DESTRUCTOR_FUN);
 
@@ -796,7 +996,7 @@ bool surgescript_object_traverse_tree_ex(surgescript_object_t* object, void* dat
  */
 void surgescript_object_call_function(surgescript_object_t* object, const char* fun_name, const surgescript_var_t* param[], int num_params, surgescript_var_t* return_value)
 {
-    surgescript_program_t* program = surgescript_programpool_get(surgescript_renv_programpool(object->renv), object->name, fun_name);
+    surgescript_program_t* program = find_program(object, fun_name);
     surgescript_stack_t* stack = surgescript_renv_stack(object->renv);
     int i;
 
@@ -807,7 +1007,7 @@ void surgescript_object_call_function(surgescript_object_t* object, const char*
     /* parameters are stacked left-to-right */
     surgescript_stack_push(stack, surgescript_var_set_objecthandle(surgescript_var_create(), object->handle));
     for(i = 0; i < num_params; i++)
-        surgescript_stack_push(stack, surgescript_var_clone(param[i]));
+        surgescript_stack_push_copy(stack, param[i]);
 
     /* call the program */
     if(program != NULL) {
@@ -877,8 +1077,7 @@ uint64_t run_current_state(const surgescript_object_t* object)
 surgescript_program_t* get_state_program(const surgescript_object_t* object, const char* state_name)
 {
     char* fun_name = state2fun(state_name);
-    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
-    surgescript_program_t* program = surgescript_programpool_get(program_pool, object->name, fun_name);
+    surgescript_program_t* program = find_program(object, fun_name);
 
     if(program == NULL)
         ssfatal("Runtime Error: state \"%s\" of object \"%s\" doesn't exist.", state_name, object->name);
@@ -887,11 +1086,36 @@ surgescript_program_t* get_state_program(const surgescript_object_t* object, con
     return program;
 }
 
+/* the state is looked up before its name is interned, so that only the names of existing states are kept */
+void change_state(surgescript_object_t* object, const char* state_name)
+{
+    object->current_state = get_state_program(object, state_name); /* fails if the state doesn't exist */
+    object->state_name = surgescript_objectmanager_intern(surgescript_renv_objectmanager(object->renv), state_name);
+}
+
+void grow_heap(const char* program_name, void* obj)
+{
+    surgescript_object_t* object = (surgescript_object_t*)obj;
+    surgescript_program_t* program = find_program(object, program_name);
+    int size = surgescript_program_heap_size(program);
+
+    /* the cells of the variables are allocated in order by the constructor */
+    while(size > 0 && !surgescript_heap_validaddress(object->heap, size - 1))
+        surgescript_heap_malloc(object->heap);
+}
+
 bool object_exists(surgescript_programpool_t* program_pool, const char* object_name)
 {
     return NULL != surgescript_programpool_get(program_pool, object_name, "state:" MAIN_STATE);
 }
 
+surgescript_program_t* find_program(const surgescript_object_t* object, const char* fun_name)
+{
+    surgescript_programpool_t* program_pool = surgescript_renv_programpool(object->renv);
+    int fun_id = surgescript_programpool_program_id(program_pool, fun_name);
+    return surgescript_programpool_get_by_id(program_pool, object->class_id, fun_id);
+}
+
 bool simple_traversal(surgescript_object_t* object, void* callback)
 {
     return ((bool (*)(surgescript_object_t*))callback)(object);
@@ -27,6 +27,7 @@
 
 /* types */
 typedef struct surgescript_object_t surgescript_object_t;
+typedef struct surgescript_objectlayout_t surgescript_objectlayout_t;
 
 /* forward declarations */
 struct surgescript_programpool_t;
@@ -45,8 +46,14 @@ struct surgescript_transform_t;
 /* programs */
 bool surgescript_object_update(surgescript_object_t* object); /* runs my programs */
 
+/* hot reload */
+surgescript_objectlayout_t* surgescript_object_layout(const surgescript_object_t* object); /* the names of my variables, as laid out in my heap by my current code; may be NULL */
+surgescript_objectlayout_t* surgescript_objectlayout_destroy(surgescript_objectlayout_t* layout); /* destroys a layout */
+void surgescript_object_reload(surgescript_object_t* object, const surgescript_objectlayout_t* old_layout); /* picks up my code after it has been replaced in the program pool; old_layout is my layout before that, and may be NULL */
+
 /* properties */
 const char* surgescript_object_name(const surgescript_object_t* object); /* what's my name? */
+int surgescript_object_class_id(const surgescript_object_t* object); /* a number that identifies my class */
 struct surgescript_heap_t* surgescript_object_heap(const surgescript_object_t* object); /* each object has its own heap */
 struct surgescript_objectmanager_t* surgescript_object_manager(const surgescript_object_t* object); /* pointer to the object manager */
 void* surgescript_object_userdata(const surgescript_object_t* object); /* custom user data (if any) */
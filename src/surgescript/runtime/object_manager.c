@@ -29,17 +29,28 @@
 #include "heap.h"
 #include "variable.h"
 #include "../util/ssarray.h"
+#include "../util/slab.h"
+#include "../util/uthash.h"
 #include "../util/util.h"
 
 /* types */
 typedef struct surgescript_vmargs_t surgescript_vmargs_t;
 
+typedef struct surgescript_objectmanager_name_t surgescript_objectmanager_name_t;
+struct surgescript_objectmanager_name_t /* an interned name */
+{
+    char* name; /* key */
+    UT_hash_handle hh;
+};
+
 /* object manager */
 struct surgescript_objectmanager_t
 {
     int count; /* how many objects are allocated at the moment */
-    surgescript_objecthandle_t handle_ptr; /* memory allocation */
     SSARRAY(surgescript_object_t*, data); /* object table */
+    SSARRAY(uint8_t, generation); /* generation[i] is the generation of the handles of slot i */
+    SSARRAY(unsigned, next_free); /* the free slots form a queue: next_free[i] comes after i */
+    unsigned first_free, last_free; /* the queue of free slots (zero if empty) */
     surgescript_programpool_t* program_pool; /* reference to the program pool */
     surgescript_stack_t* stack; /* reference to the stack */
     surgescript_tagsystem_t* tag_system; /* tag system */
@@ -50,12 +61,24 @@ struct surgescript_objectmanager_t
     int reachables_count; /* garbage-collector stuff */
     int garbage_count; /* last number of garbage-collected objects */
     SSARRAY(char*, plugin_list); /* plugin list */
+    surgescript_slab_t* slab; /* the objects are allocated from here */
+    surgescript_objectmanager_name_t* names; /* interned names of objects and states */
+    surgescript_prng_t prng; /* pseudo-random number generator of the VM */
 };
 
 /* fixed objects */
 #define NULL_HANDLE                 0   /* must always be zero */
 #define ROOT_HANDLE                 1
 
+/* a handle is a 24-bit index of the object table and an 8-bit generation.
+   The generation of a slot changes whenever its object is deleted, so that
+   stale handles are detected without having to repair any references */
+#define HANDLE_INDEX_BITS           24
+#define HANDLE_INDEX(handle)        ((handle) & ((1u << HANDLE_INDEX_BITS) - 1))
+#define HANDLE_GENERATION(handle)   ((handle) >> HANDLE_INDEX_BITS)
+#define MAKE_HANDLE(index, gen)     ((surgescript_objecthandle_t)(index) | ((surgescript_objecthandle_t)(gen) << HANDLE_INDEX_BITS))
+#define MAX_OBJECTS                 ((1u << HANDLE_INDEX_BITS) - 1)
+
 /* system objects are children of the root and
    their addresses must be known at compile-time */
 #define SURGESCRIPT_SYSTEM_OBJECTS(F) \
@@ -98,8 +121,10 @@ static bool mark_as_reachable(unsigned handle, void* mgr);
 static bool sweep_unreachables(surgescript_object_t* object);
 
 /* other */
-#define is_power_of_two(x)                !((x) & ((x) - 1)) /* this assumes x > 0 */
 static surgescript_objecthandle_t new_handle(surgescript_objectmanager_t* mgr);
+static void release_handle(surgescript_objectmanager_t* mgr, surgescript_objecthandle_t handle);
+static inline surgescript_object_t* find_object(const surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle);
+static void clear_names(surgescript_objectmanager_t* manager);
 static void add_to_plugin_list(surgescript_objectmanager_t* manager, const char* object_name);
 static void release_plugin_list(surgescript_objectmanager_t* manager);
 static char** compile_plugins_list(const surgescript_objectmanager_t* manager);
@@ -119,6 +144,11 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
 
     ssarray_init(manager->data);
     ssarray_push(manager->data, NULL); /* NULL is *always* the first element */
+    ssarray_init(manager->generation);
+    ssarray_push(manager->generation, 0);
+    ssarray_init(manager->next_free);
+    ssarray_push(manager->next_free, 0);
+    manager->first_free = manager->last_free = 0;
 
     manager->count = 0;
     manager->program_pool = program_pool;
@@ -126,7 +156,6 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
     manager->stack = stack;
     manager->args = args;
     manager->vmtime = vmtime;
-    manager->handle_ptr = ROOT_HANDLE;
 
     ssarray_init(manager->objects_to_be_scanned);
     manager->first_object_to_be_scanned = 0;
@@ -135,6 +164,11 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
 
     ssarray_init(manager->plugin_list);
 
+    manager->slab = surgescript_slab_create();
+    manager->names = NULL;
+
+    manager->prng.state[0] = manager->prng.state[1] = 0; /* seeded when the VM is launched */
+
     return manager;
 }
 
@@ -144,14 +178,18 @@ surgescript_objectmanager_t* surgescript_objectmanager_create(surgescript_progra
  */
 surgescript_objectmanager_t* surgescript_objectmanager_destroy(surgescript_objectmanager_t* manager)
 {
-    surgescript_objecthandle_t handle = ssarray_length(manager->data);
-    
-    while(handle != 0)
-        surgescript_objectmanager_delete(manager, --handle);
+    unsigned index = ssarray_length(manager->data);
 
+    while(index-- > 0)
+        surgescript_objectmanager_delete(manager, MAKE_HANDLE(index, manager->generation[index]));
+
+    ssarray_release(manager->next_free);
+    ssarray_release(manager->generation);
     ssarray_release(manager->data);
     ssarray_release(manager->objects_to_be_scanned);
     release_plugin_list(manager);
+    clear_names(manager);
+    surgescript_slab_destroy(manager->slab);
 
     return ssfree(manager);
 }
@@ -164,19 +202,20 @@ surgescript_objectmanager_t* surgescript_objectmanager_destroy(surgescript_objec
 surgescript_objecthandle_t surgescript_objectmanager_spawn(surgescript_objectmanager_t* manager, surgescript_objecthandle_t parent, const char* object_name, void* user_data)
 {
     surgescript_objecthandle_t handle = new_handle(manager);
+    unsigned index = HANDLE_INDEX(handle);
     surgescript_object_t *parent_object = surgescript_objectmanager_get(manager, parent);
     surgescript_object_t *object = surgescript_object_create(object_name, handle, manager, manager->program_pool, manager->stack, manager->vmtime, user_data);
 
     /* store the object */
-    if(handle >= ssarray_length(manager->data) && handle > ROOT_HANDLE) {
+    if(index >= ssarray_length(manager->data) && index > ROOT_HANDLE) {
         /* new slot */
         ssarray_push(manager->data, object);
-        if(is_power_of_two(handle))
-            manager->handle_ptr = ssmax(2, manager->handle_ptr / 2); /* handle_ptr must never be zero */
+        ssarray_push(manager->generation, 0);
+        ssarray_push(manager->next_free, 0);
     }
-    else if(handle > ROOT_HANDLE) {
+    else if(index > ROOT_HANDLE) {
         /* reuse unused slot */
-        manager->data[handle] = object;
+        manager->data[index] = object;
     }
     else
         ssfatal("Can't spawn the root object.");
@@ -201,7 +240,7 @@ surgescript_objecthandle_t surgescript_objectmanager_spawn(surgescript_objectman
  */
 surgescript_objecthandle_t surgescript_objectmanager_spawn_root(surgescript_objectmanager_t* manager)
 {
-    if(manager->handle_ptr == ROOT_HANDLE) {
+    if(ssarray_length(manager->data) == ROOT_HANDLE) {
         /* preparing the data */
         char** plugins = compile_plugins_list(manager);
         char** data[] = { (char**)SYSTEM_OBJECTS, plugins };
@@ -209,6 +248,8 @@ surgescript_objecthandle_t surgescript_objectmanager_spawn_root(surgescript_obje
         /* spawn the root object */
         surgescript_object_t *object = surgescript_object_create(ROOT_OBJECT, ROOT_HANDLE, manager, manager->program_pool, manager->stack, manager->vmtime, data);
         ssarray_push(manager->data, object);
+        ssarray_push(manager->generation, 0);
+        ssarray_push(manager->next_free, 0);
         manager->count++;
 
         /* initialize the root and call its constructor */
@@ -229,7 +270,7 @@ surgescript_objecthandle_t surgescript_objectmanager_spawn_root(surgescript_obje
  */
 bool surgescript_objectmanager_exists(const surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle)
 {
-    return handle < ssarray_length(manager->data) && manager->data[handle] != NULL;
+    return find_object(manager, handle) != NULL;
 }
 
 /*
@@ -238,10 +279,10 @@ bool surgescript_objectmanager_exists(const surgescript_objectmanager_t* manager
  */
 surgescript_object_t* surgescript_objectmanager_get(const surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle)
 {
-    if(handle < ssarray_length(manager->data)) { /* handle is unsigned; therefore, not lower than zero */
-        if(manager->data[handle] != NULL)
-            return manager->data[handle];
-    }
+    surgescript_object_t* object = find_object(manager, handle);
+
+    if(object != NULL)
+        return object;
 
     ssfatal("Runtime Error: null pointer exception (can't find object 0x%X)", handle);
     return NULL;
@@ -253,12 +294,13 @@ surgescript_object_t* surgescript_objectmanager_get(const surgescript_objectmana
  */
 bool surgescript_objectmanager_delete(surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle)
 {
-    if(handle < ssarray_length(manager->data)) {
-        if(manager->data[handle] != NULL) {
-            manager->data[handle] = surgescript_object_destroy(manager->data[handle]);
-            manager->count--;
-            return true;
-        }
+    surgescript_object_t* object = find_object(manager, handle);
+
+    if(object != NULL) {
+        manager->data[HANDLE_INDEX(handle)] = surgescript_object_destroy(object);
+        manager->count--;
+        release_handle(manager, handle);
+        return true;
     }
 
     return false;
@@ -397,6 +439,15 @@ surgescript_vmargs_t* surgescript_objectmanager_vmargs(const surgescript_objectm
     return manager->args;
 }
 
+/*
+ * surgescript_objectmanager_prng()
+ * The pseudo-random number generator of the VM
+ */
+surgescript_prng_t* surgescript_objectmanager_prng(surgescript_objectmanager_t* manager)
+{
+    return &(manager->prng);
+}
+
 /*
  * surgescript_objectmanager_garbagecollect()
  * Runs the garbage collector (incremental mark-and-sweep algorithm)
@@ -440,9 +491,9 @@ void surgescript_objectmanager_garbagecheck(surgescript_objectmanager_t* manager
     /* for each object o to be scanned, check the ones that are reachable from o */
     int old_length = ssarray_length(manager->objects_to_be_scanned);
     for(int i = manager->first_object_to_be_scanned; i < old_length; i++) {
-        surgescript_objecthandle_t handle = manager->objects_to_be_scanned[i];
-        if(manager->data[handle] != NULL) {
-            surgescript_heap_t* heap = surgescript_object_heap(manager->data[handle]);
+        surgescript_object_t* object = find_object(manager, manager->objects_to_be_scanned[i]);
+        if(object != NULL) {
+            surgescript_heap_t* heap = surgescript_object_heap(object);
             surgescript_heap_scan_objects(heap, manager, mark_as_reachable);
         }
     }
@@ -498,6 +549,36 @@ void surgescript_objectmanager_install_plugin(surgescript_objectmanager_t* manag
     add_to_plugin_list(manager, object_name);
 }
 
+/*
+ * surgescript_objectmanager_slab()
+ * The allocator of the objects (used by the objects)
+ */
+surgescript_slab_t* surgescript_objectmanager_slab(const surgescript_objectmanager_t* manager)
+{
+    return manager->slab;
+}
+
+/*
+ * surgescript_objectmanager_intern()
+ * Interns the name of an object or of an existing state (used by the
+ * objects). The returned string is valid for as long as the object manager
+ * exists
+ */
+const char* surgescript_objectmanager_intern(surgescript_objectmanager_t* manager, const char* name)
+{
+    surgescript_objectmanager_name_t* entry = NULL;
+    HASH_FIND_STR(manager->names, name, entry);
+
+    /* create the hash entry if it doesn't exist yet */
+    if(entry == NULL) {
+        entry = ssmalloc(sizeof *entry);
+        entry->name = ssstrdup(name);
+        HASH_ADD_KEYPTR(hh, manager->names, entry->name, strlen(entry->name), entry);
+    }
+
+    return entry->name;
+}
+
 
 
 
@@ -538,12 +619,66 @@ bool sweep_unreachables(surgescript_object_t* object)
     return true;
 }
 
-/* gets a handle at a unused space */
+/* gets a handle at a unused space: the oldest free slot or a new slot */
 surgescript_objecthandle_t new_handle(surgescript_objectmanager_t* mgr)
 {
-    while(mgr->handle_ptr < ssarray_length(mgr->data) && mgr->data[mgr->handle_ptr] != NULL)
-        mgr->handle_ptr++;
-    return mgr->handle_ptr;
+    unsigned index = mgr->first_free;
+
+    /* no free slots? */
+    if(index == 0) {
+        index = ssarray_length(mgr->data);
+        if(index > MAX_OBJECTS)
+            ssfatal("Runtime Error: can't spawn more than %u objects", MAX_OBJECTS);
+        return MAKE_HANDLE(index, 0);
+    }
+
+    /* take the first slot of the queue */
+    mgr->first_free = mgr->next_free[index];
+    if(mgr->first_free == 0)
+        mgr->last_free = 0;
+
+    return MAKE_HANDLE(index, mgr->generation[index]);
+}
+
+/* puts the slot of a deleted object at the end of the queue of free slots */
+void release_handle(surgescript_objectmanager_t* mgr, surgescript_objecthandle_t handle)
+{
+    unsigned index = HANDLE_INDEX(handle);
+
+    /* invalidate the handles of the slot */
+    mgr->generation[index]++;
+
+    /* enqueue the slot */
+    mgr->next_free[index] = 0;
+    if(mgr->last_free != 0)
+        mgr->next_free[mgr->last_free] = index;
+    else
+        mgr->first_free = index;
+
+    mgr->last_free = index;
+}
+
+/* deletes all interned names */
+void clear_names(surgescript_objectmanager_t* manager)
+{
+    surgescript_objectmanager_name_t *it, *tmp;
+
+    HASH_ITER(hh, manager->names, it, tmp) {
+        HASH_DEL(manager->names, it);
+        ssfree(it->name);
+        ssfree(it);
+    }
+}
+
+/* finds the object pointed by a handle, validating its generation; returns NULL if there is no such object */
+surgescript_object_t* find_object(const surgescript_objectmanager_t* manager, surgescript_objecthandle_t handle)
+{
+    unsigned index = HANDLE_INDEX(handle);
+
+    if(index < ssarray_length(manager->data) && manager->generation[index] == HANDLE_GENERATION(handle))
+        return manager->data[index]; /* NULL if the slot is free */
+
+    return NULL;
 }
 
 /* adds an object to the plugin list */
@@ -588,7 +723,7 @@ char** compile_plugins_list(const surgescript_objectmanager_t* manager) {
 /* returns the plugin object -- fast */
 surgescript_object_t* plugin_object(const surgescript_objectmanager_t* manager)
 {
-    static surgescript_objecthandle_t handle = NULL_HANDLE;
+    static SS_THREADLOCAL surgescript_objecthandle_t handle = NULL_HANDLE;
 
     if(handle == NULL_HANDLE) /* cache the handle */
         handle = surgescript_objectmanager_system_object(NULL, "Plugin");
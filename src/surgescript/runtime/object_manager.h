@@ -35,6 +35,7 @@ struct surgescript_stack_t;
 struct surgescript_tagsystem_t;
 struct surgescript_vmargs_t;
 struct surgescript_vmtime_t;
+struct surgescript_prng_t;
 
 
 /* public methods */
@@ -56,6 +57,7 @@ void surgescript_objectmanager_install_plugin(surgescript_objectmanager_t* manag
 struct surgescript_programpool_t* surgescript_objectmanager_programpool(const surgescript_objectmanager_t* manager); /* pointer to the program pool */
 struct surgescript_tagsystem_t* surgescript_objectmanager_tagsystem(const surgescript_objectmanager_t* manager); /* pointer to the tag manager */
 struct surgescript_vmargs_t* surgescript_objectmanager_vmargs(const surgescript_objectmanager_t* manager); /* VM command-line arguments */
+struct surgescript_prng_t* surgescript_objectmanager_prng(surgescript_objectmanager_t* manager); /* pseudo-random number generator of the VM */
 
 /* garbage collector */
 void surgescript_objectmanager_garbagecheck(surgescript_objectmanager_t* manager); /* checks for garbage (incrementally) */
@@ -32,8 +32,10 @@
 #include "renv.h"
 #include "object_manager.h"
 #include "program_pool.h"
+#include "jit.h"
 #include "../util/util.h"
 #include "../util/ssarray.h"
+#include "../util/uthash.h"
 
 /* require alloca */
 #if !(defined(__APPLE__) || defined(MACOSX) || defined(macintosh) || defined(Macintosh))
@@ -51,6 +53,29 @@ struct surgescript_program_operation_t
     surgescript_program_operand_t a, b;
 };
 
+/* an inline cache of the programs called by a call site, keyed by the class of the callee */
+#define CALLSITE_WAYS 4
+typedef struct surgescript_program_callsite_t surgescript_program_callsite_t;
+struct surgescript_program_callsite_t
+{
+    int program_id; /* id of the name of the called program in the program pool, or -1 if unknown */
+    unsigned generation; /* generation of the program pool when the entries were cached */
+    unsigned count; /* number of cached entries since the last invalidation */
+    struct {
+        int class_id; /* class of the callee */
+        surgescript_program_t* program; /* program to be called */
+    } entry[CALLSITE_WAYS];
+};
+
+/* an entry of the hash index of the texts, kept while the program is being written */
+typedef struct surgescript_program_textindex_t surgescript_program_textindex_t;
+struct surgescript_program_textindex_t
+{
+    const char* text; /* key: text[index] */
+    int index; /* value */
+    UT_hash_handle hh;
+};
+
 /* the program structure */
 struct surgescript_program_t
 {
@@ -59,6 +84,13 @@ struct surgescript_program_t
     SSARRAY(surgescript_program_operation_t, line); /* a set of operations (or lines of code) */
     SSARRAY(surgescript_program_label_t, label); /* labels (label[j] is the index of a line of code, j is a label) */
     SSARRAY(char*, text); /* read-only text data */
+    surgescript_program_textindex_t* text_index; /* finds texts quickly (frozen programs don't have it) */
+    surgescript_program_callsite_t* callsite; /* callsite[j] caches the programs named text[j] (lazily allocated) */
+    surgescript_var_t* literal; /* literal[j] is a string variable storing text[j] (lazily allocated) */
+    bool shareable; /* is this program read-only, so that it may be run by VMs on multiple threads? */
+    bool frozen; /* has the code been finalized? (frozen programs keep line[] and the texts in a single block) */
+    surgescript_jit_t* jit; /* machine code of the program, if it's hot (NULL if it's not compiled) */
+    int call_count; /* how many times the program has been run, up to JIT_THRESHOLD */
 };
 
 /* a program that encapsulates a C-function */
@@ -79,16 +111,42 @@ static const char* instruction_name[] = {
 static surgescript_program_t* init_program(surgescript_program_t* program, int arity, void (*run_function)(surgescript_program_t*, surgescript_renv_t*));
 static void run_program(surgescript_program_t* program, surgescript_renv_t* runtime_environment);
 static void run_cprogram(surgescript_program_t* program, surgescript_renv_t* runtime_environment);
-static inline void run_instruction(surgescript_program_t* program, surgescript_renv_t* runtime_environment, surgescript_program_operator_t instruction, surgescript_program_operand_t a, surgescript_program_operand_t b, int* ip);
-static inline void call_program(surgescript_renv_t* caller_runtime_environment, const char* program_name, int number_of_given_params);
+static inline void call_program(surgescript_renv_t* caller_runtime_environment, surgescript_program_t* caller, unsigned text_index, int number_of_given_params);
+static inline surgescript_program_t* find_program(surgescript_program_t* caller, unsigned text_index, surgescript_programpool_t* pool, const surgescript_object_t* object);
+static surgescript_program_callsite_t* create_callsites(const surgescript_program_t* program);
+static surgescript_var_t* create_literals(const surgescript_program_t* program);
+static surgescript_var_t* destroy_literals(const surgescript_program_t* program, surgescript_var_t* literal);
 static inline bool is_jump_instruction(surgescript_program_operator_t instruction);
+static inline bool is_call_instruction(surgescript_program_operator_t instruction);
+static bool is_addition(const surgescript_program_t* program, unsigned index);
+static surgescript_program_operator_t generic_instruction(surgescript_program_operator_t instruction);
 static inline bool remove_labels(surgescript_program_t* program);
+static bool thread_jumps(surgescript_program_t* program);
+static bool fuse_lines(surgescript_program_t* program);
+static int match_lines(const surgescript_program_operation_t* line, const bool* is_target, int length, int index, surgescript_program_operation_t* replacement);
 static char* hexdump(unsigned data, char* buf); /* writes the bytes stored in data to buf, in hex format */
 static void fputs_escaped(const char* str, FILE* fp); /* works like fputs, but escapes the string */
+static inline void write_u32(FILE* fp, uint32_t value);
+static inline void write_u64(FILE* fp, uint64_t value);
+static inline bool read_u32(const char** data, const char* end, uint32_t* value);
+static inline bool read_u64(const char** data, const char* end, uint64_t* value);
 static inline int fast_sign(double f);
 static inline int fast_sign1(double f);
 static inline int fast_notzero(double f);
+static inline void discard_machine_code(surgescript_program_t* program);
+static inline void check_writable(const surgescript_program_t* program, const char* fun);
+static int push_text(surgescript_program_t* program, char* text);
+static void clear_text_index(surgescript_program_t* program);
+static bool is_valid_code(const surgescript_program_operation_t* line, unsigned line_count, unsigned text_count, unsigned arity);
 static const int MAX_PROGRAM_ARITY = 256;
+static const unsigned OPERATOR_COUNT = sizeof(instruction_name) / sizeof(instruction_name[0]);
+static const int JIT_THRESHOLD = 64; /* a program is compiled to machine code after being run this many times */
+static const size_t JIT_MAX_DEPTH = 1024; /* deeper calls are interpreted, as compiled code takes more native stack per call */
+
+/* use threaded code (computed goto) if the compiler supports it */
+#if defined(__GNUC__) && !defined(SURGESCRIPT_DISABLE_THREADED_DISPATCH)
+#define SURGESCRIPT_THREADED_DISPATCH
+#endif
 
 /* debug mode? */
 /*#define SURGESCRIPT_DEBUG_MODE*/
@@ -128,12 +186,27 @@ surgescript_program_t* surgescript_program_create_native(int arity, surgescript_
  */
 surgescript_program_t* surgescript_program_destroy(surgescript_program_t* program)
 {
-    for(int j = 0; j < ssarray_length(program->text); j++)
-        ssfree(program->text[j]);
+    if(program->literal != NULL)
+        destroy_literals(program, program->literal);
+
+    clear_text_index(program);
+    if(!program->frozen) {
+        for(int j = 0; j < ssarray_length(program->text); j++)
+            ssfree(program->text[j]);
+    }
+    else {
+        /* the code, the texts and their characters are a single block */
+        ssfree(program->line);
+        program->line = NULL;
+        program->text = NULL;
+    }
 
     ssarray_release(program->text);
     ssarray_release(program->label);
     ssarray_release(program->line);
+    if(program->callsite != NULL)
+        ssfree(program->callsite);
+    discard_machine_code(program);
     ssfree(program);
 
     return NULL;
@@ -146,7 +219,9 @@ surgescript_program_t* surgescript_program_destroy(surgescript_program_t* progra
 int surgescript_program_add_line(surgescript_program_t* program, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
 {
     surgescript_program_operation_t line = { op, a, b };
+    check_writable(program, "surgescript_program_add_line");
     ssarray_push(program->line, line);
+    discard_machine_code(program);
     return ssarray_length(program->line) - 1;
 }
 
@@ -157,20 +232,111 @@ int surgescript_program_add_line(surgescript_program_t* program, surgescript_pro
 int surgescript_program_chg_line(surgescript_program_t* program, int line, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b)
 {
     surgescript_program_operation_t newline = { op, a, b };
+    check_writable(program, "surgescript_program_chg_line");
     if(line >= 0 && line < ssarray_length(program->line)) {
         program->line[line] = newline;
+        discard_machine_code(program);
         return line;
     }
     else
         return -1;
 }
 
+/*
+ * surgescript_program_optimize()
+ * Peephole optimization: removes no-operations and redundant moves, threads
+ * jumps and fuses common sequences of instructions into superinstructions.
+ * Call it after the whole program has been written (jumps will no longer
+ * refer to labels)
+ */
+void surgescript_program_optimize(surgescript_program_t* program)
+{
+    bool changed;
+
+    check_writable(program, "surgescript_program_optimize");
+    remove_labels(program);
+
+    do {
+        changed = thread_jumps(program);
+        changed = fuse_lines(program) || changed;
+    } while(changed);
+}
+
+/*
+ * surgescript_program_line_count()
+ * How many lines of code are there in the program?
+ */
+int surgescript_program_line_count(const surgescript_program_t* program)
+{
+    return ssarray_length(program->line);
+}
+
+/*
+ * surgescript_program_get_line()
+ * Reads a line of code of the program. Returns false if there is no such line
+ */
+bool surgescript_program_get_line(const surgescript_program_t* program, int line, surgescript_program_operator_t* op, surgescript_program_operand_t* a, surgescript_program_operand_t* b)
+{
+    if(line >= 0 && line < ssarray_length(program->line)) {
+        *op = program->line[line].instruction;
+        *a = program->line[line].a;
+        *b = program->line[line].b;
+        return true;
+    }
+    else
+        return false;
+}
+
+/*
+ * surgescript_program_has_label()
+ * Is there a label at the given line that is the target of a jump? (i.e.,
+ * may the code jump to that line?) Labels that haven't been added yet are
+ * ignored
+ */
+bool surgescript_program_has_label(const surgescript_program_t* program, int line)
+{
+    /* new labels point to line 0 until they are added */
+    if(line <= 0)
+        return false;
+
+    for(int i = 0; i < ssarray_length(program->label); i++) {
+        if((int)program->label[i] != line)
+            continue;
+
+        for(int k = 0; k < ssarray_length(program->line); k++) {
+            if(is_jump_instruction(program->line[k].instruction) && program->line[k].a.u == i)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * surgescript_program_remove_lines()
+ * Removes the last lines of code of the program, from first_line onwards.
+ * Make sure that no jump targets the removed lines. Labels that point
+ * to them are moved to the end of the program
+ */
+void surgescript_program_remove_lines(surgescript_program_t* program, int first_line)
+{
+    check_writable(program, "surgescript_program_remove_lines");
+    if(first_line < 0 || first_line >= ssarray_length(program->line))
+        return;
+
+    ssarray_truncate(program->line, first_line);
+    discard_machine_code(program);
+    for(int i = 0; i < ssarray_length(program->label); i++)
+        program->label[i] = ssmin(program->label[i], (surgescript_program_label_t)first_line);
+}
+
 /*
  * surgescript_program_add_label()
  * Adds a newly created label to the program
  */
 void surgescript_program_add_label(surgescript_program_t* program, surgescript_program_label_t label)
 {
+    check_writable(program, "surgescript_program_add_label");
     program->label[label] = ssarray_length(program->line);
 }
 
@@ -182,8 +348,12 @@ int surgescript_program_add_text(surgescript_program_t* program, const char* tex
 {
     int idx = surgescript_program_find_text(program, text);
     if(idx < 0) { /* if the text isn't already there */
-        ssarray_push(program->text, ssstrdup(text));
-        return ssarray_length(program->text) - 1;
+        check_writable(program, "surgescript_program_add_text");
+        if(program->literal != NULL) /* the caches will be recreated */
+            program->literal = destroy_literals(program, program->literal);
+        if(program->callsite != NULL)
+            program->callsite = ssfree(program->callsite);
+        return push_text(program, ssstrdup(text));
     }
     else
         return idx;
@@ -195,6 +365,7 @@ int surgescript_program_add_text(surgescript_program_t* program, const char* tex
  */
 surgescript_program_label_t surgescript_program_new_label(surgescript_program_t* program)
 {
+    check_writable(program, "surgescript_program_new_label");
     ssarray_push(program->label, 0);
     return ssarray_length(program->label) - 1;
 }
@@ -207,6 +378,13 @@ int surgescript_program_find_text(const surgescript_program_t* program, const ch
 {
     int i, len = ssarray_length(program->text);
 
+    /* look up the index while the program is being written */
+    if(!program->frozen) {
+        surgescript_program_textindex_t* entry = NULL;
+        HASH_FIND_STR(program->text_index, text, entry);
+        return entry != NULL ? entry->index : -1;
+    }
+
     for(i = 0; i < len; i++) {
         if(strcmp(program->text[i], text) == 0)
             return i;
@@ -245,14 +423,30 @@ int surgescript_program_arity(const surgescript_program_t* program)
     return program->arity;
 }
 
+/*
+ * surgescript_program_heap_size()
+ * How many cells of the heap of its object does this program access?
+ * (i.e., 1 + the largest address it reads or writes; 0 if none)
+ */
+int surgescript_program_heap_size(const surgescript_program_t* program)
+{
+    int size = 0;
+
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        const surgescript_program_operation_t* op = &(program->line[i]);
+        if(op->instruction == SSOP_PEEK || op->instruction == SSOP_POKE)
+            size = ssmax(size, (int)op->b.u + 1);
+    }
+
+    return size;
+}
+
 /* dump the program to a file */
-void surgescript_program_dump(surgescript_program_t* program, FILE* fp)
+void surgescript_program_dump(const surgescript_program_t* program, FILE* fp)
 {
     int i;
     char hex[2][1 + 2 * sizeof(unsigned)];
-    surgescript_program_operation_t* op;
-
-    remove_labels(program);
+    const surgescript_program_operation_t* op;
 
     /* print header */
     fprintf(fp,
@@ -289,6 +483,127 @@ void surgescript_program_dump(surgescript_program_t* program, FILE* fp)
     fprintf(fp, "    ]\n}\n");
 }
 
+/*
+ * surgescript_program_write()
+ * Writes the program to a binary stream, in the format used by precompiled
+ * bytecode (see compiler/bytecode.c). Native programs can't be written
+ */
+bool surgescript_program_write(const surgescript_program_t* program, FILE* fp)
+{
+    if(surgescript_program_is_native(program))
+        return false;
+
+    /* header */
+    write_u32(fp, program->arity);
+    write_u32(fp, ssarray_length(program->text));
+    write_u32(fp, ssarray_length(program->line));
+
+    /* texts */
+    for(int i = 0; i < ssarray_length(program->text); i++) {
+        uint32_t length = strlen(program->text[i]);
+        write_u32(fp, length);
+        fwrite(program->text[i], sizeof(char), length, fp);
+    }
+
+    /* code */
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        const surgescript_program_operation_t* op = &(program->line[i]);
+        write_u32(fp, generic_instruction(op->instruction)); /* not quickened */
+        write_u64(fp, op->a._u);
+        write_u64(fp, op->b._u);
+    }
+
+    return !ferror(fp);
+}
+
+/*
+ * surgescript_program_read()
+ * Reads a program written by surgescript_program_write() from a memory
+ * buffer that ends at end, advancing *data. Returns NULL if the data is
+ * malformed, i.e., if any instruction or operand is out of range.
+ *
+ * The program is returned frozen (see surgescript_program_freeze()): its
+ * code and its texts are copied once, straight into their final block. The
+ * copy can't be avoided, because the buffer (a mapped file) is released
+ * after loading and because the code is quickened in place when it runs
+ */
+surgescript_program_t* surgescript_program_read(const char** data, const char* end)
+{
+    const size_t line_size = 2 * sizeof(uint64_t) + sizeof(uint32_t); /* instruction + operands */
+    surgescript_program_t* program = NULL;
+    surgescript_program_operation_t* line;
+    uint32_t arity, text_count, line_count, length;
+    const char *p = *data, *texts;
+    char *block, *chars;
+    char** text;
+    size_t size;
+
+    /* header */
+    if(!read_u32(&p, end, &arity) || !read_u32(&p, end, &text_count) || !read_u32(&p, end, &line_count))
+        return NULL;
+    else if(arity > MAX_PROGRAM_ARITY)
+        return NULL;
+
+    /* measure the texts */
+    texts = p;
+    size = line_count * sizeof(*line) + text_count * sizeof(char*);
+    for(uint32_t i = 0; i < text_count; i++) {
+        if(!read_u32(&p, end, &length) || (size_t)(end - p) < length)
+            return NULL;
+        size += 1 + length;
+        p += length;
+    }
+
+    /* the code must fit in the buffer */
+    if((size_t)(end - p) / line_size < line_count)
+        return NULL;
+
+    /* lay out the code, the texts and their characters in a single block */
+    block = ssmalloc(ssmax(size, 1));
+    line = (surgescript_program_operation_t*)block;
+    text = (char**)(block + line_count * sizeof(*line));
+    chars = (char*)(text + text_count);
+    for(uint32_t i = 0; i < text_count; i++) {
+        read_u32(&texts, end, &length);
+        text[i] = memcpy(chars, texts, length * sizeof(char));
+        text[i][length] = '\0';
+        chars += length + 1;
+        texts += length;
+    }
+
+    for(uint32_t i = 0; i < line_count; i++) {
+        uint32_t instruction;
+
+        read_u32(&p, end, &instruction);
+        read_u64(&p, end, &line[i].a._u);
+        read_u64(&p, end, &line[i].b._u);
+        line[i].instruction = (surgescript_program_operator_t)ssmin(instruction, (uint32_t)OPERATOR_COUNT);
+    }
+
+    /* validate the instructions and their operands */
+    if(!is_valid_code(line, line_count, text_count, arity)) {
+        ssfree(block);
+        return NULL;
+    }
+
+    /* create the frozen program */
+    program = surgescript_program_create(arity);
+    ssarray_release(program->line);
+    ssarray_release(program->text);
+    ssarray_release(program->label);
+    program->line = line;
+    program->line_len = program->line_cap = line_count;
+    program->text = text;
+    program->text_len = program->text_cap = text_count;
+    program->frozen = true;
+    program->callsite = create_callsites(program);
+    program->literal = create_literals(program);
+
+    /* done! */
+    *data = p;
+    return program;
+}
+
 
 /*
  * surgescript_program_call()
@@ -319,6 +634,130 @@ bool surgescript_program_is_native(const surgescript_program_t* program)
     return program->run == run_cprogram;
 }
 
+/*
+ * surgescript_program_freeze()
+ * Finalizes the code of the program, which is then ready to be run: jumps
+ * refer to lines, the code and the texts are laid out in a single block and
+ * the caches are created. The code can no longer be changed. Programs are
+ * frozen when they're put in a program pool
+ */
+void surgescript_program_freeze(surgescript_program_t* program)
+{
+    size_t line_count = ssarray_length(program->line);
+    size_t text_count = ssarray_length(program->text);
+    size_t size = line_count * sizeof(*(program->line)) + text_count * sizeof(char*);
+    char *block, *p;
+    char** text;
+
+    if(program->frozen)
+        return;
+
+    /* resolve the jumps */
+    remove_labels(program);
+    ssarray_release(program->label);
+    clear_text_index(program);
+
+    /* lay out the code, the texts and their characters in a single block */
+    for(size_t i = 0; i < text_count; i++)
+        size += 1 + strlen(program->text[i]);
+    p = block = ssmalloc(ssmax(size, 1));
+
+    memcpy(p, program->line, line_count * sizeof(*(program->line)));
+    p += line_count * sizeof(*(program->line));
+    text = (char**)p;
+    p += text_count * sizeof(char*);
+    for(size_t i = 0; i < text_count; i++) {
+        size_t length = 1 + strlen(program->text[i]);
+        text[i] = memcpy(p, program->text[i], length);
+        ssfree(program->text[i]);
+        p += length;
+    }
+
+    ssfree(program->line);
+    ssfree(program->text);
+    program->line = (surgescript_program_operation_t*)block;
+    program->text = text;
+    program->frozen = true;
+
+    /* create the caches */
+    if(program->callsite == NULL)
+        program->callsite = create_callsites(program);
+    if(program->literal == NULL)
+        program->literal = create_literals(program);
+}
+
+/*
+ * surgescript_program_clone()
+ * Creates a copy of a program. The copy is frozen, its instructions are
+ * generic (not quickened) and it has no machine code, so it starts cold
+ */
+surgescript_program_t* surgescript_program_clone(const surgescript_program_t* program)
+{
+    surgescript_program_t* clone;
+
+    if(surgescript_program_is_native(program))
+        return surgescript_program_create_native(program->arity, ((const surgescript_cprogram_t*)program)->cfunction);
+
+    clone = surgescript_program_create(program->arity);
+    for(int i = 0; i < ssarray_length(program->text); i++)
+        push_text(clone, ssstrdup(program->text[i]));
+    for(int i = 0; i < ssarray_length(program->label); i++)
+        ssarray_push(clone->label, program->label[i]);
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        surgescript_program_operation_t op = program->line[i];
+        op.instruction = generic_instruction(op.instruction);
+        ssarray_push(clone->line, op);
+    }
+
+    surgescript_program_freeze(clone);
+    return clone;
+}
+
+/*
+ * surgescript_program_make_shareable()
+ * Prepares the program to be run by VMs on multiple threads. The program
+ * becomes read-only: its caches are built in advance, using the ids of the
+ * given pool, and it no longer modifies itself when run.
+ *
+ * This has a cost: from now on, the program will not be quickened (its
+ * instructions will not be specialized to the types they observe), it will
+ * not be compiled to machine code, and its calls will not be cached inline
+ * (they are resolved in advance, but each call still looks up the program
+ * in the pool). As a result, a shareable program runs slower than one that
+ * is private to a VM. Prefer sharing when many VMs run the same scripts,
+ * and a private VM when a single VM runs hot code.
+ */
+void surgescript_program_make_shareable(surgescript_program_t* program, surgescript_programpool_t* pool)
+{
+    if(program->shareable)
+        return;
+
+    /* resolve the jumps */
+    surgescript_program_freeze(program);
+
+    /* resolve the names of the called programs */
+    for(int i = 0; i < ssarray_length(program->line); i++) {
+        const surgescript_program_operation_t* op = &(program->line[i]);
+        if(is_call_instruction(op->instruction) && op->a.u < ssarray_length(program->text))
+            program->callsite[op->a.u].program_id = surgescript_programpool_program_id(pool, program->text[op->a.u]);
+    }
+
+    /* string literals will be copied by multiple threads */
+    if(program->literal != NULL)
+        program->literal = destroy_literals(program, program->literal);
+    program->shareable = true;
+    program->literal = create_literals(program);
+}
+
+/*
+ * surgescript_program_is_shareable()
+ * Can the program be run by VMs on multiple threads?
+ */
+bool surgescript_program_is_shareable(const surgescript_program_t* program)
+{
+    return program->shareable;
+}
+
 
 
 /* -------------------------------
@@ -339,6 +778,13 @@ surgescript_program_t* init_program(surgescript_program_t* program, int arity, v
     ssarray_init(program->line);
     ssarray_init(program->label);
     ssarray_init(program->text);
+    program->text_index = NULL;
+    program->callsite = NULL;
+    program->literal = NULL;
+    program->shareable = false;
+    program->frozen = false;
+    program->jit = NULL;
+    program->call_count = 0;
 
     return program;
 }
@@ -346,301 +792,489 @@ surgescript_program_t* init_program(surgescript_program_t* program, int arity, v
 /* runs a program */
 void run_program(surgescript_program_t* program, surgescript_renv_t* runtime_environment)
 {
-    int ip = 0; /* instruction pointer */
-    remove_labels(program);
-
-    while(ip < ssarray_length(program->line))
-        run_instruction(program, runtime_environment, program->line[ip].instruction, program->line[ip].a, program->line[ip].b, &ip);
-}
-
-/* runs a C-program */
-void run_cprogram(surgescript_program_t* program, surgescript_renv_t* runtime_environment)
-{
-    surgescript_cprogram_t* cprogram = (surgescript_cprogram_t*)program;
-    surgescript_object_t* object = surgescript_renv_owner(runtime_environment);
+    /* the state of the interpreter is kept in locals */
+    surgescript_var_t** _t = surgescript_renv_tmp(runtime_environment);
     surgescript_stack_t* stack = surgescript_renv_stack(runtime_environment);
-    const surgescript_var_t** param = program->arity > 0 ? alloca(program->arity * sizeof(*param)) : NULL;
-    surgescript_var_t* return_value = NULL;
-
-    /* grab parameters from the stack (stacked in left-to-right order) */
-    for(int i = 1; i <= program->arity; i++)
-        param[program->arity-i] = surgescript_stack_peek(stack, -i);
-
-    /* call C-function */
-    return_value = cprogram->cfunction(object, param, program->arity);
-    if(return_value != NULL) {
-        surgescript_var_copy(*(surgescript_renv_tmp(runtime_environment) + 0), return_value);
-        surgescript_var_destroy(return_value);
+    surgescript_heap_t* heap = surgescript_renv_heap(runtime_environment);
+    surgescript_object_t* owner = surgescript_renv_owner(runtime_environment);
+    const surgescript_program_operation_t* line;
+    const surgescript_program_operation_t* op;
+    const surgescript_var_t* literal;
+    unsigned length, text_count;
+    unsigned ip = 0; /* instruction pointer */
+
+    /* the program has been frozen (see surgescript_program_freeze()) */
+    line = program->line;
+    length = ssarray_length(program->line);
+    text_count = ssarray_length(program->text);
+    literal = program->literal;
+
+    /* hot programs are compiled to machine code. Shareable
+       programs are read-only, so they are never compiled */
+    if(program->jit == NULL && !program->shareable && program->call_count < JIT_THRESHOLD) {
+        if(++program->call_count == JIT_THRESHOLD)
+            program->jit = surgescript_jit_compile(program);
     }
-    else
-        surgescript_var_set_null(*(surgescript_renv_tmp(runtime_environment) + 0));
-}
 
-/* runs an instruction */
-void run_instruction(surgescript_program_t* program, surgescript_renv_t* runtime_environment, surgescript_program_operator_t instruction, surgescript_program_operand_t a, surgescript_program_operand_t b, int* ip)
-{
-    /* temporary variables */
-    surgescript_var_t** _t = surgescript_renv_tmp(runtime_environment);
+    if(program->jit != NULL && surgescript_stack_depth(stack) < JIT_MAX_DEPTH) {
+        surgescript_jit_frame_t frame = { _t, runtime_environment, stack, program, literal, call_program };
+        surgescript_jit_run(program->jit, &frame);
+        return;
+    }
 
-    /* helper macro */
+    /* helper macros */
     #ifdef t
     #undef t
     #endif
     #define t(k)             _t[(k).u & 3]
 
-    /* debug mode */
+    /* quickening: instructions observing numbers are rewritten in-place to
+       number-only versions, which are rewritten back if the types change.
+       Shareable programs are read-only, so they always run the generic code */
+    #define NUMBERS(x, y)    (surgescript_var_fast_is_number(x) && surgescript_var_fast_is_number(y))
+    #define QUICKEN(x)       do { if(!program->shareable) program->line[ip].instruction = (x); } while(0)
+
     #ifdef SURGESCRIPT_DEBUG_MODE
-    debug(program, runtime_environment, instruction, a, b, _t);
+    #define DEBUG_INSTRUCTION() debug(program, runtime_environment, op->instruction, op->a, op->b, _t)
+    #else
+    #define DEBUG_INSTRUCTION() (void)0
+    #endif
+
+    #if defined(SURGESCRIPT_THREADED_DISPATCH)
+    /* threaded code: each instruction jumps directly to the next one */
+    static const void* dispatch_table[] = {
+        #define LABEL_ADDRESS(x, y) &&do_##x,
+        SURGESCRIPT_PROGRAM_OPERATORS(LABEL_ADDRESS)
+        #undef LABEL_ADDRESS
+    };
+
+    #define OPERATION(x)     do_##x
+    #define DISPATCH()       do { if(ip >= length) return; op = line + ip; DEBUG_INSTRUCTION(); goto *dispatch_table[op->instruction]; } while(0)
+    #define NEXT()           do { ++ip; DISPATCH(); } while(0)
+    #define JUMP(addr)       do { ip = (addr); DISPATCH(); } while(0)
+
+    DISPATCH();
+    #else
+    /* portable fallback: a plain switch inside a loop */
+    #define OPERATION(x)     case x
+    #define NEXT()           { ++ip; continue; }
+    #define JUMP(addr)       { ip = (addr); continue; }
+
+    while(ip < length) {
+        op = line + ip;
+        DEBUG_INSTRUCTION();
+
+        switch(op->instruction) {
     #endif
 
-    /* run the instruction */
-    switch(instruction) {
         /* basics */
-        case SSOP_NOP: /* no-operation */
-            break;
+        OPERATION(SSOP_NOP): /* no-operation */
+            NEXT();
 
-        case SSOP_SELF: /* owner object ("this" pointer) */
-            surgescript_var_set_objecthandle(t(a), surgescript_object_handle(surgescript_renv_owner(runtime_environment)));
-            break;
+        OPERATION(SSOP_SELF): /* owner object ("this" pointer) */
+            surgescript_var_set_objecthandle(t(op->a), surgescript_object_handle(owner));
+            NEXT();
 
-        case SSOP_STATE: /* t[a] receives the current state. If b == -1, then the current state is set to t[a] instead. */
-            if(b.i == -1) {
+        OPERATION(SSOP_STATE): /* t[a] receives the current state. If b == -1, then the current state is set to t[a] instead. */
+            if(op->b.i == -1) {
                 char state[256] = "";
-                surgescript_var_to_string(t(a), state, sizeof(state));
-                surgescript_object_set_state(surgescript_renv_owner(runtime_environment), state);
+                surgescript_var_to_string(t(op->a), state, sizeof(state));
+                surgescript_object_set_state(owner, state);
             }
             else
-                surgescript_var_set_string(t(a), surgescript_object_state(surgescript_renv_owner(runtime_environment)));
-            break;
+                surgescript_var_set_string(t(op->a), surgescript_object_state(owner));
+            NEXT();
 
-        case SSOP_CALLER: /* caller object */
-            surgescript_var_set_objecthandle(t(a), surgescript_renv_caller(runtime_environment));
-            break;
+        OPERATION(SSOP_CALLER): /* caller object */
+            surgescript_var_set_objecthandle(t(op->a), surgescript_renv_caller(runtime_environment));
+            NEXT();
 
         /* assignment operations */
-        case SSOP_MOVN: /* move null */
-            surgescript_var_set_null(t(a));
-            break;
+        OPERATION(SSOP_MOVN): /* move null */
+            surgescript_var_set_null(t(op->a));
+            NEXT();
 
-        case SSOP_MOVB: /* move boolean */
-            surgescript_var_set_bool(t(a), b.b);
-            break;
+        OPERATION(SSOP_MOVB): /* move boolean */
+            surgescript_var_set_bool(t(op->a), op->b.b);
+            NEXT();
 
-        case SSOP_MOVF: /* move number */
-            surgescript_var_set_number(t(a), b.f);
-            break;
+        OPERATION(SSOP_MOVF): /* move number */
+            surgescript_var_set_number(t(op->a), op->b.f);
+            NEXT();
 
-        case SSOP_MOVS: /* move string */
-            if(b.u < ssarray_length(program->text))
-                surgescript_var_set_string(t(a), program->text[b.u]);
-            break;
+        OPERATION(SSOP_MOVS): /* move string */
+            if(op->b.u < text_count)
+                surgescript_var_copy(t(op->a), &literal[op->b.u]); /* shares the string */
+            NEXT();
 
-        case SSOP_MOVO: /* move object handle */
-            surgescript_var_set_objecthandle(t(a), b.u);
-            break;
+        OPERATION(SSOP_MOVO): /* move object handle */
+            surgescript_var_set_objecthandle(t(op->a), op->b.u);
+            NEXT();
 
-        case SSOP_MOVX: /* move int64 */
-            surgescript_var_set_rawbits(t(a), b.u);
-            break;
+        OPERATION(SSOP_MOVX): /* move int64 */
+            surgescript_var_set_rawbits(t(op->a), op->b.u);
+            NEXT();
 
-        case SSOP_MOV: /* move temp */
-            surgescript_var_copy(t(a), t(b));
-            break;
+        OPERATION(SSOP_MOV): /* move temp */
+            surgescript_var_copy(t(op->a), t(op->b));
+            NEXT();
 
-        case SSOP_XCHG: /* fast exchange */
-            surgescript_var_swap(t(a), t(b));
-            break;
+        OPERATION(SSOP_XCHG): /* fast exchange */
+            surgescript_var_swap(t(op->a), t(op->b));
+            NEXT();
 
         /* heap operations */
-        case SSOP_ALLOC:
-            surgescript_var_set_number(t(a), surgescript_heap_malloc(surgescript_renv_heap(runtime_environment)));
-            break;
+        OPERATION(SSOP_ALLOC):
+            surgescript_var_set_number(t(op->a), surgescript_heap_malloc(heap));
+            NEXT();
 
-        case SSOP_PEEK:
-            surgescript_var_copy(t(a), surgescript_heap_at(surgescript_renv_heap(runtime_environment), b.u));
-            break;
+        OPERATION(SSOP_PEEK):
+            surgescript_var_copy(t(op->a), surgescript_heap_at(heap, op->b.u));
+            NEXT();
 
-        case SSOP_POKE:
-            surgescript_var_copy(surgescript_heap_at(surgescript_renv_heap(runtime_environment), b.u), t(a));
-            break;
+        OPERATION(SSOP_POKE):
+            surgescript_var_copy(surgescript_heap_at(heap, op->b.u), t(op->a));
+            NEXT();
 
         /* stack operations */
-        case SSOP_PUSH:
-            surgescript_stack_push(surgescript_renv_stack(runtime_environment), surgescript_var_clone(t(a)));
-            break;
+        OPERATION(SSOP_PUSH):
+            surgescript_stack_push_copy(stack, t(op->a));
+            NEXT();
 
-        case SSOP_POP:
-            surgescript_var_copy(t(a), surgescript_stack_top(surgescript_renv_stack(runtime_environment)));
-            surgescript_stack_pop(surgescript_renv_stack(runtime_environment));
-            break;
+        OPERATION(SSOP_POP):
+            surgescript_var_copy(t(op->a), surgescript_stack_top(stack));
+            surgescript_stack_pop(stack);
+            NEXT();
 
-        case SSOP_SPEEK:
-            surgescript_var_copy(t(a), surgescript_stack_peek(surgescript_renv_stack(runtime_environment), b.i));
-            break;
+        OPERATION(SSOP_SPEEK):
+            surgescript_var_copy(t(op->a), surgescript_stack_peek(stack, op->b.i));
+            NEXT();
 
-        case SSOP_SPOKE:
-            surgescript_stack_poke(surgescript_renv_stack(runtime_environment), b.i, t(a));
-            break;
+        OPERATION(SSOP_SPOKE):
+            surgescript_stack_poke(stack, op->b.i, t(op->a));
+            NEXT();
 
-        case SSOP_PUSHN:
-            surgescript_stack_pushn(surgescript_renv_stack(runtime_environment), a.u);
-            break;
+        OPERATION(SSOP_SSWAP): /* fast exchange */
+            surgescript_stack_swap(stack, op->b.i, t(op->a));
+            NEXT();
 
-        case SSOP_POPN:
-            surgescript_stack_popn(surgescript_renv_stack(runtime_environment), a.u);
-            break;
+        OPERATION(SSOP_PUSHN):
+            surgescript_stack_pushn(stack, op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_POPN):
+            surgescript_stack_popn(stack, op->a.u);
+            NEXT();
 
         /* basic arithmetic */
-        case SSOP_INC:
-            if(a.u != 2)
-                surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) + 1);
+        OPERATION(SSOP_INC):
+            if(op->a.u != 2) {
+                if(surgescript_var_fast_is_number(t(op->a)))
+                    QUICKEN(SSOP_INCN);
+                surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) + 1);
+            }
             else
-                surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) + 1);
-            break;
-
-        case SSOP_DEC:
-            if(a.u != 2)
-                surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) - 1);
+                surgescript_var_set_rawbits(t(op->a), surgescript_var_get_rawbits(t(op->a)) + 1);
+            NEXT();
+
+        OPERATION(SSOP_DEC):
+            if(op->a.u != 2) {
+                if(surgescript_var_fast_is_number(t(op->a)))
+                    QUICKEN(SSOP_DECN);
+                surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) - 1);
+            }
             else
-                surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) - 1);
-            break;
-
-        case SSOP_ADD:
-            surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) + surgescript_var_get_number(t(b)));
-            break;
-
-        case SSOP_SUB:
-            surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) - surgescript_var_get_number(t(b)));
-            break;
-
-        case SSOP_MUL:
-            surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) * surgescript_var_get_number(t(b)));
-            break;
-
-        case SSOP_DIV:
+                surgescript_var_set_rawbits(t(op->a), surgescript_var_get_rawbits(t(op->a)) - 1);
+            NEXT();
+
+        OPERATION(SSOP_ADD):
+            if(NUMBERS(t(op->a), t(op->b)))
+                QUICKEN(SSOP_ADDN);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) + surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_SUB):
+            if(NUMBERS(t(op->a), t(op->b)))
+                QUICKEN(SSOP_SUBN);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) - surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_MUL):
+            if(NUMBERS(t(op->a), t(op->b)))
+                QUICKEN(SSOP_MULN);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) * surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_DIV):
             /* division by zero should follow the IEEE-754 */
-            surgescript_var_set_number(t(a), surgescript_var_get_number(t(a)) / surgescript_var_get_number(t(b)));
-            break;
+            if(NUMBERS(t(op->a), t(op->b)))
+                QUICKEN(SSOP_DIVN);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) / surgescript_var_get_number(t(op->b)));
+            NEXT();
 
-        case SSOP_MOD:
-            surgescript_var_set_number(t(a), fmod(surgescript_var_get_number(t(a)), surgescript_var_get_number(t(b))));
-            break;
+        OPERATION(SSOP_MOD):
+            surgescript_var_set_number(t(op->a), fmod(surgescript_var_get_number(t(op->a)), surgescript_var_get_number(t(op->b))));
+            NEXT();
 
-        case SSOP_NEG:
-            surgescript_var_set_number(t(a), -surgescript_var_get_number(t(b)));
-            break;
+        OPERATION(SSOP_NEG):
+            surgescript_var_set_number(t(op->a), -surgescript_var_get_number(t(op->b)));
+            NEXT();
 
-        case SSOP_LNOT:
-            surgescript_var_set_bool(t(a), !surgescript_var_get_bool(t(b)));
-            break;
+        OPERATION(SSOP_LNOT):
+            surgescript_var_set_bool(t(op->a), !surgescript_var_get_bool(t(op->b)));
+            NEXT();
 
-        case SSOP_LNOT2:
-            surgescript_var_set_bool(t(a), surgescript_var_get_bool(t(b)));
-            break;
+        OPERATION(SSOP_LNOT2):
+            surgescript_var_set_bool(t(op->a), surgescript_var_get_bool(t(op->b)));
+            NEXT();
 
         /* bitwise operations */
-        case SSOP_NOT:
-            surgescript_var_set_rawbits(t(a), ~surgescript_var_get_rawbits(t(b)));
-            break;
+        OPERATION(SSOP_NOT):
+            surgescript_var_set_rawbits(t(op->a), ~surgescript_var_get_rawbits(t(op->b)));
+            NEXT();
 
-        case SSOP_AND:
-            surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) & surgescript_var_get_rawbits(t(b)));
-            break;
+        OPERATION(SSOP_AND):
+            surgescript_var_set_rawbits(t(op->a), surgescript_var_get_rawbits(t(op->a)) & surgescript_var_get_rawbits(t(op->b)));
+            NEXT();
 
-        case SSOP_OR:
-            surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) | surgescript_var_get_rawbits(t(b)));
-            break;
+        OPERATION(SSOP_OR):
+            surgescript_var_set_rawbits(t(op->a), surgescript_var_get_rawbits(t(op->a)) | surgescript_var_get_rawbits(t(op->b)));
+            NEXT();
 
-        case SSOP_XOR:
-            surgescript_var_set_rawbits(t(a), surgescript_var_get_rawbits(t(a)) ^ surgescript_var_get_rawbits(t(b)));
-            break;
+        OPERATION(SSOP_XOR):
+            surgescript_var_set_rawbits(t(op->a), surgescript_var_get_rawbits(t(op->a)) ^ surgescript_var_get_rawbits(t(op->b)));
+            NEXT();
 
         /* comparing & testing */
-        case SSOP_TEST:
-            surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(a)) & surgescript_var_get_rawbits(t(b)));
-            break;
-
-        case SSOP_TCHK:
-            surgescript_var_set_rawbits(_t[2], surgescript_var_typecheck(t(a), b.i));
-            break;
+        OPERATION(SSOP_TEST):
+            surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(op->a)) & surgescript_var_get_rawbits(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_TCHK):
+            surgescript_var_set_rawbits(_t[2], surgescript_var_typecheck(t(op->a), op->b.i));
+            NEXT();
+
+        OPERATION(SSOP_TC01):
+            if(NUMBERS(_t[0], _t[1]) && !program->shareable && is_addition(program, ip))
+                QUICKEN(SSOP_TC01N);
+            surgescript_var_set_rawbits(_t[2], surgescript_var_typecheck(_t[0], op->a.i) & surgescript_var_typecheck(_t[1], op->a.i));
+            NEXT();
+
+        OPERATION(SSOP_TCMP):
+            surgescript_var_set_rawbits(_t[2], surgescript_var_typecode(t(op->a)) ^ surgescript_var_typecode(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_CMP):
+            if(NUMBERS(t(op->a), t(op->b)))
+                QUICKEN(SSOP_CMPN);
+            surgescript_var_set_rawbits(_t[2], surgescript_var_compare(t(op->a), t(op->b)));
+            NEXT();
 
-        case SSOP_TC01:
-            surgescript_var_set_rawbits(_t[2], surgescript_var_typecheck(_t[0], a.i) & surgescript_var_typecheck(_t[1], a.i));
-            break;
-
-        case SSOP_TCMP:
-            surgescript_var_set_rawbits(_t[2], surgescript_var_typecode(t(a)) ^ surgescript_var_typecode(t(b)));
-            break;
+        /* jumping */
+        OPERATION(SSOP_JMP):
+            JUMP(op->a.u);
+
+        OPERATION(SSOP_JE):
+            if(!surgescript_var_get_rawbits(_t[2]))
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_JNE):
+            if(surgescript_var_get_rawbits(_t[2]))
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_JL):
+            if(surgescript_var_get_rawbits(_t[2]) < 0)
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_JG):
+            if(surgescript_var_get_rawbits(_t[2]) > 0)
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_JLE):
+            if(surgescript_var_get_rawbits(_t[2]) <= 0)
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_JGE):
+            if(surgescript_var_get_rawbits(_t[2]) >= 0)
+                JUMP(op->a.u);
+            NEXT();
 
-        case SSOP_CMP:
-            surgescript_var_set_rawbits(_t[2], surgescript_var_compare(t(a), t(b)));
-            break;
+        /* function calls */
+        OPERATION(SSOP_CALL):
+            if(op->a.u < text_count)
+                call_program(runtime_environment, program, op->a.u, op->b.u);
+            NEXT();
 
-        /* jumping */
-        case SSOP_JMP:
-            *ip = a.u;
+        OPERATION(SSOP_RET):
             return;
 
-        case SSOP_JE:
-            if(!surgescript_var_get_rawbits(_t[2])) {
-                *ip = a.u;
-                return;
+        /* superinstructions */
+        OPERATION(SSOP_CALLP):
+            if(op->a.u < text_count)
+                call_program(runtime_environment, program, op->a.u, op->b.u);
+            surgescript_stack_popn(stack, op->b.u + 1);
+            NEXT();
+
+        OPERATION(SSOP_GET):
+            surgescript_stack_push_copy(stack, t(op->b));
+            if(op->a.u < text_count)
+                call_program(runtime_environment, program, op->a.u, 0);
+            surgescript_stack_popn(stack, 1);
+            NEXT();
+
+        OPERATION(SSOP_CAT):
+            surgescript_var_set_objecthandle(_t[2], op->b.u);
+            surgescript_stack_push_copy(stack, _t[2]);
+            surgescript_stack_push_copy(stack, _t[1]);
+            surgescript_stack_push_copy(stack, _t[0]);
+            if(op->a.u < text_count)
+                call_program(runtime_environment, program, op->a.u, 2);
+            surgescript_stack_popn(stack, 3);
+            NEXT();
+
+        OPERATION(SSOP_TJE):
+            surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(op->b)));
+            if(!surgescript_var_get_rawbits(_t[2]))
+                JUMP(op->a.u);
+            NEXT();
+
+        OPERATION(SSOP_TJNE):
+            surgescript_var_set_rawbits(_t[2], surgescript_var_get_rawbits(t(op->b)));
+            if(surgescript_var_get_rawbits(_t[2]))
+                JUMP(op->a.u);
+            NEXT();
+
+        /* numbers only; if the types don't match, run the generic code */
+        OPERATION(SSOP_ADDN):
+            if(NUMBERS(t(op->a), t(op->b))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) + surgescript_var_fast_get_number(t(op->b)));
+                NEXT();
             }
-            break;
-
-        case SSOP_JNE:
-            if(surgescript_var_get_rawbits(_t[2])) {
-                *ip = a.u;
-                return;
+            QUICKEN(SSOP_ADD);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) + surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_SUBN):
+            if(NUMBERS(t(op->a), t(op->b))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) - surgescript_var_fast_get_number(t(op->b)));
+                NEXT();
             }
-            break;
-
-        case SSOP_JL:
-            if(surgescript_var_get_rawbits(_t[2]) < 0) {
-                *ip = a.u;
-                return;
+            QUICKEN(SSOP_SUB);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) - surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_MULN):
+            if(NUMBERS(t(op->a), t(op->b))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) * surgescript_var_fast_get_number(t(op->b)));
+                NEXT();
             }
-            break;
-
-        case SSOP_JG:
-            if(surgescript_var_get_rawbits(_t[2]) > 0) {
-                *ip = a.u;
-                return;
+            QUICKEN(SSOP_MUL);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) * surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_DIVN):
+            if(NUMBERS(t(op->a), t(op->b))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) / surgescript_var_fast_get_number(t(op->b)));
+                NEXT();
             }
-            break;
-
-        case SSOP_JLE:
-            if(surgescript_var_get_rawbits(_t[2]) <= 0) {
-                *ip = a.u;
-                return;
+            QUICKEN(SSOP_DIV);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) / surgescript_var_get_number(t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_INCN):
+            if(surgescript_var_fast_is_number(t(op->a))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) + 1);
+                NEXT();
             }
-            break;
-
-        case SSOP_JGE:
-            if(surgescript_var_get_rawbits(_t[2]) >= 0) {
-                *ip = a.u;
-                return;
+            QUICKEN(SSOP_INC);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) + 1);
+            NEXT();
+
+        OPERATION(SSOP_DECN):
+            if(surgescript_var_fast_is_number(t(op->a))) {
+                surgescript_var_fast_set_number(t(op->a), surgescript_var_fast_get_number(t(op->a)) - 1);
+                NEXT();
             }
-            break;
+            QUICKEN(SSOP_DEC);
+            surgescript_var_set_number(t(op->a), surgescript_var_get_number(t(op->a)) - 1);
+            NEXT();
+
+        OPERATION(SSOP_CMPN):
+            if(NUMBERS(t(op->a), t(op->b))) {
+                double x = surgescript_var_fast_get_number(t(op->a)), y = surgescript_var_fast_get_number(t(op->b));
+                surgescript_var_set_rawbits(_t[2], isgreater(x, y) - isless(x, y));
+                NEXT();
+            }
+            QUICKEN(SSOP_CMP);
+            surgescript_var_set_rawbits(_t[2], surgescript_var_compare(t(op->a), t(op->b)));
+            NEXT();
+
+        OPERATION(SSOP_TC01N):
+            /* t[2] isn't set: it's not read after the addition,
+               as the generic code leaves a different value in it
+               depending on whether or not a string is involved */
+            if(NUMBERS(_t[0], _t[1])) {
+                surgescript_var_fast_set_number(_t[0], surgescript_var_fast_get_number(_t[0]) + surgescript_var_fast_get_number(_t[1]));
+                JUMP(line[ip + 3].a.u);
+            }
+            QUICKEN(SSOP_TC01);
+            surgescript_var_set_rawbits(_t[2], surgescript_var_typecheck(_t[0], op->a.i) & surgescript_var_typecheck(_t[1], op->a.i));
+            NEXT();
 
-        /* function calls */
-        case SSOP_CALL:
-            if(a.u < ssarray_length(program->text))
-                call_program(runtime_environment, program->text[a.u], b.u);
-            break;
+    #if !defined(SURGESCRIPT_THREADED_DISPATCH)
+        }
+    }
+    #endif
 
-        case SSOP_RET:
-            *ip = ssarray_length(program->line);
-            return;
+    /* clean up */
+    #undef OPERATION
+    #undef DISPATCH
+    #undef NEXT
+    #undef JUMP
+    #undef DEBUG_INSTRUCTION
+    #undef QUICKEN
+    #undef NUMBERS
+    #undef t
+}
+
+/* runs a C-program */
+void run_cprogram(surgescript_program_t* program, surgescript_renv_t* runtime_environment)
+{
+    surgescript_cprogram_t* cprogram = (surgescript_cprogram_t*)program;
+    surgescript_object_t* object = surgescript_renv_owner(runtime_environment);
+    surgescript_stack_t* stack = surgescript_renv_stack(runtime_environment);
+    const surgescript_var_t** param = program->arity > 0 ? alloca(program->arity * sizeof(*param)) : NULL;
+    surgescript_var_t* arg = program->arity > 0 ? alloca(program->arity * sizeof(*arg)) : NULL;
+    surgescript_var_t* return_value = NULL;
+
+    /* grab parameters from the stack (stacked in left-to-right order). The stack
+       may be reallocated while the C-function runs, so we pass shallow copies of
+       the parameters. They stay valid, because the stack owns them until we return */
+    for(int i = 1; i <= program->arity; i++) {
+        arg[program->arity-i] = *surgescript_stack_peek(stack, -i);
+        param[program->arity-i] = &(arg[program->arity-i]);
     }
 
-    /* next line */
-    ++(*ip);
+    /* call C-function */
+    return_value = cprogram->cfunction(object, param, program->arity);
+    if(return_value != NULL) {
+        surgescript_var_copy(*(surgescript_renv_tmp(runtime_environment) + 0), return_value);
+        surgescript_var_destroy(return_value);
+    }
+    else
+        surgescript_var_set_null(*(surgescript_renv_tmp(runtime_environment) + 0));
 }
 
-/* calls a program */
-void call_program(surgescript_renv_t* caller_runtime_environment, const char* program_name, int number_of_given_params)
+/* calls the program named caller->text[text_index] */
+void call_program(surgescript_renv_t* caller_runtime_environment, surgescript_program_t* caller, unsigned text_index, int number_of_given_params)
 {
+    const char* program_name = caller->text[text_index];
+
     /* preparing the stack */
     surgescript_stack_t* stack = surgescript_renv_stack(caller_runtime_environment);
     surgescript_stack_pushenv(stack);
@@ -659,7 +1293,7 @@ void call_program(surgescript_renv_t* caller_runtime_environment, const char* pr
         surgescript_object_t* object = surgescript_objectmanager_get(manager, object_handle);
         const char* object_name = surgescript_object_name(object);
         surgescript_programpool_t* pool = surgescript_renv_programpool(caller_runtime_environment);
-        surgescript_program_t* program = surgescript_programpool_get(pool, object_name, program_name); /* bottleneck? */
+        surgescript_program_t* program = find_program(caller, text_index, pool, object);
         
         /* does the selected program exist? */
         if(program != NULL) {
@@ -695,6 +1329,83 @@ void call_program(surgescript_renv_t* caller_runtime_environment, const char* pr
     surgescript_stack_popenv(stack); /* clear stack frame, including a unknown number of local variables */
 }
 
+/* finds the program named caller->text[text_index] of the given object, using the inline cache of the call site */
+surgescript_program_t* find_program(surgescript_program_t* caller, unsigned text_index, surgescript_programpool_t* pool, const surgescript_object_t* object)
+{
+    surgescript_program_callsite_t* site = &(caller->callsite[text_index]);
+    unsigned generation = surgescript_programpool_generation(pool);
+    int class_id = surgescript_object_class_id(object);
+    surgescript_program_t* program;
+
+    /* shareable programs are read-only: skip the cache (the id of the name is known) */
+    if(caller->shareable)
+        return surgescript_programpool_get_by_id(pool, class_id, site->program_id);
+
+    /* look for the class of the callee in the cache */
+    if(site->generation == generation) {
+        for(unsigned i = ssmin(site->count, CALLSITE_WAYS); i-- > 0;) {
+            if(site->entry[i].class_id == class_id)
+                return site->entry[i].program;
+        }
+    }
+    else {
+        /* the programs of the pool have changed */
+        site->generation = generation;
+        site->count = 0;
+    }
+
+    /* cache miss: query the dispatch table of the class */
+    if(site->program_id < 0)
+        site->program_id = surgescript_programpool_program_id(pool, caller->text[text_index]);
+    program = surgescript_programpool_get_by_id(pool, class_id, site->program_id);
+    if(program != NULL) {
+        unsigned i = (site->count++) % CALLSITE_WAYS;
+        site->entry[i].class_id = class_id;
+        site->entry[i].program = program;
+    }
+
+    return program;
+}
+
+/* creates an empty inline cache for each text (possible function name) of the program */
+surgescript_program_callsite_t* create_callsites(const surgescript_program_t* program)
+{
+    size_t count = ssmax(1, ssarray_length(program->text));
+    surgescript_program_callsite_t* callsite = ssmalloc(count * sizeof *callsite);
+    memset(callsite, 0, count * sizeof *callsite);
+    for(size_t i = 0; i < count; i++)
+        callsite[i].program_id = -1;
+    return callsite;
+}
+
+/* creates a string variable for each text of the program, so that string literals can be shared
+   (the strings of shareable programs are immortal, as they're not reference counted) */
+surgescript_var_t* create_literals(const surgescript_program_t* program)
+{
+    size_t count = ssmax(1, ssarray_length(program->text));
+    surgescript_var_t* literal = ssmalloc(count * sizeof *literal);
+    memset(literal, 0, count * sizeof *literal); /* null variables */
+    for(size_t i = 0; i < ssarray_length(program->text); i++) {
+        if(program->shareable)
+            surgescript_var_set_immortal_string(&literal[i], program->text[i]);
+        else
+            surgescript_var_set_string(&literal[i], program->text[i]);
+    }
+    return literal;
+}
+
+/* destroys the string variables created by create_literals() */
+surgescript_var_t* destroy_literals(const surgescript_program_t* program, surgescript_var_t* literal)
+{
+    for(size_t i = 0; i < ssarray_length(program->text); i++) {
+        if(program->shareable)
+            surgescript_var_release_immortal_string(&literal[i]);
+        else
+            surgescript_var_set_null(&literal[i]);
+    }
+    return ssfree(literal);
+}
+
 /* writes data to buf, in hex/big-endian format (writes (1 + 2 * sizeof(unsigned)) bytes to buf) */
 char* hexdump(unsigned data, char* buf)
 {
@@ -732,6 +1443,185 @@ void fputs_escaped(const char* str, FILE* fp)
     }
 }
 
+/* writes an integer to a binary stream (byte order of the host) */
+void write_u32(FILE* fp, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+void write_u64(FILE* fp, uint64_t value)
+{
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+/* reads an integer from a memory buffer, advancing *data. Returns false if there is not enough data */
+bool read_u32(const char** data, const char* end, uint32_t* value)
+{
+    if((size_t)(end - *data) < sizeof(*value))
+        return false;
+
+    memcpy(value, *data, sizeof(*value));
+    *data += sizeof(*value);
+    return true;
+}
+
+bool read_u64(const char** data, const char* end, uint64_t* value)
+{
+    if((size_t)(end - *data) < sizeof(*value))
+        return false;
+
+    memcpy(value, *data, sizeof(*value));
+    *data += sizeof(*value);
+    return true;
+}
+
+/* discards the machine code of a program, if any, after its code is changed */
+void discard_machine_code(surgescript_program_t* program)
+{
+    if(program->jit != NULL)
+        program->jit = surgescript_jit_destroy(program->jit);
+}
+
+/* frozen programs can't be changed */
+void check_writable(const surgescript_program_t* program, const char* fun)
+{
+    if(program->frozen)
+        ssfatal("Runtime Error: %s() can't change a frozen program", fun);
+}
+
+/* appends a (newly allocated) text to the program, indexing it; returns its index */
+int push_text(surgescript_program_t* program, char* text)
+{
+    int index = ssarray_push(program->text, text) - 1;
+    surgescript_program_textindex_t* entry = NULL;
+
+    /* find_text() returns the first index of each text */
+    HASH_FIND_STR(program->text_index, text, entry);
+    if(entry == NULL) {
+        entry = ssmalloc(sizeof *entry);
+        entry->text = text;
+        entry->index = index;
+        HASH_ADD_KEYPTR(hh, program->text_index, entry->text, strlen(entry->text), entry);
+    }
+
+    return index;
+}
+
+/* releases the hash index of the texts */
+void clear_text_index(surgescript_program_t* program)
+{
+    surgescript_program_textindex_t *it, *tmp;
+
+    HASH_ITER(hh, program->text_index, it, tmp) {
+        HASH_DEL(program->text_index, it);
+        ssfree(it);
+    }
+}
+
+/* validates code read from a file (see surgescript_program_read()): the
+   instructions must be generic and their operands must be in range. Heap
+   addresses depend on the object and are validated by the loader */
+bool is_valid_code(const surgescript_program_operation_t* line, unsigned line_count, unsigned text_count, unsigned arity)
+{
+    #define REG(x)      ((x).u < 4)
+    #define TEXT(x)     ((x).u < text_count)
+    #define STACK(x)    ((x).i >= -(int64_t)arity - 1 && (x).i <= (int64_t)frame_size)
+    uint64_t frame_size = 0;
+
+    /* an upper bound of the size of the stack frame: every cell is pushed by
+       an instruction, and the locals of a function (PUSHN) are written by at
+       least one instruction each */
+    for(unsigned i = 0; i < line_count; i++) {
+        switch(line[i].instruction) {
+            case SSOP_PUSHN: frame_size += ssmin(line[i].a.u, line_count); break;
+            case SSOP_PUSH: case SSOP_GET: frame_size += 1; break;
+            case SSOP_CAT: frame_size += 3; break;
+            default: break;
+        }
+    }
+
+    /* check each line */
+    for(unsigned i = 0; i < line_count; i++) {
+        surgescript_program_operand_t a = line[i].a, b = line[i].b;
+        bool valid = false;
+
+        switch(line[i].instruction) {
+            case SSOP_NOP: case SSOP_RET: case SSOP_TC01:
+                valid = true;
+                break;
+
+            case SSOP_SELF: case SSOP_CALLER: case SSOP_MOVN: case SSOP_MOVB:
+            case SSOP_MOVF: case SSOP_MOVO: case SSOP_MOVX: case SSOP_ALLOC:
+            case SSOP_PUSH: case SSOP_POP: case SSOP_INC: case SSOP_DEC:
+            case SSOP_TCHK: case SSOP_PEEK: case SSOP_POKE:
+                valid = REG(a);
+                break;
+
+            case SSOP_MOV: case SSOP_XCHG: case SSOP_ADD: case SSOP_SUB:
+            case SSOP_MUL: case SSOP_DIV: case SSOP_MOD: case SSOP_NEG:
+            case SSOP_LNOT: case SSOP_LNOT2: case SSOP_NOT: case SSOP_AND:
+            case SSOP_OR: case SSOP_XOR: case SSOP_TEST: case SSOP_TCMP:
+            case SSOP_CMP:
+                valid = REG(a) && REG(b);
+                break;
+
+            case SSOP_STATE:
+                valid = REG(a) && (b.i == 0 || b.i == -1);
+                break;
+
+            case SSOP_MOVS:
+                valid = REG(a) && TEXT(b);
+                break;
+
+            case SSOP_SPEEK: case SSOP_SPOKE: case SSOP_SSWAP:
+                valid = REG(a) && STACK(b);
+                break;
+
+            case SSOP_PUSHN:
+                valid = a.u <= line_count;
+                break;
+
+            case SSOP_POPN:
+                valid = a.u <= frame_size;
+                break;
+
+            case SSOP_JMP: case SSOP_JE: case SSOP_JNE: case SSOP_JG:
+            case SSOP_JGE: case SSOP_JL: case SSOP_JLE:
+                valid = a.u < line_count;
+                break;
+
+            case SSOP_TJE: case SSOP_TJNE:
+                valid = a.u < line_count && REG(b);
+                break;
+
+            case SSOP_CALL: case SSOP_CALLP: /* the object and the b parameters are on the stack */
+                valid = TEXT(a) && b.u <= MAX_PROGRAM_ARITY && b.u + 1 <= frame_size;
+                break;
+
+            case SSOP_GET:
+                valid = TEXT(a) && REG(b);
+                break;
+
+            case SSOP_CAT:
+                valid = TEXT(a);
+                break;
+
+            default: /* quickened or unknown */
+                valid = false;
+                break;
+        }
+
+        if(!valid)
+            return false;
+    }
+
+    return true;
+
+    #undef STACK
+    #undef TEXT
+    #undef REG
+}
+
 /* is this a jump instruction? */
 bool is_jump_instruction(surgescript_program_operator_t instruction)
 {
@@ -744,12 +1634,60 @@ bool is_jump_instruction(surgescript_program_operator_t instruction)
         case SSOP_JGE:
         case SSOP_JL:
         case SSOP_JLE:
+        case SSOP_TJE:
+        case SSOP_TJNE:
             return true;
         default:
             return false;
     }
 }
 
+/* is this an instruction that calls the program named text[a]? */
+bool is_call_instruction(surgescript_program_operator_t instruction)
+{
+    switch(instruction)
+    {
+        case SSOP_CALL:
+        case SSOP_CALLP:
+        case SSOP_GET:
+        case SSOP_CAT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* is line[index] the start of the code of an addition (see compiler/asm.c),
+   i.e., tc01 string; je <concatenate>; add t0, t1; jmp <end>? */
+bool is_addition(const surgescript_program_t* program, unsigned index)
+{
+    const surgescript_program_operation_t* line = program->line;
+
+    return index + 3 < ssarray_length(program->line)
+        && line[index].instruction == SSOP_TC01 && line[index].a.i == surgescript_var_type2code("string")
+        && line[index + 1].instruction == SSOP_JE
+        && (line[index + 2].instruction == SSOP_ADD || line[index + 2].instruction == SSOP_ADDN)
+        && (line[index + 2].a.u & 3) == 0 && (line[index + 2].b.u & 3) == 1
+        && line[index + 3].instruction == SSOP_JMP;
+}
+
+/* the generic version of a (possibly quickened) instruction */
+surgescript_program_operator_t generic_instruction(surgescript_program_operator_t instruction)
+{
+    switch(instruction)
+    {
+        case SSOP_ADDN:  return SSOP_ADD;
+        case SSOP_SUBN:  return SSOP_SUB;
+        case SSOP_MULN:  return SSOP_MUL;
+        case SSOP_DIVN:  return SSOP_DIV;
+        case SSOP_INCN:  return SSOP_INC;
+        case SSOP_DECN:  return SSOP_DEC;
+        case SSOP_CMPN:  return SSOP_CMP;
+        case SSOP_TC01N: return SSOP_TC01;
+        default:         return instruction;
+    }
+}
+
 /* removes all labels from the program, placing the correct line numbers
    on all jump instructions. Returns true if there were any removed labels. */
 bool remove_labels(surgescript_program_t* program)
@@ -774,6 +1712,173 @@ bool remove_labels(surgescript_program_t* program)
         return false;
 }
 
+/* makes the jumps to unconditional jumps go straight to their destination,
+   and turns the jumps to returns into returns. Jumps must refer to lines.
+   Returns true if any jump was changed */
+bool thread_jumps(surgescript_program_t* program)
+{
+    surgescript_program_operation_t* line = program->line;
+    int length = ssarray_length(program->line);
+    bool changed = false;
+
+    for(int i = 0; i < length; i++) {
+        unsigned target = line[i].a.u;
+        int hops = 0;
+
+        if(!is_jump_instruction(line[i].instruction))
+            continue;
+
+        /* follow the chain of jumps, unless it's a loop */
+        while(target < (unsigned)length && line[target].instruction == SSOP_JMP && line[target].a.u != target && hops++ < length)
+            target = line[target].a.u;
+        if(hops <= length && target != line[i].a.u) {
+            line[i].a.u = target;
+            changed = true;
+        }
+
+        /* jmp to ret */
+        if(line[i].instruction == SSOP_JMP && line[i].a.u < (unsigned)length && line[line[i].a.u].instruction == SSOP_RET) {
+            line[i] = line[line[i].a.u];
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+/* removes no-operations and redundant instructions, and fuses common sequences
+   of instructions into superinstructions. Jumps must refer to lines.
+   Returns true if the program was changed */
+bool fuse_lines(surgescript_program_t* program)
+{
+    surgescript_program_operation_t* line = program->line;
+    int length = ssarray_length(program->line);
+    int* new_index = ssmalloc((1 + length) * sizeof(*new_index));
+    bool* is_target = ssmalloc((1 + length) * sizeof(*is_target));
+    int count = 0;
+
+    /* the lines that are jumped into can't be fused with the previous ones */
+    for(int i = 0; i <= length; i++)
+        is_target[i] = false;
+    for(int i = 0; i < length; i++) {
+        if(is_jump_instruction(line[i].instruction) && line[i].a.u <= (unsigned)length)
+            is_target[line[i].a.u] = true;
+    }
+
+    /* rewrite the program in-place: it never grows */
+    for(int i = 0; i < length; ) {
+        surgescript_program_operation_t op;
+        int n = match_lines(line, is_target, length, i, &op);
+
+        if(n == 0) {
+            op = line[i];
+            n = 1;
+        }
+
+        /* a removed line is replaced by the next line that is kept */
+        for(int k = 0; k < n; k++)
+            new_index[i + k] = count;
+        i += n;
+
+        /* keep the breakpoints */
+        if(op.instruction != SSOP_NOP || op.a.i == -1)
+            line[count++] = op;
+    }
+    new_index[length] = count;
+
+    /* fix the jumps */
+    for(int i = 0; i < count; i++) {
+        if(is_jump_instruction(line[i].instruction) && line[i].a.u <= (unsigned)length)
+            line[i].a.u = new_index[line[i].a.u];
+    }
+
+    /* done */
+    ssarray_truncate(program->line, count);
+    ssfree(is_target);
+    ssfree(new_index);
+    return count < length;
+}
+
+/* matches a sequence of instructions starting at line[index], writing its
+   replacement. Returns the length of the sequence, or 0 if there is no match.
+   A nop replacement (other than a breakpoint) removes the sequence */
+int match_lines(const surgescript_program_operation_t* line, const bool* is_target, int length, int index, surgescript_program_operation_t* replacement)
+{
+    #define R(k)        (line[index + (k)].a.u & 3) /* register of operand a */
+    #define S(k)        (line[index + (k)].b.u & 3) /* register of operand b */
+    #define A(k)        (line[index + (k)].a)
+    #define B(k)        (line[index + (k)].b)
+    #define IS(k, op)   (index + (k) < length && line[index + (k)].instruction == (op) && ((k) == 0 || !is_target[index + (k)]))
+    #define REPLACE(n, op, a, b) do { surgescript_program_operation_t r = { (op), (a), (b) }; *replacement = r; return (n); } while(0)
+
+    switch(line[index].instruction) {
+        /* mov x, x */
+        case SSOP_MOV:
+            if(R(0) == S(0))
+                REPLACE(1, SSOP_NOP, SSOPu(0), SSOPu(0));
+            break;
+
+        /* xchg x, x; or xchg x, y; xchg x, y */
+        case SSOP_XCHG:
+            if(R(0) == S(0))
+                REPLACE(1, SSOP_NOP, SSOPu(0), SSOPu(0));
+            else if(IS(1, SSOP_XCHG) && ((R(0) == R(1) && S(0) == S(1)) || (R(0) == S(1) && S(0) == R(1))))
+                REPLACE(2, SSOP_NOP, SSOPu(0), SSOPu(0));
+            break;
+
+        /* a jump to the next line */
+        case SSOP_JMP:
+        case SSOP_JE:
+        case SSOP_JNE:
+        case SSOP_JG:
+        case SSOP_JGE:
+        case SSOP_JL:
+        case SSOP_JLE:
+            if(A(0).u == (unsigned)index + 1)
+                REPLACE(1, SSOP_NOP, SSOPu(0), SSOPu(0));
+            break;
+
+        /* test x, x; je/jne a */
+        case SSOP_TEST:
+            if(R(0) == S(0) && IS(1, SSOP_JE))
+                REPLACE(2, SSOP_TJE, A(1), SSOPu(R(0)));
+            else if(R(0) == S(0) && IS(1, SSOP_JNE))
+                REPLACE(2, SSOP_TJNE, A(1), SSOPu(R(0)));
+            break;
+
+        /* call a, b; popn b+1 */
+        case SSOP_CALL:
+            if(IS(1, SSOP_POPN) && A(1).u == B(0).u + 1)
+                REPLACE(2, SSOP_CALLP, A(0), B(0));
+            break;
+
+        /* push x; call a, 0; popn 1 */
+        case SSOP_PUSH:
+            if(IS(1, SSOP_CALL) && B(1).u == 0 && IS(2, SSOP_POPN) && A(2).u == 1)
+                REPLACE(3, SSOP_GET, A(1), SSOPu(R(0)));
+            break;
+
+        /* movo t2, b; push t2; push t1; push t0; call a, 2; popn 3 */
+        case SSOP_MOVO:
+            if(R(0) == 2 && IS(1, SSOP_PUSH) && R(1) == 2 && IS(2, SSOP_PUSH) && R(2) == 1 && IS(3, SSOP_PUSH) && R(3) == 0
+            && IS(4, SSOP_CALL) && B(4).u == 2 && IS(5, SSOP_POPN) && A(5).u == 3)
+                REPLACE(6, SSOP_CAT, A(4), B(0));
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+
+    #undef REPLACE
+    #undef IS
+    #undef B
+    #undef A
+    #undef S
+    #undef R
+}
+
 /* debug mode */
 #ifdef SURGESCRIPT_DEBUG_MODE
 void debug(surgescript_program_t* program, surgescript_renv_t* runtime_environment, surgescript_program_operator_t instruction, surgescript_program_operand_t a, surgescript_program_operand_t b, surgescript_var_t** _t)
@@ -92,14 +92,30 @@ surgescript_program_label_t surgescript_program_new_label(surgescript_program_t*
 void surgescript_program_add_label(surgescript_program_t* program, surgescript_program_label_t label); /* adds a label to the current line of code in the program */
 int surgescript_program_add_line(surgescript_program_t* program, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b); /* adds a line of code to the program */
 int surgescript_program_chg_line(surgescript_program_t* program, int line, surgescript_program_operator_t op, surgescript_program_operand_t a, surgescript_program_operand_t b); /* changes an existing line of code of the program */
+void surgescript_program_optimize(surgescript_program_t* program); /* peephole optimization; call it after writing the whole program */
+void surgescript_program_freeze(surgescript_program_t* program); /* finalizes the code, which can't be changed afterwards; called when the program is put in a pool */
+
+/* read the code */
+int surgescript_program_line_count(const surgescript_program_t* program); /* how many lines of code are there in the program? */
+bool surgescript_program_get_line(const surgescript_program_t* program, int line, surgescript_program_operator_t* op, surgescript_program_operand_t* a, surgescript_program_operand_t* b); /* reads a line of code; returns false if there is no such line */
+bool surgescript_program_has_label(const surgescript_program_t* program, int line); /* may the code jump to the given line? */
+void surgescript_program_remove_lines(surgescript_program_t* program, int first_line); /* removes the last lines of code, from first_line onwards */
 
 /* program data */
 int surgescript_program_arity(const surgescript_program_t* program); /* what's the arity of this program? (i.e., how many parameters does it take) */
+int surgescript_program_heap_size(const surgescript_program_t* program); /* how many cells of the heap of its object does this program access? */
 const char* surgescript_program_get_text(const surgescript_program_t* program, int index); /* reads a string literal (text[index]) from the program */
 int surgescript_program_add_text(surgescript_program_t* program, const char* text); /* adds a read-only string to the program, returning its index */
 int surgescript_program_find_text(const surgescript_program_t* program, const char* text); /* finds the first index such that text[index] == text, or -1 if not found */
 int surgescript_program_text_count(const surgescript_program_t* program); /* how many string literals exist in the program? */
-void surgescript_program_dump(surgescript_program_t* program, FILE* fp); /* dump the program to a file */
+void surgescript_program_dump(const surgescript_program_t* program, FILE* fp); /* dump the program to a file */
+bool surgescript_program_write(const surgescript_program_t* program, FILE* fp); /* writes the program to a binary stream (precompiled bytecode); returns false if it's native */
+surgescript_program_t* surgescript_program_read(const char** data, const char* end); /* reads a program written by surgescript_program_write() from memory, advancing *data; returns NULL if it is malformed. The program is frozen, and its code is copied once (the memory may be released afterwards) */
 bool surgescript_program_is_native(const surgescript_program_t* program); /* is the program native (i.e., written in C)? */
 
+/* sharing: shareable programs are read-only, so they are no longer quickened nor compiled to machine code (they run slower) */
+surgescript_program_t* surgescript_program_clone(const surgescript_program_t* program); /* creates a frozen copy of a program, without its quickened code and its machine code */
+void surgescript_program_make_shareable(surgescript_program_t* program, struct surgescript_programpool_t* pool); /* makes the program read-only, so that it may be run by VMs on multiple threads */
+bool surgescript_program_is_shareable(const surgescript_program_t* program); /* can the program be run by VMs on multiple threads? */
+
 #endif
\ No newline at end of file
@@ -56,6 +56,7 @@
     F( SSOP_POP, "pop" )                                     /* pop t[a] */ \
     F( SSOP_SPEEK, "speek" )                   /* t[a] = stack[base + b] */ \
     F( SSOP_SPOKE, "spoke" )                   /* stack[base + b] = t[a] */ \
+    F( SSOP_SSWAP, "sswap" )             /* swap(t[a], stack[base + b]) */ \
     F( SSOP_PUSHN, "pushn" )                             /* push a cells */ \
     F( SSOP_POPN, "popn" )                                /* pop a cells */ \
                                                                             \
@@ -93,6 +94,27 @@
                                        /* stack[top-b] and store in t[0] */ \
                                       /* the return value of the program */ \
                                  /* parameters are stacked left-to-right */ \
-    F( SSOP_RET, "ret" )                 /* returns, halting the program */
+    F( SSOP_RET, "ret" )                 /* returns, halting the program */ \
+                                                                            \
+    /* superinstructions: fused by surgescript_program_optimize() */        \
+    F( SSOP_CALLP, "callp" )              /* call text[a] with b params, */ \
+                                                 /* then pop b + 1 cells */ \
+    F( SSOP_GET, "get" )                        /* push t[b]; callp a, 0 */ \
+    F( SSOP_CAT, "cat" )                 /* t[2] = (object)b; push t[2], */ \
+                                               /* t[1], t[0]; callp a, 2 */ \
+    F( SSOP_TJE, "tje" )                            /* t[2] = t[b]; je a */ \
+    F( SSOP_TJNE, "tjne" )                         /* t[2] = t[b]; jne a */ \
+                                                                            \
+    /* numbers only: quickened at runtime, and deoptimized if needed */     \
+    F( SSOP_ADDN, "addn" )                               /* t[a] += t[b] */ \
+    F( SSOP_SUBN, "subn" )                               /* t[a] -= t[b] */ \
+    F( SSOP_MULN, "muln" )                               /* t[a] *= t[b] */ \
+    F( SSOP_DIVN, "divn" )                               /* t[a] /= t[b] */ \
+    F( SSOP_INCN, "incn" )                                     /* t[a]++ */ \
+    F( SSOP_DECN, "decn" )                                     /* t[a]-- */ \
+    F( SSOP_CMPN, "cmpn" )                 /* t[2] = compare(t[a], t[b]) */ \
+    F( SSOP_TC01N, "tc01n" )         /* tc01 a, the start of an addition */ \
+                                         /* (tc01; je; add t0, t1; jmp): */ \
+                                        /* t[0] += t[1]; jump to its end */
 
 #endif
\ No newline at end of file
@@ -27,57 +27,78 @@
 #include "../util/util.h"
 #include "../util/ssarray.h"
 
-#define XXH_INLINE_ALL
-#include "../util/xxhash.h"
-
-#define FASTHASH_INLINE
-#include "../util/fasthash.h"
-
 
 /*
- * Each function in SurgeScript defines a function signature
- * that depends on the containing object and on the function name
+ * Object names and program names are interned, i.e., mapped to
+ * small integer ids. Each object (class) has a dense dispatch table
+ * that maps program ids to programs.
+ *
+ * The contents of a pool may be shared by many pools (possibly used by
+ * VMs running on different threads). Shared contents are read-only:
+ * they're copied the first time a pool that shares them is modified
+ * (copy-on-write). A copy keeps the ids of its source, so that ids
+ * cached by shareable programs remain valid.
+ *
+ * A pool doesn't share its own programs, which keep being quickened and
+ * compiled to machine code. The pools created from it share a shareable
+ * copy of its contents instead, which is made once and reused until the
+ * programs of the pool change.
  */
-typedef uint64_t surgescript_programpool_signature_t;
-static inline surgescript_programpool_signature_t generate_signature(const char* object_name, const char* program_name); /* generates a function signature, given an object name and a program name */
-
-
-/* metadata */
-typedef struct surgescript_programpool_metadata_t surgescript_programpool_metadata_t;
-struct surgescript_programpool_metadata_t /* we'll store the list of program names for each object */
+typedef struct surgescript_programpool_name_t surgescript_programpool_name_t;
+struct surgescript_programpool_name_t /* an interned name */
 {
-    char* object_name;
-    SSARRAY(char*, program_name);
+    char* name; /* key */
+    int id; /* value */
     UT_hash_handle hh;
 };
 
-static void insert_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name);
-static void remove_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name);
-static void remove_object_metadata(surgescript_programpool_t* pool, const char* object_name);
-static void clear_metadata(surgescript_programpool_t* pool);
-static void traverse_metadata(surgescript_programpool_t* pool, const char* object_name, void* data, void (*callback)(const char*,void*));
-static void traverse_adapter(const char* program_name, void* callback);
-
-
-/* program pool hash type */
-typedef struct surgescript_programpool_hashpair_t surgescript_programpool_hashpair_t;
-struct surgescript_programpool_hashpair_t /* for each function signature, store a reference to its program */
+typedef struct surgescript_programpool_class_t surgescript_programpool_class_t;
+struct surgescript_programpool_class_t /* the programs of an object */
 {
-    surgescript_programpool_signature_t signature; /* key */
-    surgescript_program_t* program; /* value */
+    SSARRAY(surgescript_program_t*, table); /* dispatch table: table[id] is the program with that id, or NULL */
+    SSARRAY(bool, owned); /* owned[id] is true if table[id] belongs to the contents of the pool (and not to its source) */
+    SSARRAY(int, program_id); /* ids of the programs of this object, in order of insertion */
 };
 
+typedef struct surgescript_programpool_data_t surgescript_programpool_data_t;
+struct surgescript_programpool_data_t /* the contents of a pool */
+{
+    surgescript_programpool_name_t* object_names; /* object name -> object id */
+    surgescript_programpool_name_t* program_names; /* program name -> program id */
+    SSARRAY(const char*, program_name); /* program_name[id] is the name of the program with that id */
+    SSARRAY(surgescript_programpool_class_t, object); /* object[id] is the class with that id */
+    unsigned generation; /* incremented whenever the set of programs changes */
+    SSARRAY(surgescript_program_t*, retired); /* shareable programs that have been replaced or deleted */
+    surgescript_programpool_data_t* source; /* the contents this was copied from (the owner of the programs not owned by this), or NULL */
+    ssrefcount_t refcount; /* how many pools and copies reference this */
+};
 
 /* program pool */
 struct surgescript_programpool_t
 {
-    fasthash_t* hash; /* a hash table of hashpair_t's */
-    surgescript_programpool_metadata_t* meta;
+    surgescript_programpool_data_t* data; /* possibly shared */
+    surgescript_programpool_data_t* shared; /* a shareable copy of data given to other pools, or NULL */
+    unsigned shared_generation; /* the generation of data when the shareable copy was made */
 };
 
-/* misc */
-static void delete_pair(void* pair);
-static void delete_program(const char* program_name, void* data);
+/* the programs of "Object" are available to all objects */
+#define BASE_OBJECT_ID 0
+
+/* private stuff */
+static surgescript_programpool_data_t* create_data();
+static surgescript_programpool_data_t* copy_data(surgescript_programpool_data_t* data);
+static surgescript_programpool_data_t* shareable_copy(surgescript_programpool_data_t* data);
+static surgescript_programpool_data_t* release_data(surgescript_programpool_data_t* data);
+static inline surgescript_programpool_data_t* writable_data(surgescript_programpool_t* pool);
+static int find_id(surgescript_programpool_name_t* names, const char* name);
+static int intern(surgescript_programpool_name_t** names, const char* name, int new_id);
+static inline surgescript_program_t* lookup(const surgescript_programpool_data_t* data, int object_id, int program_id);
+static void set_program(surgescript_programpool_data_t* data, int object_id, int program_id, surgescript_program_t* program);
+static void unset_program(surgescript_programpool_data_t* data, int object_id, int program_id);
+static void remove_program(surgescript_programpool_data_t* data, int object_id, int program_id);
+static void clear_names(surgescript_programpool_name_t** names);
+static int add_object(surgescript_programpool_data_t* data, const char* object_name);
+static int add_program_name(surgescript_programpool_data_t* data, const char* program_name);
 
 
 
@@ -93,8 +114,42 @@ static void delete_program(const char* program_name, void* data);
 surgescript_programpool_t* surgescript_programpool_create()
 {
     surgescript_programpool_t* pool = ssmalloc(sizeof *pool);
-    pool->hash = fasthash_create(delete_pair, 16);
-    pool->meta = NULL;
+    pool->data = create_data();
+    pool->shared = NULL;
+    pool->shared_generation = 0;
+    return pool;
+}
+
+/*
+ * surgescript_programpool_create_shared()
+ * Creates a program pool that shares the programs of another pool. The shared
+ * programs are compiled only once and may be run by VMs on different threads.
+ * Modifying either pool later on will not affect the other (copy-on-write).
+ * The source pool must not be in use by another thread during this call.
+ *
+ * The new pool gets shareable copies of the programs of the source, which
+ * it runs without quickening and without compiling them to machine code
+ * (see surgescript_program_make_shareable() for the trade-off). The programs
+ * of the source are not changed. The copies are made only once for all the
+ * pools that share the same source, unless its programs change in between
+ */
+surgescript_programpool_t* surgescript_programpool_create_shared(surgescript_programpool_t* source)
+{
+    surgescript_programpool_t* pool = ssmalloc(sizeof *pool);
+
+    /* make a shareable copy of the programs of the source, if there isn't an up-to-date one */
+    if(source->shared == NULL || source->shared_generation != source->data->generation) {
+        if(source->shared != NULL)
+            release_data(source->shared);
+        source->shared = shareable_copy(source->data);
+        source->shared_generation = source->data->generation;
+    }
+
+    /* share the copy */
+    ssrefcount_inc(source->shared->refcount);
+    pool->data = source->shared;
+    pool->shared = NULL;
+    pool->shared_generation = 0;
     return pool;
 }
 
@@ -104,8 +159,9 @@ surgescript_programpool_t* surgescript_programpool_create()
  */
 surgescript_programpool_t* surgescript_programpool_destroy(surgescript_programpool_t* pool)
 {
-    fasthash_destroy(pool->hash);
-    clear_metadata(pool);
+    if(pool->shared != NULL)
+        release_data(pool->shared);
+    release_data(pool->data);
     return ssfree(pool);
 }
 
@@ -124,9 +180,9 @@ bool surgescript_programpool_exists(surgescript_programpool_t* pool, const char*
  */
 bool surgescript_programpool_shallowcheck(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
 {
-    surgescript_programpool_signature_t signature = generate_signature(object_name, program_name);
-    surgescript_programpool_hashpair_t* pair = fasthash_get(pool->hash, signature);
-    return pair != NULL;
+    int object_id = find_id(pool->data->object_names, object_name);
+    int program_id = find_id(pool->data->program_names, program_name);
+    return object_id >= 0 && program_id >= 0 && lookup(pool->data, object_id, program_id) != NULL;
 }
 
 /*
@@ -136,11 +192,13 @@ bool surgescript_programpool_shallowcheck(surgescript_programpool_t* pool, const
 bool surgescript_programpool_put(surgescript_programpool_t* pool, const char* object_name, const char* program_name, surgescript_program_t* program)
 {
     if(!surgescript_programpool_shallowcheck(pool, object_name, program_name)) {
-        surgescript_programpool_hashpair_t* pair = ssmalloc(sizeof *pair);
-        pair->signature = generate_signature(object_name, program_name);
-        pair->program = program;
-        fasthash_put(pool->hash, pair->signature, pair);
-        insert_metadata(pool, object_name, program_name);
+        surgescript_programpool_data_t* data = writable_data(pool);
+        int object_id = add_object(data, object_name);
+        int program_id = add_program_name(data, program_name);
+        surgescript_program_freeze(program);
+        set_program(data, object_id, program_id, program);
+        ssarray_push(data->object[object_id].program_id, program_id);
+        data->generation++;
         return true;
     }
     else {
@@ -153,26 +211,63 @@ bool surgescript_programpool_put(surgescript_programpool_t* pool, const char* ob
 /*
  * surgescript_programpool_get()
  * Gets a program from the pool (returns NULL if not found)
- * This needs to be fast!
  */
 surgescript_program_t* surgescript_programpool_get(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
 {
-    surgescript_programpool_signature_t signature = generate_signature(object_name, program_name);
-    surgescript_programpool_hashpair_t* pair = fasthash_get(pool->hash, signature); /* find the program */
-    
-    /* if there is no such program */
-    if(!pair) {
-        /* try locating it in a common base for all objects */
-        signature = generate_signature("Object", program_name);
-        pair = fasthash_get(pool->hash, signature);
-
-        /* really, the program doesn't exist */
-        if(!pair)
-            return NULL;
-    }
+    int program_id = find_id(pool->data->program_names, program_name);
+
+    /* no program has such a name */
+    if(program_id < 0)
+        return NULL;
+
+    /* look in object_name and in the common base for all objects */
+    return surgescript_programpool_get_by_id(pool, find_id(pool->data->object_names, object_name), program_id);
+}
+
+/*
+ * surgescript_programpool_get_by_id()
+ * Gets a program from the pool given the ids of the object and of the program
+ * (returns NULL if not found). This needs to be fast!
+ */
+surgescript_program_t* surgescript_programpool_get_by_id(const surgescript_programpool_t* pool, int object_id, int program_id)
+{
+    surgescript_program_t* program = lookup(pool->data, object_id, program_id);
+
+    /* if there is no such program, try locating it in a common base for all objects */
+    if(program == NULL)
+        program = lookup(pool->data, BASE_OBJECT_ID, program_id);
+
+    return program;
+}
+
+/*
+ * surgescript_programpool_object_id()
+ * Interns object_name, returning its id
+ */
+int surgescript_programpool_object_id(surgescript_programpool_t* pool, const char* object_name)
+{
+    int object_id = find_id(pool->data->object_names, object_name);
+
+    /* don't modify the pool unless necessary, as its contents may be shared */
+    if(object_id < 0)
+        object_id = add_object(writable_data(pool), object_name);
+
+    return object_id;
+}
 
-    /* found it! */
-    return pair->program;
+/*
+ * surgescript_programpool_program_id()
+ * Interns program_name, returning its id
+ */
+int surgescript_programpool_program_id(surgescript_programpool_t* pool, const char* program_name)
+{
+    int program_id = find_id(pool->data->program_names, program_name);
+
+    /* don't modify the pool unless necessary, as its contents may be shared */
+    if(program_id < 0)
+        program_id = add_program_name(writable_data(pool), program_name);
+
+    return program_id;
 }
 
 /*
@@ -181,7 +276,13 @@ surgescript_program_t* surgescript_programpool_get(surgescript_programpool_t* po
  */
 void surgescript_programpool_foreach(surgescript_programpool_t* pool, const char* object_name, void (*callback)(const char*))
 {
-    traverse_metadata(pool, object_name, callback, traverse_adapter);
+    surgescript_programpool_data_t* data = pool->data;
+    int object_id = find_id(data->object_names, object_name);
+
+    if(object_id >= 0) {
+        for(int i = 0; i < ssarray_length(data->object[object_id].program_id); i++)
+            callback(data->program_name[data->object[object_id].program_id[i]]);
+    }
 }
 
 /*
@@ -190,7 +291,35 @@ void surgescript_programpool_foreach(surgescript_programpool_t* pool, const char
  */
 void surgescript_programpool_foreach_ex(surgescript_programpool_t* pool, const char* object_name, void* data, void (*callback)(const char*, void*))
 {
-    traverse_metadata(pool, object_name, data, callback);
+    surgescript_programpool_data_t* contents = pool->data;
+    int object_id = find_id(contents->object_names, object_name);
+
+    if(object_id >= 0) {
+        for(int i = 0; i < ssarray_length(contents->object[object_id].program_id); i++)
+            callback(contents->program_name[contents->object[object_id].program_id[i]], data);
+    }
+}
+
+/*
+ * surgescript_programpool_foreach_object()
+ * For each object that has programs, calls the callback (in order of creation)
+ */
+void surgescript_programpool_foreach_object(surgescript_programpool_t* pool, void* data, void (*callback)(const char*, void*))
+{
+    surgescript_programpool_data_t* contents = pool->data;
+    surgescript_programpool_name_t *it, *tmp;
+    const char** object_name = ssmalloc(ssarray_length(contents->object) * sizeof(*object_name));
+
+    /* map the ids to the names */
+    HASH_ITER(hh, contents->object_names, it, tmp)
+        object_name[it->id] = it->name;
+
+    for(int i = 0; i < ssarray_length(contents->object); i++) {
+        if(ssarray_length(contents->object[i].program_id) > 0)
+            callback(object_name[i], data);
+    }
+
+    ssfree(object_name);
 }
 
 
@@ -201,13 +330,16 @@ void surgescript_programpool_foreach_ex(surgescript_programpool_t* pool, const c
  */
 bool surgescript_programpool_replace(surgescript_programpool_t* pool, const char* object_name, const char* program_name, surgescript_program_t* program)
 {
-    surgescript_programpool_signature_t signature = generate_signature(object_name, program_name);
-    surgescript_programpool_hashpair_t* pair = fasthash_get(pool->hash, signature); /* find the program */
-    
-    /* replace the program */
-    if(pair != NULL) {
-        surgescript_program_destroy(pair->program);
-        pair->program = program;
+    if(surgescript_programpool_shallowcheck(pool, object_name, program_name)) {
+        surgescript_programpool_data_t* data = writable_data(pool);
+        int object_id = find_id(data->object_names, object_name);
+        int program_id = find_id(data->program_names, program_name);
+
+        /* replace the program */
+        surgescript_program_freeze(program);
+        unset_program(data, object_id, program_id);
+        set_program(data, object_id, program_id, program);
+        data->generation++;
         return true;
     }
     else
@@ -221,9 +353,17 @@ bool surgescript_programpool_replace(surgescript_programpool_t* pool, const char
  */
 void surgescript_programpool_purge(surgescript_programpool_t* pool, const char* object_name)
 {
-    void* data[] = { pool, (void*)object_name };
-    surgescript_programpool_foreach_ex(pool, object_name, data, delete_program);
-    remove_object_metadata(pool, object_name);
+    if(surgescript_programpool_is_compiled(pool, object_name)) {
+        surgescript_programpool_data_t* data = writable_data(pool);
+        int object_id = find_id(data->object_names, object_name);
+        surgescript_programpool_class_t* c = &(data->object[object_id]);
+
+        for(int i = 0; i < ssarray_length(c->program_id); i++)
+            unset_program(data, object_id, c->program_id[i]);
+        ssarray_reset(c->program_id);
+
+        data->generation++;
+    }
 }
 
 
@@ -233,26 +373,74 @@ void surgescript_programpool_purge(surgescript_programpool_t* pool, const char*
  */
 void surgescript_programpool_delete(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
 {
-    surgescript_programpool_signature_t signature = generate_signature(object_name, program_name);
-    
-    /* delete the program */
-    fasthash_delete(pool->hash, signature);
+    if(surgescript_programpool_shallowcheck(pool, object_name, program_name)) {
+        surgescript_programpool_data_t* data = writable_data(pool);
+        int object_id = find_id(data->object_names, object_name);
+        int program_id = find_id(data->program_names, program_name);
 
-    /* delete metadata */
-    remove_metadata(pool, object_name, program_name);
+        /* delete the program */
+        remove_program(data, object_id, program_id);
+        data->generation++;
+    }
 }
 
 
 
+/*
+ * surgescript_programpool_move()
+ * Moves the programs of an object from the source pool to this pool, in the
+ * order they were added. The source must own its programs (i.e., it must not
+ * share them with other pools), and the object must not have any programs in
+ * this pool
+ */
+void surgescript_programpool_move(surgescript_programpool_t* pool, surgescript_programpool_t* source, const char* object_name)
+{
+    if(surgescript_programpool_is_compiled(source, object_name)) {
+        surgescript_programpool_data_t* data = writable_data(source);
+        int object_id = find_id(data->object_names, object_name);
+        surgescript_programpool_class_t* c = &(data->object[object_id]);
+
+        for(int i = 0; i < ssarray_length(c->program_id); i++) {
+            int program_id = c->program_id[i];
+            ssassert(c->owned[program_id]);
+            surgescript_programpool_put(pool, object_name, data->program_name[program_id], c->table[program_id]);
+            c->table[program_id] = NULL;
+            c->owned[program_id] = false;
+        }
+        ssarray_reset(c->program_id);
+
+        data->generation++;
+    }
+}
+
 /*
  * surgescript_programpool_is_compiled()
  * Is there any code for object_name?
  */
 bool surgescript_programpool_is_compiled(surgescript_programpool_t* pool, const char* object_name)
 {
-    surgescript_programpool_metadata_t *m = NULL;
-    HASH_FIND_STR(pool->meta, object_name, m);
-    return (m != NULL) && (ssarray_length(m->program_name) > 0);
+    int object_id = find_id(pool->data->object_names, object_name);
+    return (object_id >= 0) && (ssarray_length(pool->data->object[object_id].program_id) > 0);
+}
+
+
+/*
+ * surgescript_programpool_generation()
+ * A number that changes whenever programs are added, replaced or removed.
+ * Useful to invalidate caches of programs obtained from the pool
+ */
+unsigned surgescript_programpool_generation(const surgescript_programpool_t* pool)
+{
+    return pool->data->generation;
+}
+
+/*
+ * surgescript_programpool_is_shared()
+ * Are the contents of this pool currently shared with other pools?
+ */
+bool surgescript_programpool_is_shared(const surgescript_programpool_t* pool)
+{
+    return ssrefcount_get(pool->data->refcount) > 1;
 }
 
 
@@ -261,124 +449,282 @@ bool surgescript_programpool_is_compiled(surgescript_programpool_t* pool, const
  * private methods
  * ------------------------------- */
 
+/* creates empty contents */
+surgescript_programpool_data_t* create_data()
+{
+    surgescript_programpool_data_t* data = ssmalloc(sizeof *data);
+
+    data->object_names = NULL;
+    data->program_names = NULL;
+    ssarray_init(data->program_name);
+    ssarray_init(data->object);
+    ssarray_init(data->retired);
+    data->generation = 0;
+    data->source = NULL;
+    ssrefcount_init(data->refcount, 1);
+
+    /* "Object" gets BASE_OBJECT_ID */
+    add_object(data, "Object");
+    return data;
+}
 
- /* metadata */
-void insert_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
+/* copies the (shared) contents of a pool, preserving the ids. The programs are not copied */
+surgescript_programpool_data_t* copy_data(surgescript_programpool_data_t* data)
 {
-    surgescript_programpool_metadata_t *m = NULL;
-    HASH_FIND(hh, pool->meta, object_name, strlen(object_name), m);
+    surgescript_programpool_data_t* copy = ssmalloc(sizeof *copy);
+    surgescript_programpool_name_t *it, *tmp;
+
+    /* the programs are owned by the source */
+    ssrefcount_inc(data->refcount);
+    copy->source = data;
+    ssrefcount_init(copy->refcount, 1);
+    ssarray_init(copy->retired);
+    copy->generation = data->generation + 1;
+
+    /* copy the names */
+    copy->object_names = NULL;
+    HASH_ITER(hh, data->object_names, it, tmp)
+        intern(&(copy->object_names), it->name, it->id);
+
+    copy->program_names = NULL;
+    ssarray_init(copy->program_name);
+    for(int i = 0; i < ssarray_length(data->program_name); i++)
+        ssarray_push(copy->program_name, NULL);
+    HASH_ITER(hh, data->program_names, it, tmp) {
+        surgescript_programpool_name_t* entry = NULL;
+        intern(&(copy->program_names), it->name, it->id);
+        HASH_FIND_STR(copy->program_names, it->name, entry);
+        copy->program_name[it->id] = entry->name;
+    }
 
-    /* create the hash entry if it doesn't exist yet */
-    if(m == NULL) {
-        m = ssmalloc(sizeof *m);
-        m->object_name = ssstrdup(object_name);
-        ssarray_init(m->program_name);
-        HASH_ADD_KEYPTR(hh, pool->meta, m->object_name, strlen(m->object_name), m);
+    /* copy the dispatch tables */
+    ssarray_init(copy->object);
+    for(int i = 0; i < ssarray_length(data->object); i++) {
+        const surgescript_programpool_class_t* c = &(data->object[i]);
+        surgescript_programpool_class_t d;
+
+        ssarray_init(d.table);
+        ssarray_init(d.owned);
+        ssarray_init(d.program_id);
+        for(int j = 0; j < ssarray_length(c->table); j++) {
+            ssarray_push(d.table, c->table[j]);
+            ssarray_push(d.owned, false);
+        }
+        for(int j = 0; j < ssarray_length(c->program_id); j++)
+            ssarray_push(d.program_id, c->program_id[j]);
+
+        ssarray_push(copy->object, d);
     }
 
-    /* no need to check for key uniqueness (it's checked before) */
-    ssarray_push(m->program_name, ssstrdup(program_name));
+    return copy;
 }
 
-void remove_metadata(surgescript_programpool_t* pool, const char* object_name, const char* program_name)
+/* copies the contents of a pool, preserving the ids. The copy owns copies of the programs, which are made shareable */
+surgescript_programpool_data_t* shareable_copy(surgescript_programpool_data_t* data)
 {
-    surgescript_programpool_metadata_t *m = NULL;
-    HASH_FIND(hh, pool->meta, object_name, strlen(object_name), m);
+    surgescript_programpool_data_t* copy = copy_data(data);
+    surgescript_programpool_t pool = { .data = copy, .shared = NULL, .shared_generation = 0 };
+
+    /* copy the programs */
+    for(int i = 0; i < ssarray_length(copy->object); i++) {
+        surgescript_programpool_class_t* c = &(copy->object[i]);
+        for(int j = 0; j < ssarray_length(c->program_id); j++) {
+            int program_id = c->program_id[j];
+            c->table[program_id] = surgescript_program_clone(c->table[program_id]);
+            c->owned[program_id] = true;
+        }
+    }
 
-    if(m != NULL) {
-        int index = -1;
+    /* the copy no longer depends on data */
+    release_data(copy->source);
+    copy->source = NULL;
 
-        /* find the program */
-        for(int i = 0; i < ssarray_length(m->program_name) && index < 0; i++) {
-            if(strcmp(m->program_name[i], program_name) == 0)
-                index = i;
-        }
+    /* make the programs shareable, resolving their calls with the ids of the copy */
+    for(int i = 0; i < ssarray_length(copy->object); i++) {
+        surgescript_programpool_class_t* c = &(copy->object[i]);
+        for(int j = 0; j < ssarray_length(c->program_id); j++)
+            surgescript_program_make_shareable(c->table[c->program_id[j]], &pool);
+    }
 
-        /* delete the program */
-        if(index >= 0) {
-            ssfree(m->program_name[index]);
-            ssarray_remove(m->program_name, index);
+    return copy;
+}
+
+/* releases the contents of a pool, destroying them if they're no longer referenced */
+surgescript_programpool_data_t* release_data(surgescript_programpool_data_t* data)
+{
+    if(ssrefcount_dec(data->refcount) > 0)
+        return NULL;
+
+    /* destroy the programs owned by data */
+    for(int i = 0; i < ssarray_length(data->object); i++) {
+        surgescript_programpool_class_t* c = &(data->object[i]);
+        for(int j = 0; j < ssarray_length(c->program_id); j++) {
+            int program_id = c->program_id[j];
+            if(c->owned[program_id])
+                surgescript_program_destroy(c->table[program_id]);
         }
+        ssarray_release(c->program_id);
+        ssarray_release(c->owned);
+        ssarray_release(c->table);
     }
+
+    for(int i = 0; i < ssarray_length(data->retired); i++)
+        surgescript_program_destroy(data->retired[i]);
+
+    /* release the source */
+    if(data->source != NULL)
+        release_data(data->source);
+
+    /* release the rest */
+    ssarray_release(data->retired);
+    ssarray_release(data->object);
+    ssarray_release(data->program_name);
+    clear_names(&(data->program_names));
+    clear_names(&(data->object_names));
+    return ssfree(data);
 }
 
-void remove_object_metadata(surgescript_programpool_t* pool, const char* object_name)
+/* the contents of the pool, ready to be modified (copy-on-write) */
+surgescript_programpool_data_t* writable_data(surgescript_programpool_t* pool)
 {
-    surgescript_programpool_metadata_t *m = NULL;
-    HASH_FIND(hh, pool->meta, object_name, strlen(object_name), m);
-
-    /* delete all programs of object_name */
-    if(m != NULL) {
-        HASH_DEL(pool->meta, m);
-        for(int i = 0; i < ssarray_length(m->program_name); i++)
-            ssfree(m->program_name[i]);
-        ssarray_release(m->program_name);
-        ssfree(m->object_name);
-        ssfree(m);
+    if(ssrefcount_get(pool->data->refcount) > 1) {
+        surgescript_programpool_data_t* copy = copy_data(pool->data);
+        release_data(pool->data);
+        pool->data = copy;
     }
+
+    return pool->data;
 }
 
-void clear_metadata(surgescript_programpool_t* pool)
+/* the id of an interned name, or -1 if the name hasn't been interned */
+int find_id(surgescript_programpool_name_t* names, const char* name)
 {
-    surgescript_programpool_metadata_t *it, *tmp;
+    surgescript_programpool_name_t* entry = NULL;
+    HASH_FIND_STR(names, name, entry);
+    return entry != NULL ? entry->id : -1;
+}
 
-    /* delete all programs of all objects */
-    HASH_ITER(hh, pool->meta, it, tmp) {
-        HASH_DEL(pool->meta, it);
-        for(int i = 0; i < ssarray_length(it->program_name); i++)
-            ssfree(it->program_name[i]);
-        ssarray_release(it->program_name);
-        ssfree(it->object_name);
-        ssfree(it);
+/* interns a name, assigning new_id to it if it hasn't been interned yet */
+int intern(surgescript_programpool_name_t** names, const char* name, int new_id)
+{
+    surgescript_programpool_name_t* entry = NULL;
+    HASH_FIND_STR(*names, name, entry);
+
+    /* create the hash entry if it doesn't exist yet */
+    if(entry == NULL) {
+        entry = ssmalloc(sizeof *entry);
+        entry->name = ssstrdup(name);
+        entry->id = new_id;
+        HASH_ADD_KEYPTR(hh, *names, entry->name, strlen(entry->name), entry);
     }
+
+    return entry->id;
 }
 
-void traverse_metadata(surgescript_programpool_t* pool, const char* object_name, void* data, void (*callback)(const char*,void*))
+/* deletes all interned names */
+void clear_names(surgescript_programpool_name_t** names)
 {
-    surgescript_programpool_metadata_t *m = NULL;
-    HASH_FIND_STR(pool->meta, object_name, m);
+    surgescript_programpool_name_t *it, *tmp;
 
-    if(m != NULL) {
-        for(int i = 0; i < ssarray_length(m->program_name); i++)
-            callback(m->program_name[i], data);
+    HASH_ITER(hh, *names, it, tmp) {
+        HASH_DEL(*names, it);
+        ssfree(it->name);
+        ssfree(it);
     }
 }
 
-void traverse_adapter(const char* program_name, void* callback)
+/* interns an object name, creating an empty class if necessary */
+int add_object(surgescript_programpool_data_t* data, const char* object_name)
 {
-    ((void (*)(const char*))callback)(program_name);
+    int object_id = intern(&(data->object_names), object_name, ssarray_length(data->object));
+
+    /* a new object */
+    if(object_id == ssarray_length(data->object)) {
+        surgescript_programpool_class_t c;
+        ssarray_init(c.table);
+        ssarray_init(c.owned);
+        ssarray_init(c.program_id);
+        ssarray_push(data->object, c);
+    }
+
+    return object_id;
 }
 
+/* interns a program name */
+int add_program_name(surgescript_programpool_data_t* data, const char* program_name)
+{
+    int program_id = intern(&(data->program_names), program_name, ssarray_length(data->program_name));
+
+    /* a new program name */
+    if(program_id == ssarray_length(data->program_name)) {
+        surgescript_programpool_name_t* entry = NULL;
+        HASH_FIND_STR(data->program_names, program_name, entry);
+        ssarray_push(data->program_name, entry->name);
+    }
+
+    return program_id;
+}
 
-/* utilities */
-void delete_pair(void* pair)
+/* the program of EXACTLY the specified object, or NULL */
+surgescript_program_t* lookup(const surgescript_programpool_data_t* data, int object_id, int program_id)
 {
-    surgescript_programpool_hashpair_t* p = (surgescript_programpool_hashpair_t*)pair;
-    surgescript_program_destroy(p->program);
-    ssfree(p);
+    if(object_id >= 0 && object_id < ssarray_length(data->object)) {
+        const surgescript_programpool_class_t* c = &(data->object[object_id]);
+        if(program_id >= 0 && program_id < ssarray_length(c->table))
+            return c->table[program_id];
+    }
+
+    return NULL;
 }
 
-void delete_program(const char* program_name, void* data)
+/* writes a (new) program to the dispatch table of an object */
+void set_program(surgescript_programpool_data_t* data, int object_id, int program_id, surgescript_program_t* program)
 {
-    surgescript_programpool_t* pool = (surgescript_programpool_t*)(((void**)data)[0]);
-    const char* object_name = (const char*)(((void**)data)[1]);
-    surgescript_programpool_signature_t signature = generate_signature(object_name, program_name);
+    surgescript_programpool_class_t* c = &(data->object[object_id]);
+
+    /* grow the dispatch table */
+    while(ssarray_length(c->table) <= program_id) {
+        ssarray_push(c->table, NULL);
+        ssarray_push(c->owned, false);
+    }
 
-    /* delete the program */
-    fasthash_delete(pool->hash, signature);
+    c->table[program_id] = program;
+    c->owned[program_id] = true;
 }
 
+/* clears an entry of the dispatch table of an object, disposing of its program */
+void unset_program(surgescript_programpool_data_t* data, int object_id, int program_id)
+{
+    surgescript_programpool_class_t* c = &(data->object[object_id]);
+    surgescript_program_t* program = c->table[program_id];
+
+    /* shareable programs may have handed out immortal strings to
+       the variables of the VM; keep them until the end */
+    if(c->owned[program_id]) {
+        if(surgescript_program_is_shareable(program))
+            ssarray_push(data->retired, program);
+        else
+            surgescript_program_destroy(program);
+    }
+
+    c->table[program_id] = NULL;
+    c->owned[program_id] = false;
+}
 
-/* program signature generator: must be extremely fast */
-surgescript_programpool_signature_t generate_signature(const char* object_name, const char* program_name)
+/* removes a program of an object */
+void remove_program(surgescript_programpool_data_t* data, int object_id, int program_id)
 {
-    /* Our app must enforce signature uniqueness */
-    char buf[2 * SS_NAMEMAX + 2] = { 0 };
-    uint32_t ha = 0, hb = 0;
-    size_t l1 = strlen(object_name), l2 = strlen(program_name);
-    memcpy(buf, object_name, l1);
-    memcpy(buf + l1 + 1, program_name, l2);
-    ha = XXH32(buf, l1 + 1, l1) + (uint8_t)program_name[0];
-    hb = XXH32(buf, l1 + l2 + 1, ha + (uint8_t)object_name[0]);
-    return (uint64_t)hb | (((uint64_t)ha) << 32); /* probably unique */
-}
\ No newline at end of file
+    surgescript_programpool_class_t* c = &(data->object[object_id]);
+
+    if(lookup(data, object_id, program_id) != NULL) {
+        unset_program(data, object_id, program_id);
+
+        /* keep the order of insertion */
+        for(int i = 0; i < ssarray_length(c->program_id); i++) {
+            if(c->program_id[i] == program_id) {
+                ssarray_remove(c->program_id, i);
+                break;
+            }
+        }
+    }
+}
@@ -32,16 +32,24 @@ struct surgescript_program_t;
 
 /* public methods */
 surgescript_programpool_t* surgescript_programpool_create();
+surgescript_programpool_t* surgescript_programpool_create_shared(surgescript_programpool_t* source); /* creates a pool that shares a copy of the programs of source (copy-on-write); the shared copy runs slower, but source keeps its own programs (see surgescript_program_make_shareable()) */
 surgescript_programpool_t* surgescript_programpool_destroy(surgescript_programpool_t* pool);
 bool surgescript_programpool_put(surgescript_programpool_t* pool, const char* object_name, const char* program_name, struct surgescript_program_t* program); /* adds a program to an object */
 struct surgescript_program_t* surgescript_programpool_get(surgescript_programpool_t* pool, const char* object_name, const char* program_name); /* may return NULL */
+struct surgescript_program_t* surgescript_programpool_get_by_id(const surgescript_programpool_t* pool, int object_id, int program_id); /* fast lookup; may return NULL */
+int surgescript_programpool_object_id(surgescript_programpool_t* pool, const char* object_name); /* interns object_name, returning its id */
+int surgescript_programpool_program_id(surgescript_programpool_t* pool, const char* program_name); /* interns program_name, returning its id */
 bool surgescript_programpool_exists(surgescript_programpool_t* pool, const char* object_name, const char* program_name); /* program exists? */
 bool surgescript_programpool_shallowcheck(surgescript_programpool_t* pool, const char* object_name, const char* program_name); /* program exists? (shallow check) */
 void surgescript_programpool_foreach(surgescript_programpool_t* pool, const char* object_name, void (*callback)(const char*)); /* for each program of object_name... */
+void surgescript_programpool_foreach_object(surgescript_programpool_t* pool, void* data, void (*callback)(const char*, void*)); /* for each object that has programs... */
 void surgescript_programpool_foreach_ex(surgescript_programpool_t* pool, const char* object_name, void* data, void (*callback)(const char*, void*)); /* same as above with an added data parameter */
 bool surgescript_programpool_replace(surgescript_programpool_t* pool, const char* object_name, const char* program_name, struct surgescript_program_t* program); /* replaces a program */
 void surgescript_programpool_delete(surgescript_programpool_t* pool, const char* object_name, const char* program_name); /* deletes a programs from the specified object */
+void surgescript_programpool_move(surgescript_programpool_t* pool, surgescript_programpool_t* source, const char* object_name); /* moves the programs of object_name from the source pool to this pool */
 void surgescript_programpool_purge(surgescript_programpool_t* pool, const char* object_name); /* deletes all programs from the specified object */
 bool surgescript_programpool_is_compiled(surgescript_programpool_t* pool, const char* object_name); /* is there any code for object_name? */
+unsigned surgescript_programpool_generation(const surgescript_programpool_t* pool); /* changes whenever the programs of the pool change */
+bool surgescript_programpool_is_shared(const surgescript_programpool_t* pool); /* are the contents of the pool shared with other pools? */
 
 #endif
@@ -28,8 +28,7 @@
 #include "object_manager.h"
 #include "../util/util.h"
 
-/* how many temporary vars does a runtime environment have? */
-static const int MAX_TMPVARS = 4; /* used for calculations */
+/* private stuff */
 static surgescript_renv_t* full_destructor(surgescript_renv_t* runtime_environment);
 static surgescript_renv_t* partial_destructor(surgescript_renv_t* runtime_environment);
 
@@ -51,8 +50,8 @@ surgescript_renv_t* surgescript_renv_create(surgescript_object_t* owner, surgesc
 
     if(!tmp) {
         int i;
-        runtime_environment->tmp = ssmalloc(MAX_TMPVARS * sizeof *(runtime_environment->tmp));
-        for(i = 0; i < MAX_TMPVARS; i++)
+        runtime_environment->tmp = ssmalloc(SURGESCRIPT_RENV_MAX_TMPVARS * sizeof *(runtime_environment->tmp));
+        for(i = 0; i < SURGESCRIPT_RENV_MAX_TMPVARS; i++)
             runtime_environment->tmp[i] = surgescript_var_create();
         runtime_environment->_destructor = full_destructor;
     }
@@ -71,15 +70,49 @@ surgescript_renv_t* surgescript_renv_create(surgescript_object_t* owner, surgesc
  */
 surgescript_renv_t* surgescript_renv_destroy(surgescript_renv_t* runtime_environment)
 {
+    if(runtime_environment->_destructor == NULL)
+        ssfatal("Can't destroy a runtime environment initialized with surgescript_renv_init()");
+
     return runtime_environment->_destructor(runtime_environment);
 }
 
+/*
+ * surgescript_renv_init()
+ * Initializes a runtime environment stored in memory owned by the caller.
+ * Its temporary variables, tmp[0 .. SURGESCRIPT_RENV_MAX_TMPVARS - 1],
+ * are owned by the caller as well, but are used by this renv only
+ */
+surgescript_renv_t* surgescript_renv_init(surgescript_renv_t* runtime_environment, surgescript_object_t* owner, surgescript_stack_t* stack, surgescript_heap_t* heap, surgescript_programpool_t* program_pool, surgescript_objectmanager_t* object_manager, surgescript_var_t** tmp)
+{
+    runtime_environment->owner = owner;
+    runtime_environment->stack = stack;
+    runtime_environment->heap = heap;
+    runtime_environment->program_pool = program_pool;
+    runtime_environment->object_manager = object_manager;
+    runtime_environment->caller = surgescript_objectmanager_null(object_manager);
+    runtime_environment->tmp = tmp;
+    runtime_environment->_destructor = NULL; /* see surgescript_renv_release() */
+
+    return runtime_environment;
+}
+
+/*
+ * surgescript_renv_release()
+ * Releases a runtime environment initialized with surgescript_renv_init(),
+ * setting its temporary variables to null. No memory is deallocated
+ */
+void surgescript_renv_release(surgescript_renv_t* runtime_environment)
+{
+    for(int i = 0; i < SURGESCRIPT_RENV_MAX_TMPVARS; i++)
+        surgescript_var_set_null(runtime_environment->tmp[i]);
+}
+
 
 /* privates */
 
 surgescript_renv_t* full_destructor(surgescript_renv_t* runtime_environment)
 {
-    for(int i = 0; i < MAX_TMPVARS; i++)
+    for(int i = 0; i < SURGESCRIPT_RENV_MAX_TMPVARS; i++)
         surgescript_var_destroy(runtime_environment->tmp[i]);
     ssfree(runtime_environment->tmp);
     return ssfree(runtime_environment);
@@ -29,6 +29,9 @@ struct surgescript_heap_t;
 struct surgescript_programpool_t;
 struct surgescript_objectmanager_t;
 
+/* how many temporary variables does a runtime environment have? */
+#define SURGESCRIPT_RENV_MAX_TMPVARS 4
+
 /* a program, to be run, needs a runtime environment (renv) */
 /* this is composed by an owner object, plus heap-stack-etc, plus some unique temporary variables */
 /* --- instead of messing with this directly, use the functions below --- */
@@ -50,6 +53,12 @@ surgescript_renv_t* surgescript_renv_create(struct surgescript_object_t* owner,
 /* destroys a renv */
 surgescript_renv_t* surgescript_renv_destroy(surgescript_renv_t* runtime_environment);
 
+/* initializes a renv stored in memory owned by the caller; so are its SURGESCRIPT_RENV_MAX_TMPVARS temporary variables (tmp may not be NULL) */
+surgescript_renv_t* surgescript_renv_init(surgescript_renv_t* runtime_environment, struct surgescript_object_t* owner, struct surgescript_stack_t* stack, struct surgescript_heap_t* heap, struct surgescript_programpool_t* program_pool, struct surgescript_objectmanager_t* object_manager, struct surgescript_var_t** tmp);
+
+/* releases a renv initialized with surgescript_renv_init(): its temporary variables are set to null */
+void surgescript_renv_release(surgescript_renv_t* runtime_environment);
+
 /* getters */
 static inline struct surgescript_object_t* surgescript_renv_owner(surgescript_renv_t* renv) { return renv->owner; }
 static inline struct surgescript_stack_t* surgescript_renv_stack(surgescript_renv_t* renv) { return renv->stack; }
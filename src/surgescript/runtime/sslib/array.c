@@ -289,11 +289,12 @@ surgescript_var_t* fun_sort(surgescript_object_t* object, const surgescript_var_
 surgescript_var_t* fun_shuffle(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
     surgescript_heap_t* heap = surgescript_object_heap(object);
+    surgescript_prng_t* prng = surgescript_objectmanager_prng(surgescript_object_manager(object));
     int length = ARRAY_LENGTH(heap);
 
     for(int i = length; i > 0; i--) {
         surgescript_var_t* a = surgescript_heap_at(heap, BASE_ADDR + (i - 1));
-        surgescript_var_t* b = surgescript_heap_at(heap, BASE_ADDR + (surgescript_util_random64() % i));
+        surgescript_var_t* b = surgescript_heap_at(heap, BASE_ADDR + (surgescript_util_prng_random64(prng) % i));
         surgescript_var_swap(a, b);
     }
 
@@ -347,7 +348,7 @@ surgescript_var_t* fun_tostring(surgescript_object_t* object, const surgescript_
     surgescript_var_t* stringified_array = surgescript_var_create();
     surgescript_heap_t* heap = surgescript_object_heap(object);
     int length = ARRAY_LENGTH(heap);
-    static int depth = 0;
+    static SS_THREADLOCAL int depth = 0;
     bool can_descend = (++depth < 16); /* handle circular links */
 
     /* helper macro */
@@ -313,7 +313,7 @@ surgescript_var_t* fun_tostring(surgescript_object_t* object, const surgescript_
     surgescript_var_t* stringified_dictionary = surgescript_var_create();
     surgescript_object_t* iterator = NULL;
     SSARRAY(char, sb); /* string builder */
-    static int depth = 0;
+    static SS_THREADLOCAL int depth = 0;
     bool can_descend = (++depth < 16); /* handle circular links */
 
     /* helper macros */
@@ -505,8 +505,10 @@ surgescript_var_t* fun_it_next(surgescript_object_t* object, const surgescript_v
         left_handle = surgescript_var_get_objecthandle(surgescript_heap_at(node_heap, BST_LEFT));
         if(surgescript_objectmanager_exists(manager, left_handle)) {
             top_ptr = IT_STACKBASE + surgescript_var_get_number(stacksize);
-            if(!surgescript_heap_validaddress(heap, top_ptr))
+            if(!surgescript_heap_validaddress(heap, top_ptr)) {
                 ssassert(top_ptr == surgescript_heap_malloc(heap));
+                stacksize = surgescript_heap_at(heap, IT_STACKSIZE); /* the heap may have been relocated */
+            }
             new_top = surgescript_heap_at(heap, top_ptr);
             surgescript_var_set_objecthandle(new_top, left_handle);
             surgescript_var_set_number(stacksize, surgescript_var_get_number(stacksize) + 1);
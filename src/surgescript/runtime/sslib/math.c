@@ -20,10 +20,12 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include "../vm.h"
 #include "../object.h"
+#include "../object_manager.h"
 #include "../../util/util.h"
 
 /* private stuff */
@@ -117,6 +119,78 @@ void surgescript_sslib_register_math(surgescript_vm_t* vm)
     surgescript_vm_bind(vm, "Math", "deltaAngle", fun_deltaangle, 2);
 }
 
+/*
+ * surgescript_sslib_math_evaluate()
+ * Evaluates a pure function of Math (i.e., one whose return value depends
+ * only on its arguments), so that the compiler can fold calls to it. Returns
+ * false if fun_name isn't a pure function of Math with num_params parameters
+ */
+bool surgescript_sslib_math_evaluate(const char* fun_name, const surgescript_var_t** param, int num_params, surgescript_var_t* result)
+{
+    static const struct {
+        const char* name;
+        int num_params;
+        surgescript_var_t* (*fun)(surgescript_object_t*, const surgescript_var_t**, int);
+    } pure_function[] = {
+        { "get_epsilon", 0, fun_getepsilon },
+        { "get_pi", 0, fun_getpi },
+        { "get_infinity", 0, fun_getinfinity },
+        { "get_NaN", 0, fun_getnan },
+        { "sin", 1, fun_sin },
+        { "cos", 1, fun_cos },
+        { "tan", 1, fun_tan },
+        { "asin", 1, fun_asin },
+        { "acos", 1, fun_acos },
+        { "atan", 1, fun_atan },
+        { "atan2", 2, fun_atan2 },
+        { "deg2rad", 1, fun_deg2rad },
+        { "rad2deg", 1, fun_rad2deg },
+        { "pow", 2, fun_pow },
+        { "sqrt", 1, fun_sqrt },
+        { "exp", 1, fun_exp },
+        { "log", 1, fun_log },
+        { "log10", 1, fun_log10 },
+        { "floor", 1, fun_floor },
+        { "ceil", 1, fun_ceil },
+        { "round", 1, fun_round },
+        { "mod", 2, fun_mod },
+        { "sign", 1, fun_sign },
+        { "signum", 1, fun_signum },
+        { "abs", 1, fun_abs },
+        { "min", 2, fun_min },
+        { "max", 2, fun_max },
+        { "clamp", 3, fun_clamp },
+        { "approximately", 2, fun_approximately },
+        { "lerp", 3, fun_lerp },
+        { "smoothstep", 3, fun_smoothstep },
+        { "lerpAngle", 3, fun_lerpangle },
+        { "deltaAngle", 2, fun_deltaangle }
+    };
+
+    for(int i = 0; i < sizeof(pure_function) / sizeof(pure_function[0]); i++) {
+        if(pure_function[i].num_params == num_params && strcmp(pure_function[i].name, fun_name) == 0) {
+            /* the return value is allocated on a pool of our own,
+               as we may be compiling on a thread of a batch */
+            surgescript_varpool_t* pool = surgescript_varpool_create();
+            surgescript_varpool_t* previous_pool = surgescript_varpool_make_current(pool);
+            surgescript_var_t* ret = pure_function[i].fun(NULL, param, num_params);
+
+            if(ret != NULL) {
+                surgescript_var_copy(result, ret);
+                surgescript_var_destroy(ret);
+            }
+            else
+                surgescript_var_set_null(result);
+
+            surgescript_varpool_make_current(previous_pool);
+            surgescript_varpool_destroy(pool);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 
 
 /* my functions */
@@ -169,7 +243,9 @@ surgescript_var_t* fun_getnan(surgescript_object_t* object, const surgescript_va
 /* random(): returns a random number between 0 (inclusive) and 1 (exclusive) */
 surgescript_var_t* fun_random(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    return surgescript_var_set_number(surgescript_var_create(), surgescript_util_random());
+    surgescript_objectmanager_t* manager = surgescript_object_manager(object);
+    surgescript_prng_t* prng = surgescript_objectmanager_prng(manager);
+    return surgescript_var_set_number(surgescript_var_create(), surgescript_util_prng_random(prng));
 }
 
 /* sin(x): sine of x, x in radians */
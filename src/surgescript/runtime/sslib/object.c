@@ -485,7 +485,7 @@ void add_to_function_array(const char* fun_name, void* arr)
 /* is fun_name publicly visible or not? */
 bool is_visible_function(const char* fun_name)
 {
-    return strncmp(fun_name, "state:", 6) && strcmp(fun_name, "__ssconstructor");
+    return strncmp(fun_name, "state:", 6) && strncmp(fun_name, "__ss", 4); /* e.g., __ssconstructor */
 }
 
 /* can the desired object be spawned? */
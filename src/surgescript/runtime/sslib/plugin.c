@@ -41,6 +41,7 @@ static surgescript_var_t* fun_getcount(surgescript_object_t* object, const surge
 /* helpers */
 #define isidchar(c) (isalnum(c) || (c) == '_' || (c) == '$')
 static surgescript_program_t* make_accessor(surgescript_objecthandle_t plugin_handle);
+static surgescript_objecthandle_t accessed_handle(surgescript_object_t* object, const char* accessor_name);
 static bool is_valid_name(const char* plugin_name);
 static bool is_builtin_object(const char* plugin_name, surgescript_objectmanager_t* manager);
 
@@ -95,9 +96,9 @@ surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var
     if(plugin_handle == surgescript_objectmanager_null(manager)) {
         /* spawn the plugin and save a reference to it in the memory */
         surgescript_heap_t* heap = surgescript_object_heap(object);
-        surgescript_var_t* mem = surgescript_heap_at(heap, surgescript_heap_malloc(heap));
+        surgescript_heapptr_t addr = surgescript_heap_malloc(heap);
         plugin_handle = surgescript_objectmanager_spawn(manager, me, plugin_name, NULL);
-        surgescript_var_set_objecthandle(mem, plugin_handle);
+        surgescript_var_set_objecthandle(surgescript_heap_at(heap, addr), plugin_handle);
 
         /* create a getter */
         if(is_valid_name(plugin_name)) {
@@ -108,6 +109,14 @@ surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var
                 surgescript_program_t* accessor = make_accessor(plugin_handle);
                 surgescript_programpool_put(pool, object_name, accessor_name, accessor);
             }
+            else if(surgescript_programpool_is_shared(pool)) {
+                /* the getter was created by another VM that shares the code of
+                   this one. Keep it if it's still valid (the handles usually match) */
+                if(accessed_handle(object, accessor_name) != plugin_handle) {
+                    surgescript_program_t* accessor = make_accessor(plugin_handle);
+                    surgescript_programpool_replace(pool, object_name, accessor_name, accessor);
+                }
+            }
             else
                 ssfatal("Runtime Error: duplicate plugin name \"%s\".", plugin_name); /* this shouldn't happen */
             ssfree(accessor_name);
@@ -153,6 +162,19 @@ surgescript_program_t* make_accessor(surgescript_objecthandle_t plugin_handle)
     return program;
 }
 
+/* the handle returned by an existing getter */
+surgescript_objecthandle_t accessed_handle(surgescript_object_t* object, const char* accessor_name)
+{
+    surgescript_var_t* handle = surgescript_var_create();
+    surgescript_objecthandle_t result;
+
+    surgescript_object_call_function(object, accessor_name, NULL, 0, handle);
+    result = surgescript_var_get_objecthandle(handle);
+    surgescript_var_destroy(handle);
+
+    return result;
+}
+
 /* a plugin name is valid if it matches that of an IDENTIFIER (see compiler/lexer.c) */
 bool is_valid_name(const char* plugin_name)
 {
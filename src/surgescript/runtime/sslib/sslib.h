@@ -22,8 +22,11 @@
 #ifndef _SURGESCRIPT_RUNTIME_STDLIB_STDLIB_H
 #define _SURGESCRIPT_RUNTIME_STDLIB_STDLIB_H
 
+#include <stdbool.h>
+
 /* forward declarations */
 struct surgescript_vm_t;
+struct surgescript_var_t;
 
 /* Register common methods to all objects */
 void surgescript_sslib_register_object(struct surgescript_vm_t* vm);
@@ -45,4 +48,7 @@ void surgescript_sslib_register_tagsystem(struct surgescript_vm_t* vm);
 void surgescript_sslib_register_surgescript(struct surgescript_vm_t* vm);
 void surgescript_sslib_register_plugin(struct surgescript_vm_t* vm);
 
+/* Compile-time evaluation */
+bool surgescript_sslib_math_evaluate(const char* fun_name, const struct surgescript_var_t** param, int num_params, struct surgescript_var_t* result); /* evaluates a pure function of Math; returns false if there is no such function */
+
 #endif
\ No newline at end of file
@@ -101,29 +101,21 @@ surgescript_var_t* fun_spawn(surgescript_object_t* object, const surgescript_var
 /* returns my primitive */
 surgescript_var_t* fun_valueof(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    const char* str = surgescript_var_fast_get_string(param[0]); /* param[0] can be assumed to be a string, for sure */
-    surgescript_var_t* ret = surgescript_var_set_string(surgescript_var_create(), str);
-    return ret;
+    /* param[0] can be assumed to be a string, for sure */
+    return surgescript_var_clone(param[0]); /* shares the string */
 }
 
 /* converts to string */
 surgescript_var_t* fun_tostring(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    const char* str = surgescript_var_fast_get_string(param[0]);
-    surgescript_var_t* ret = surgescript_var_set_string(surgescript_var_create(), str);
-    return ret;
+    return surgescript_var_clone(param[0]); /* shares the string */
 }
 
 /* equals() method */
 surgescript_var_t* fun_equals(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    if(surgescript_var_typecode(param[0]) == surgescript_var_typecode(param[1])) {
-        const char* a = surgescript_var_fast_get_string(param[0]); /* can be assumed to be a string, for sure */
-        const char* b = surgescript_var_fast_get_string(param[1]); /* it's a string, since param[0] is a string */
-        return surgescript_var_set_bool(surgescript_var_create(), strcmp(a, b) == 0);
-    }
-    else
-        return surgescript_var_set_bool(surgescript_var_create(), false);
+    /* param[0] can be assumed to be a string, for sure */
+    return surgescript_var_set_bool(surgescript_var_create(), surgescript_var_string_equals(param[0], param[1]));
 }
 
 /* call: type conversion */
@@ -139,8 +131,8 @@ surgescript_var_t* fun_call(surgescript_object_t* object, const surgescript_var_
 /* length of the string */
 surgescript_var_t* fun_getlength(surgescript_object_t* object, const surgescript_var_t** param, int num_params)
 {
-    const char* str = surgescript_var_fast_get_string(param[0]);
-    return surgescript_var_set_number(surgescript_var_create(), u8_strlen(str));
+    size_t length = surgescript_var_fast_get_string_length(param[0]); /* cached */
+    return surgescript_var_set_number(surgescript_var_create(), length);
 }
 
 /* character at */
@@ -150,8 +142,8 @@ surgescript_var_t* fun_get(surgescript_object_t* object, const surgescript_var_t
     int index = (int)surgescript_var_get_number(param[1]);
     char chr[7] = { 0 };
 
-    if(index >= 0 && index < u8_strlen(str)) {
-        size_t offset = u8_offset(str, index);
+    if(index >= 0 && index < surgescript_var_fast_get_string_length(param[0])) {
+        size_t offset = surgescript_var_fast_get_string_offset(param[0], index);
         size_t seq_len = u8_seqlen(str + offset);
         for(int i = 0; i < sizeof(chr) - 1 && seq_len--; i++)
             chr[i] = str[offset + i];
@@ -186,7 +178,7 @@ surgescript_var_t* fun_substr(surgescript_object_t* object, const surgescript_va
     int start = surgescript_var_get_number(param[1]);
     int length = surgescript_var_get_number(param[2]);
     surgescript_var_t* var = surgescript_var_create();
-    size_t utf8len = u8_strlen(str);
+    size_t utf8len = surgescript_var_fast_get_string_length(param[0]);
     char* substr;
 
     /* sanity check */
@@ -197,8 +189,8 @@ surgescript_var_t* fun_substr(surgescript_object_t* object, const surgescript_va
     length = ssclamp(length, 0, (int)utf8len - start);
 
     /* extract the substring */
-    begin = str + u8_offset((char*)str, start);
-    end = str + u8_offset((char*)str, start + length);
+    begin = str + surgescript_var_fast_get_string_offset(param[0], start);
+    end = str + surgescript_var_fast_get_string_offset(param[0], start + length);
     ssassert(end >= begin);
     substr = ssmalloc((2 + end - begin) * sizeof(*substr));
     surgescript_util_strncpy(substr, begin, 1 + end - begin);
@@ -78,8 +78,9 @@ surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescri
 
     /* spawn children; system_objects is a NULL-terminated array */
     for(const char** p = system_objects; *p != NULL; p++) {
-        surgescript_var_t* mem = surgescript_heap_at(heap, surgescript_heap_malloc(heap));
-        surgescript_var_set_objecthandle(mem, surgescript_objectmanager_spawn(manager, me, *p, NULL));
+        surgescript_heapptr_t addr = surgescript_heap_malloc(heap);
+        surgescript_objecthandle_t child = surgescript_objectmanager_spawn(manager, me, *p, NULL);
+        surgescript_var_set_objecthandle(surgescript_heap_at(heap, addr), child);
     }
 
     /* spawn plugins */
@@ -89,10 +90,9 @@ surgescript_var_t* fun_constructor(surgescript_object_t* object, const surgescri
     );
 
     /* spawn Application */
-    surgescript_var_set_objecthandle(
-        surgescript_heap_at(heap, surgescript_heap_malloc(heap)),
-        surgescript_objectmanager_spawn(manager, me, "Application", NULL)
-    );
+    surgescript_heapptr_t addr = surgescript_heap_malloc(heap);
+    surgescript_objecthandle_t application = surgescript_objectmanager_spawn(manager, me, "Application", NULL);
+    surgescript_var_set_objecthandle(surgescript_heap_at(heap, addr), application);
 
     /* done! */
     return NULL;
@@ -19,6 +19,8 @@
  * SurgeScript stack
  */
 
+#include <string.h>
+#include <stddef.h>
 #include "stack.h"
 #include "variable.h"
 #include "../util/util.h"
@@ -32,24 +34,25 @@
  * |     some data       |
  * |     some data       |
  * |     some data       |
- * |    previous BP      | <-- BP
+ * |     (reserved)      | <-- BP
  * +---------------------+
  * |     some data       |
  * |     some data       |
- * |   previous BP (0)   |
+ * |     (reserved)      |
  * +---------------------+
+ *
+ * The previous BP of each environment is kept in a separate stack of frame
+ * records. The cell at BP is kept empty, so that the parameters of a function
+ * are at negative offsets and its local variables are at positive offsets.
  */
 
 /* constants */
-static const size_t SSSTACK_INITIAL_SIZE = 65536; /* 64K */
+static const size_t SSSTACK_INITIAL_SIZE = 4096; /* 4K */
+static const size_t SSSTACK_MAX_SIZE = 16777216; /* 16M */
 
-/* the stack structure */
-struct surgescript_stack_t
-{
-    size_t size;                     /* size of the stack */
-    surgescript_stackptr_t sp, bp;   /* pointers */
-    surgescript_var_t** data;        /* stack data */
-};
+/* private stuff */
+static void grow(surgescript_stack_t* stack, size_t n);
+static void clear(surgescript_stack_t* stack, surgescript_stackptr_t from, surgescript_stackptr_t to);
 
 
 /* -------------------------------
@@ -68,10 +71,9 @@ surgescript_stack_t* surgescript_stack_create()
     stack->data = ssmalloc(size * sizeof(*(stack->data)));
     stack->size = size;
     stack->sp = stack->bp = 0;
-    while(size)
-        stack->data[--size] = NULL;
+    memset(stack->data, 0, size * sizeof(*(stack->data))); /* fill with nulls */
 
-    stack->data[0] = surgescript_var_set_rawbits(surgescript_var_create(), stack->bp);
+    ssarray_init(stack->frame);
     return stack;
 }
 
@@ -81,11 +83,9 @@ surgescript_stack_t* surgescript_stack_create()
  */
 surgescript_stack_t* surgescript_stack_destroy(surgescript_stack_t* stack)
 {
-    for(surgescript_stackptr_t i = stack->size - 1; i >= 0; i--) {
-        if(stack->data[i] != NULL)
-            surgescript_var_destroy(stack->data[i]);
-    }
+    clear(stack, 0, stack->sp);
 
+    ssarray_release(stack->frame);
     ssfree(stack->data);
     ssfree(stack);
     return NULL;
@@ -93,14 +93,35 @@ surgescript_stack_t* surgescript_stack_destroy(surgescript_stack_t* stack)
 
 /*
  * surgescript_stack_push()
- * Pushes a variable onto the stack
+ * Pushes a variable onto the stack. The stack takes ownership of data
  */
 void surgescript_stack_push(surgescript_stack_t* stack, surgescript_var_t* data)
 {
-    if(++stack->sp < stack->size)
-        stack->data[stack->sp] = data;
-    else
-        ssfatal("Runtime Error: surgescript_stack_push() - stack overflow");
+    if(stack->sp + 1 >= (surgescript_stackptr_t)stack->size)
+        grow(stack, 1);
+
+    surgescript_var_swap(&(stack->data[++stack->sp]), data); /* move data to the (null) top cell */
+    surgescript_var_destroy(data);
+}
+
+/*
+ * surgescript_stack_push_copy()
+ * Pushes a copy of a variable onto the stack
+ */
+void surgescript_stack_push_copy(surgescript_stack_t* stack, const surgescript_var_t* data)
+{
+    if(stack->sp + 1 >= (surgescript_stackptr_t)stack->size) {
+        /* data may live in the stack itself */
+        if(data >= stack->data && data < stack->data + stack->size) {
+            ptrdiff_t idx = data - stack->data;
+            grow(stack, 1);
+            data = stack->data + idx;
+        }
+        else
+            grow(stack, 1);
+    }
+
+    surgescript_var_copy(&(stack->data[++stack->sp]), data);
 }
 
 /*
@@ -110,7 +131,7 @@ void surgescript_stack_push(surgescript_stack_t* stack, surgescript_var_t* data)
 void surgescript_stack_pop(surgescript_stack_t* stack)
 {
     if(stack->sp > stack->bp) {
-        stack->data[stack->sp] = surgescript_var_destroy(stack->data[stack->sp]);
+        surgescript_var_set_null(&(stack->data[stack->sp]));
         stack->sp--;
     }
     else
@@ -123,10 +144,15 @@ void surgescript_stack_pop(surgescript_stack_t* stack)
  */
 void surgescript_stack_pushenv(surgescript_stack_t* stack)
 {
-    /* push prev BP & set new BP */
-    surgescript_var_t* prev_bp = surgescript_var_set_rawbits(surgescript_var_create(), stack->bp);
-    surgescript_stack_push(stack, prev_bp);
-    stack->bp = stack->sp; /* the base of the stack points to the previous bp */
+    /* calls nest in native code, too */
+    if(surgescript_util_stackoverflow())
+        ssfatal("Runtime Error: stack overflow - the maximum recursion depth has been exceeded (%d calls)", (int)ssarray_length(stack->frame));
+    else if(stack->sp + 1 >= (surgescript_stackptr_t)stack->size)
+        grow(stack, 1);
+
+    /* save the previous BP & set the new BP */
+    ssarray_push(stack->frame, stack->bp);
+    stack->bp = ++stack->sp;
 }
 
 /*
@@ -135,16 +161,11 @@ void surgescript_stack_pushenv(surgescript_stack_t* stack)
  */
 void surgescript_stack_popenv(surgescript_stack_t* stack)
 {
-    if(stack->sp > 0) {
-        /* get previous bp & deallocate everything in between */
-        surgescript_stackptr_t i, prev_bp = surgescript_var_get_rawbits(stack->data[stack->bp]);
-        for(i = stack->sp; i >= stack->bp; i--) {
-            if(stack->data[i] != NULL)
-                stack->data[i] = surgescript_var_destroy(stack->data[i]);
-        }
-
+    if(ssarray_length(stack->frame) > 0) {
+        /* clear everything in between & restore the previous BP */
+        clear(stack, stack->bp, stack->sp);
         stack->sp = stack->bp - 1;
-        stack->bp = prev_bp;
+        ssarray_pop(stack->frame, stack->bp);
     }
     else
         ssfatal("Runtime Error: surgescript_stack_popenv() has found an empty stack");
@@ -156,8 +177,11 @@ void surgescript_stack_popenv(surgescript_stack_t* stack)
  */
 void surgescript_stack_pushn(surgescript_stack_t* stack, size_t n)
 {
-    while(n--)
-        surgescript_stack_push(stack, surgescript_var_create());
+    if(stack->sp + n >= stack->size)
+        grow(stack, n);
+
+    /* the cells above sp are already null */
+    stack->sp += n;
 }
 
 /*
@@ -166,8 +190,12 @@ void surgescript_stack_pushn(surgescript_stack_t* stack, size_t n)
  */
 void surgescript_stack_popn(surgescript_stack_t* stack, size_t n)
 {
-    while(n--)
-        surgescript_stack_pop(stack);
+    if(n <= (size_t)(stack->sp - stack->bp)) {
+        clear(stack, stack->sp - n + 1, stack->sp);
+        stack->sp -= n;
+    }
+    else
+        ssfatal("Runtime Error: can't surgescript_stack_popn() - empty stack");
 }
 
 /*
@@ -176,7 +204,7 @@ void surgescript_stack_popn(surgescript_stack_t* stack, size_t n)
  */
 const surgescript_var_t* surgescript_stack_top(const surgescript_stack_t* stack)
 {
-    return stack->data[stack->sp];
+    return &(stack->data[stack->sp]);
 }
 
 
@@ -189,7 +217,7 @@ const surgescript_var_t* surgescript_stack_peek(const surgescript_stack_t* stack
     const surgescript_stackptr_t idx = stack->bp + offset;
 
     if(idx >= 0 && idx <= stack->sp)
-        return stack->data[idx];
+        return &(stack->data[idx]);
 
     ssfatal("Runtime Error: surgescript_stack_peek() can't read an element (%d) that is out of bounds [%d, %d]", idx, 0, stack->sp);
     return NULL;
@@ -204,11 +232,25 @@ void surgescript_stack_poke(surgescript_stack_t* stack, surgescript_stackptr_t o
     const surgescript_stackptr_t idx = stack->bp + offset;
 
     if(idx >= 0 && idx <= stack->sp)
-        surgescript_var_copy(stack->data[idx], data);
+        surgescript_var_copy(&(stack->data[idx]), data);
     else
         ssfatal("Runtime Error: surgescript_stack_poke() can't write to an element (%d) that is out of bounds [%d, %d]", idx, 0, stack->sp);
 }
 
+/*
+ * surgescript_stack_swap()
+ * Swaps data and stack[base+offset], without copying anything
+ */
+void surgescript_stack_swap(surgescript_stack_t* stack, surgescript_stackptr_t offset, surgescript_var_t* data)
+{
+    const surgescript_stackptr_t idx = stack->bp + offset;
+
+    if(idx >= 0 && idx <= stack->sp)
+        surgescript_var_swap(&(stack->data[idx]), data);
+    else
+        ssfatal("Runtime Error: surgescript_stack_swap() can't access an element (%d) that is out of bounds [%d, %d]", idx, 0, stack->sp);
+}
+
 /*
  * surgescript_stack_empty()
  * Is the stack empty?
@@ -225,12 +267,10 @@ int surgescript_stack_empty(const surgescript_stack_t* stack)
 void surgescript_stack_scan_objects(surgescript_stack_t* stack, void* userdata, bool (*callback)(unsigned,void*))
 {
     for(surgescript_stackptr_t i = stack->sp - 1; i >= 0; i--) { /* check all environments */
-        if(stack->data[i] != NULL) {
-            unsigned handle = surgescript_var_get_objecthandle(stack->data[i]);
-            if(handle != 0) { /* if it is an object and not null */
-                if(!callback(handle, userdata)) /* if the handle is broken */
-                    surgescript_var_set_null(stack->data[i]); /* fix it */
-            }
+        unsigned handle = surgescript_var_get_objecthandle(&(stack->data[i]));
+        if(handle != 0) { /* if it is an object and not null */
+            if(!callback(handle, userdata)) /* if the handle is broken */
+                surgescript_var_set_null(&(stack->data[i])); /* fix it */
         }
     }
 }
@@ -242,4 +282,45 @@ void surgescript_stack_scan_objects(surgescript_stack_t* stack, void* userdata,
 size_t surgescript_stack_size(const surgescript_stack_t* stack)
 {
     return stack->sp;
+}
+
+/*
+ * surgescript_stack_depth()
+ * Returns the number of nested environments
+ */
+size_t surgescript_stack_depth(const surgescript_stack_t* stack)
+{
+    return ssarray_length(stack->frame);
+}
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+/* makes room for n more variables above sp */
+void grow(surgescript_stack_t* stack, size_t n)
+{
+    size_t size = stack->size;
+    size_t needed = stack->sp + n + 1;
+
+    /* is the stack too large? */
+    if(needed > SSSTACK_MAX_SIZE)
+        ssfatal("Runtime Error: stack overflow");
+
+    /* double the size of the stack. The new cells are null */
+    while(size < needed)
+        size *= 2;
+    size = ssmin(size, SSSTACK_MAX_SIZE);
+
+    stack->data = ssrealloc(stack->data, size * sizeof(*(stack->data)));
+    memset(stack->data + stack->size, 0, (size - stack->size) * sizeof(*(stack->data)));
+    stack->size = size;
+}
+
+/* sets stack[from .. to] to null */
+void clear(surgescript_stack_t* stack, surgescript_stackptr_t from, surgescript_stackptr_t to)
+{
+    for(surgescript_stackptr_t i = to; i >= from; i--)
+        surgescript_var_set_null(&(stack->data[i]));
 }
\ No newline at end of file
@@ -24,19 +24,30 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include "../util/ssarray.h"
 
 /* types */
 typedef struct surgescript_stack_t surgescript_stack_t;
-struct surgescript_stack_t;
 typedef int surgescript_stackptr_t;
 
+/* the stack structure. It's declared here so that compiled code (see jit.c)
+   may access it directly, but please use the functions below instead */
+struct surgescript_stack_t
+{
+    size_t size;                     /* size of the stack (it grows on demand) */
+    surgescript_stackptr_t sp, bp;   /* pointers */
+    struct surgescript_var_t* data;  /* stack data (variables are stored inline; the cells above sp are null) */
+    SSARRAY(surgescript_stackptr_t, frame); /* frame records: the saved base pointers */
+};
+
 /* forward declarations */
 struct surgescript_var_t;
 
 /* public methods */
 surgescript_stack_t* surgescript_stack_create();
 surgescript_stack_t* surgescript_stack_destroy(surgescript_stack_t* stack);
-void surgescript_stack_push(surgescript_stack_t* stack, struct surgescript_var_t* data); /* pushes data to the stack */
+void surgescript_stack_push(surgescript_stack_t* stack, struct surgescript_var_t* data); /* pushes data to the stack (the stack takes ownership of data) */
+void surgescript_stack_push_copy(surgescript_stack_t* stack, const struct surgescript_var_t* data); /* pushes a copy of data to the stack */
 void surgescript_stack_pop(surgescript_stack_t* stack); /* pops and deallocates a var from the stack */
 void surgescript_stack_pushenv(surgescript_stack_t* stack); /* pushes an environment */
 void surgescript_stack_popenv(surgescript_stack_t* stack); /* pops an environment */
@@ -45,8 +56,10 @@ void surgescript_stack_popn(surgescript_stack_t* stack, size_t n); /* pops n var
 const struct surgescript_var_t* surgescript_stack_top(const surgescript_stack_t* stack); /* gets the topmost element */
 const struct surgescript_var_t* surgescript_stack_peek(const surgescript_stack_t* stack, surgescript_stackptr_t offset); /* reads stack[base + offset] */
 void surgescript_stack_poke(surgescript_stack_t* stack, surgescript_stackptr_t offset, const struct surgescript_var_t* data); /* writes data on stack[base + offset] */
+void surgescript_stack_swap(surgescript_stack_t* stack, surgescript_stackptr_t offset, struct surgescript_var_t* data); /* swaps data and stack[base + offset] */
 int surgescript_stack_empty(const surgescript_stack_t* stack); /* is the stack empty? */
 void surgescript_stack_scan_objects(surgescript_stack_t* stack, void* userdata, bool (*callback)(unsigned,void*));
 size_t surgescript_stack_size(const surgescript_stack_t* stack); /* stack size */
+size_t surgescript_stack_depth(const surgescript_stack_t* stack); /* number of nested environments */
 
 #endif
@@ -34,6 +34,7 @@ typedef uint64_t surgescript_tag_t;
 typedef struct surgescript_tagtable_t surgescript_tagtable_t;
 typedef struct surgescript_inversetagtable_t surgescript_inversetagtable_t;
 typedef struct surgescript_tagtree_t surgescript_tagtree_t;
+typedef struct surgescript_tagdata_t surgescript_tagdata_t;
 
 #if defined(USE_FAST_TAGS)
 typedef uint64_t surgescript_tagsignature_t;
@@ -41,8 +42,9 @@ typedef uint64_t surgescript_tagsignature_t;
 #  include "../util/fasthash.h"
 #endif
 
-/* tag system */
-struct surgescript_tagsystem_t
+/* the contents of a tag system. They may be shared by many
+   tag systems, in which case they're read-only (copy-on-write) */
+struct surgescript_tagdata_t
 {
 #if defined(USE_FAST_TAGS)
     fasthash_t* tag_table; /* tag table: object -> tags */
@@ -51,6 +53,13 @@ struct surgescript_tagsystem_t
 #endif
     surgescript_inversetagtable_t* inverse_tag_table; /* inverse tag table: tag -> objects */
     surgescript_tagtree_t* tag_tree; /* the set of all tags */
+    ssrefcount_t refcount; /* how many tag systems share these contents */
+};
+
+/* tag system */
+struct surgescript_tagsystem_t
+{
+    surgescript_tagdata_t* data; /* possibly shared */
 };
 
 /* tag table: an object may hold an arbitrary number of tags */
@@ -93,6 +102,13 @@ struct surgescript_tagtree_t
 static surgescript_tagtree_t* add_to_tree(surgescript_tagtree_t* tree, const char* key);
 static void remove_tree(surgescript_tagtree_t* tree);
 static void traverse_tree(const surgescript_tagtree_t* tree, void* data, void (*callback)(const char*, void*));
+typedef struct { surgescript_tagdata_t* data; const char* tag_name; } surgescript_tagcopy_t;
+static surgescript_tagdata_t* create_data();
+static surgescript_tagdata_t* copy_data(const surgescript_tagdata_t* data);
+static surgescript_tagdata_t* release_data(surgescript_tagdata_t* data);
+static void copy_tag(const char* object_name, void* entry);
+static void add_tag(surgescript_tagdata_t* data, const char* object_name, const char* tag_name);
+static bool has_tag(const surgescript_tagdata_t* data, const char* object_name, const char* tag_name);
 
 
 /*
@@ -102,15 +118,20 @@ static void traverse_tree(const surgescript_tagtree_t* tree, void* data, void (*
 surgescript_tagsystem_t* surgescript_tagsystem_create()
 {
     surgescript_tagsystem_t* tag_system = ssmalloc(sizeof *tag_system);
-#if defined(USE_FAST_TAGS)
-    tag_system->tag_table = fasthash_create(destroy_tagtable_entry, 13);
-    tag_system->inverse_tag_table = NULL;
-    tag_system->tag_tree = NULL;
-#else
-    tag_system->tag_table = NULL;
-    tag_system->inverse_tag_table = NULL;
-    tag_system->tag_tree = NULL;
-#endif
+    tag_system->data = create_data();
+    return tag_system;
+}
+
+/*
+ * surgescript_tagsystem_create_shared()
+ * Creates a Tag System instance that shares the tags of another.
+ * Modifying either instance later on will not affect the other (copy-on-write)
+ */
+surgescript_tagsystem_t* surgescript_tagsystem_create_shared(surgescript_tagsystem_t* source)
+{
+    surgescript_tagsystem_t* tag_system = ssmalloc(sizeof *tag_system);
+    ssrefcount_inc(source->data->refcount);
+    tag_system->data = source->data;
     return tag_system;
 }
 
@@ -120,14 +141,113 @@ surgescript_tagsystem_t* surgescript_tagsystem_create()
  */
 surgescript_tagsystem_t* surgescript_tagsystem_destroy(surgescript_tagsystem_t* tag_system)
 {
+    release_data(tag_system->data);
+    return ssfree(tag_system);
+}
+
+/*
+ * surgescript_tagsystem_add_tag()
+ * Add tag_name to a certain class of objects
+ */
+void surgescript_tagsystem_add_tag(surgescript_tagsystem_t* tag_system, const char* object_name, const char* tag_name)
+{
+    /* don't modify the contents unless necessary, as they may be shared */
+    if(has_tag(tag_system->data, object_name, tag_name))
+        return;
+
+    /* copy-on-write */
+    if(ssrefcount_get(tag_system->data->refcount) > 1) {
+        surgescript_tagdata_t* copy = copy_data(tag_system->data);
+        release_data(tag_system->data);
+        tag_system->data = copy;
+    }
+
+    add_tag(tag_system->data, object_name, tag_name);
+}
+
+/*
+ * surgescript_tagsystem_has_tag()
+ * Is object_name tagged tag_name?
+ */
+bool surgescript_tagsystem_has_tag(const surgescript_tagsystem_t* tag_system, const char* object_name, const char* tag_name)
+{
+    return has_tag(tag_system->data, object_name, tag_name);
+}
+
+/*
+ * surgescript_tagsystem_foreach_tag()
+ * For each registered tag, calls callback(tag_name, data) in alphabetical order
+ */
+void surgescript_tagsystem_foreach_tag(const surgescript_tagsystem_t* tag_system, void* data, void (*callback)(const char*,void*))
+{
+    traverse_tree(tag_system->data->tag_tree, data, callback);
+}
+
+/*
+ * surgescript_tagsystem_foreach_tagged_object()
+ * For each object tagged tag_name, calls callback(object_name, data)
+ */
+void surgescript_tagsystem_foreach_tagged_object(const surgescript_tagsystem_t* tag_system, const char* tag_name, void* data, void (*callback)(const char*,void*))
+{
+    surgescript_inversetagtable_t* ientry = NULL;
+
+    HASH_FIND(hh, tag_system->data->inverse_tag_table, tag_name, strlen(tag_name), ientry);
+    if(ientry != NULL) {
+        /* objects are called in alphabetical order */
+        traverse_tree(ientry->objects, data, callback);
+    }
+}
+
+
+
+/* private stuff */
+
+/* creates empty contents */
+surgescript_tagdata_t* create_data()
+{
+    surgescript_tagdata_t* data = ssmalloc(sizeof *data);
+#if defined(USE_FAST_TAGS)
+    data->tag_table = fasthash_create(destroy_tagtable_entry, 13);
+    data->inverse_tag_table = NULL;
+    data->tag_tree = NULL;
+#else
+    data->tag_table = NULL;
+    data->inverse_tag_table = NULL;
+    data->tag_tree = NULL;
+#endif
+    ssrefcount_init(data->refcount, 1);
+    return data;
+}
+
+/* copies the contents of a tag system */
+surgescript_tagdata_t* copy_data(const surgescript_tagdata_t* data)
+{
+    surgescript_tagdata_t* copy = create_data();
+    surgescript_inversetagtable_t *iit, *itmp;
+
+    /* add each (object, tag) pair to the copy */
+    HASH_ITER(hh, data->inverse_tag_table, iit, itmp) {
+        surgescript_tagcopy_t entry = { copy, iit->tag_name };
+        traverse_tree(iit->objects, &entry, copy_tag);
+    }
+
+    return copy;
+}
+
+/* releases the contents of a tag system, destroying them if they're no longer shared */
+surgescript_tagdata_t* release_data(surgescript_tagdata_t* data)
+{
+    if(ssrefcount_dec(data->refcount) > 0)
+        return NULL;
+
 #if defined(USE_FAST_TAGS)
     surgescript_inversetagtable_t *iit, *itmp;
 
-    remove_tree(tag_system->tag_tree);
-    fasthash_destroy(tag_system->tag_table);
+    remove_tree(data->tag_tree);
+    fasthash_destroy(data->tag_table);
 
-    HASH_ITER(hh, tag_system->inverse_tag_table, iit, itmp) {
-        HASH_DEL(tag_system->inverse_tag_table, iit);
+    HASH_ITER(hh, data->inverse_tag_table, iit, itmp) {
+        HASH_DEL(data->inverse_tag_table, iit);
         remove_tree(iit->objects);
         ssfree(iit->tag_name);
         ssfree(iit);
@@ -136,35 +256,39 @@ surgescript_tagsystem_t* surgescript_tagsystem_destroy(surgescript_tagsystem_t*
     surgescript_tagtable_t *it, *tmp;
     surgescript_inversetagtable_t *iit, *itmp;
 
-    remove_tree(tag_system->tag_tree);
+    remove_tree(data->tag_tree);
 
-    HASH_ITER(hh, tag_system->inverse_tag_table, iit, itmp) {
-        HASH_DEL(tag_system->inverse_tag_table, iit);
+    HASH_ITER(hh, data->inverse_tag_table, iit, itmp) {
+        HASH_DEL(data->inverse_tag_table, iit);
         remove_tree(iit->objects);
         ssfree(iit->tag_name);
         ssfree(iit);
     }
 
-    HASH_ITER(hh, tag_system->tag_table, it, tmp) {
-        HASH_DEL(tag_system->tag_table, it);
+    HASH_ITER(hh, data->tag_table, it, tmp) {
+        HASH_DEL(data->tag_table, it);
         ssarray_release(it->tag);
         ssfree(it->object_name);
         ssfree(it);
     }
 #endif
 
-    return ssfree(tag_system);
+    return ssfree(data);
 }
 
-/*
- * surgescript_tagsystem_add_tag()
- * Add tag_name to a certain class of objects
- */
-void surgescript_tagsystem_add_tag(surgescript_tagsystem_t* tag_system, const char* object_name, const char* tag_name)
+/* adds (object_name, entry->tag_name) to entry->data */
+void copy_tag(const char* object_name, void* entry)
+{
+    surgescript_tagcopy_t* e = (surgescript_tagcopy_t*)entry;
+    add_tag(e->data, object_name, e->tag_name);
+}
+
+/* add tag_name to a certain class of objects */
+void add_tag(surgescript_tagdata_t* data, const char* object_name, const char* tag_name)
 {
 #if defined(USE_FAST_TAGS)
     surgescript_tagsignature_t signature = generate_tag_signature(object_name, tag_name);
-    surgescript_tagtable_t* entry = fasthash_get(tag_system->tag_table, signature);
+    surgescript_tagtable_t* entry = fasthash_get(data->tag_table, signature);
     surgescript_tag_t tag = generate_tag(tag_name);
     surgescript_inversetagtable_t* ientry = NULL;
 
@@ -174,7 +298,7 @@ void surgescript_tagsystem_add_tag(surgescript_tagsystem_t* tag_system, const ch
         entry->tag = tag;
         entry->object_name = ssstrdup(object_name);
         entry->tag_name = ssstrdup(tag_name);
-        fasthash_put(tag_system->tag_table, signature, entry);
+        fasthash_put(data->tag_table, signature, entry);
     }
     else {
         /* conflict check */
@@ -185,61 +309,58 @@ void surgescript_tagsystem_add_tag(surgescript_tagsystem_t* tag_system, const ch
     }
 
     /* add tag to inverse_tag_table */
-    HASH_FIND(hh, tag_system->inverse_tag_table, tag_name, strlen(tag_name), ientry);
+    HASH_FIND(hh, data->inverse_tag_table, tag_name, strlen(tag_name), ientry);
     if(ientry == NULL) {
         ientry = ssmalloc(sizeof *ientry);
         ientry->tag_name = ssstrdup(tag_name);
         ientry->objects = NULL;
         ientry->tag = tag;
-        HASH_ADD_KEYPTR(hh, tag_system->inverse_tag_table, ientry->tag_name, strlen(ientry->tag_name), ientry);
+        HASH_ADD_KEYPTR(hh, data->inverse_tag_table, ientry->tag_name, strlen(ientry->tag_name), ientry);
     }
 
     /* add object to the tag entry of inverse_tag_table */
     ientry->objects = add_to_tree(ientry->objects, object_name);
 
     /* add tag to tag_tree */
-    tag_system->tag_tree = add_to_tree(tag_system->tag_tree, tag_name);
+    data->tag_tree = add_to_tree(data->tag_tree, tag_name);
 #else
     surgescript_tagtable_t* entry = NULL;
     surgescript_inversetagtable_t* ientry = NULL;
     surgescript_tag_t tag = generate_tag(tag_name);
 
-    if(surgescript_tagsystem_has_tag(tag_system, object_name, tag_name))
+    if(has_tag(data, object_name, tag_name))
         return;
 
-    HASH_FIND(hh, tag_system->tag_table, object_name, strlen(object_name), entry);
+    HASH_FIND(hh, data->tag_table, object_name, strlen(object_name), entry);
     if(entry == NULL) {
         entry = ssmalloc(sizeof *entry);
         entry->object_name = ssstrdup(object_name);
         ssarray_init(entry->tag);
-        HASH_ADD_KEYPTR(hh, tag_system->tag_table, entry->object_name, strlen(entry->object_name), entry);
+        HASH_ADD_KEYPTR(hh, data->tag_table, entry->object_name, strlen(entry->object_name), entry);
     }
 
-    HASH_FIND(hh, tag_system->inverse_tag_table, tag_name, strlen(tag_name), ientry);
+    HASH_FIND(hh, data->inverse_tag_table, tag_name, strlen(tag_name), ientry);
     if(ientry == NULL) {
         ientry = ssmalloc(sizeof *ientry);
         ientry->tag_name = ssstrdup(tag_name);
         ientry->objects = NULL;
         ientry->tag = tag;
-        HASH_ADD_KEYPTR(hh, tag_system->inverse_tag_table, ientry->tag_name, strlen(ientry->tag_name), ientry);
+        HASH_ADD_KEYPTR(hh, data->inverse_tag_table, ientry->tag_name, strlen(ientry->tag_name), ientry);
     }
 
     ssarray_push(entry->tag, tag);
     ientry->objects = add_to_tree(ientry->objects, object_name);
-    tag_system->tag_tree = add_to_tree(tag_system->tag_tree, tag_name);
+    data->tag_tree = add_to_tree(data->tag_tree, tag_name);
 #endif
 }
 
-/*
- * surgescript_tagsystem_has_tag()
- * Is object_name tagged tag_name?
- */
-bool surgescript_tagsystem_has_tag(const surgescript_tagsystem_t* tag_system, const char* object_name, const char* tag_name)
+/* is object_name tagged tag_name? */
+bool has_tag(const surgescript_tagdata_t* data, const char* object_name, const char* tag_name)
 {
 #if defined(USE_FAST_TAGS)
     /* This function must be fast!!! */
     surgescript_tagsignature_t signature = generate_tag_signature(object_name, tag_name);
-    surgescript_tagtable_t* entry = fasthash_get(tag_system->tag_table, signature);
+    surgescript_tagtable_t* entry = fasthash_get(data->tag_table, signature);
 
     if(entry != NULL)
         return (entry->tag == generate_tag(tag_name));
@@ -248,7 +369,7 @@ bool surgescript_tagsystem_has_tag(const surgescript_tagsystem_t* tag_system, co
 #else
     surgescript_tagtable_t* entry = NULL;
 
-    HASH_FIND(hh, tag_system->tag_table, object_name, strlen(object_name), entry);
+    HASH_FIND(hh, data->tag_table, object_name, strlen(object_name), entry);
     if(entry != NULL) {
         surgescript_tag_t tag = generate_tag(tag_name);
         for(int i = 0; i < ssarray_length(entry->tag); i++) {
@@ -261,34 +382,6 @@ bool surgescript_tagsystem_has_tag(const surgescript_tagsystem_t* tag_system, co
 #endif
 }
 
-/*
- * surgescript_tagsystem_foreach_tag()
- * For each registered tag, calls callback(tag_name, data) in alphabetical order
- */
-void surgescript_tagsystem_foreach_tag(const surgescript_tagsystem_t* tag_system, void* data, void (*callback)(const char*,void*))
-{
-    traverse_tree(tag_system->tag_tree, data, callback);
-}
-
-/*
- * surgescript_tagsystem_foreach_tagged_object()
- * For each object tagged tag_name, calls callback(object_name, data)
- */
-void surgescript_tagsystem_foreach_tagged_object(const surgescript_tagsystem_t* tag_system, const char* tag_name, void* data, void (*callback)(const char*,void*))
-{
-    surgescript_inversetagtable_t* ientry = NULL;
-
-    HASH_FIND(hh, tag_system->inverse_tag_table, tag_name, strlen(tag_name), ientry);
-    if(ientry != NULL) {
-        /* objects are called in alphabetical order */
-        traverse_tree(ientry->objects, data, callback);
-    }
-}
-
-
-
-/* private stuff */
-
 /* adds a tag to the tag tree */
 surgescript_tagtree_t* add_to_tree(surgescript_tagtree_t* tree, const char* key)
 {
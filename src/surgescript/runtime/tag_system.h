@@ -26,6 +26,7 @@ typedef struct surgescript_tagsystem_t surgescript_tagsystem_t;
 
 /* tag system */
 surgescript_tagsystem_t* surgescript_tagsystem_create();
+surgescript_tagsystem_t* surgescript_tagsystem_create_shared(surgescript_tagsystem_t* source); /* creates a tag system that shares the tags of source (copy-on-write) */
 surgescript_tagsystem_t* surgescript_tagsystem_destroy(surgescript_tagsystem_t* tag_system);
 
 /* add & check tags */
@@ -26,52 +26,45 @@
 #include <limits.h>
 #include <float.h>
 #include <ctype.h>
+#include <stddef.h>
 #include "variable.h"
 #include "object.h"
 #include "object_manager.h"
 #include "../util/util.h"
 #include "../util/utf8.h"
+#define XXH_INLINE_ALL
+#include "../util/xxhash.h"
 
 
 /* private stuff */
 
-/* possible variable types */
-enum surgescript_vartype_t {
-    SSVAR_NULL,
-    SSVAR_BOOL,
-    SSVAR_NUMBER,
-    SSVAR_STRING,
-    SSVAR_OBJECTHANDLE,
-    SSVAR_RAW,
-};
+/* type codes */
 static const int typecode[] = { 0, 'b', 'n', 's', 'o', 'r' };
 
-/* the variable struct */
-struct surgescript_var_t
-{
-    /* data */
-    union {
-        char* string;
-        double number;
-        unsigned handle:32;
-        bool boolean;
-        int64_t raw;
-    };
-
-    /* metadata */
-    enum surgescript_vartype_t type;
-};
+/* variables are compact, so that they can be stored inline in arrays */
+_Static_assert(sizeof(surgescript_var_t) == 16, "surgescript_var_t must be 16 bytes long");
+_Static_assert(SSVAR_NULL == 0, "a zero-filled surgescript_var_t must be null");
 
 /* var pool */
 /*#define DISABLE_VARPOOL*/
-#ifndef DISABLE_VARPOOL
 #define VARPOOL_NUM_BUCKETS 2730
 
-typedef struct surgescript_varpool_t surgescript_varpool_t;
+typedef struct surgescript_varchunk_t surgescript_varchunk_t;
 typedef struct surgescript_varbucket_t surgescript_varbucket_t;
 struct surgescript_varpool_t
 {
-    /* a pool is a collection of buckets */
+    /* a pool is a collection of chunks */
+    surgescript_varchunk_t* chunk; /* linked list of chunks */
+    surgescript_varbucket_t* free; /* free list of buckets */
+    size_t num_chunks; /* number of chunks */
+    size_t in_use; /* number of buckets in use */
+    size_t peak; /* peak of in_use */
+};
+
+#ifndef DISABLE_VARPOOL
+struct surgescript_varchunk_t
+{
+    /* a chunk is a collection of buckets */
     struct surgescript_varbucket_t {
         union {
             /* the 1st element of the bucket (var) shares
@@ -79,24 +72,46 @@ struct surgescript_varpool_t
             surgescript_var_t var; /* var data */
             surgescript_varbucket_t* next; /* free list */
         };
+        surgescript_varchunk_t* chunk; /* the chunk that owns this bucket */
         bool in_use; /* is this bucket currently in use? */
     } bucket[VARPOOL_NUM_BUCKETS];
 
-    surgescript_varpool_t* next;
+    surgescript_varpool_t* pool; /* the pool that owns this chunk */
+    int used; /* number of buckets of this chunk that are in use */
+    surgescript_varchunk_t* next;
 };
-static surgescript_varpool_t* new_varpool(surgescript_varpool_t* next);
-static surgescript_varpool_t* delete_varpools(surgescript_varpool_t* head);
-static surgescript_varbucket_t* get_1stbucket(surgescript_varpool_t* pool);
-static inline surgescript_varbucket_t* allocate_bucket();
+static surgescript_varchunk_t* new_varchunk(surgescript_varpool_t* pool);
+static surgescript_varchunk_t* delete_varchunks(surgescript_varchunk_t* head);
+static inline surgescript_varbucket_t* allocate_bucket(surgescript_varpool_t* pool);
 static inline void free_bucket(surgescript_varbucket_t* bucket);
-static surgescript_varpool_t* varpool = NULL;
-static surgescript_varbucket_t* varpool_currbucket = NULL;
-
 #endif
 
+/* each thread uses its own pool: the pool of the VM it's running, or a default one */
+static SS_THREADLOCAL surgescript_varpool_t* current_varpool = NULL;
+static SS_THREADLOCAL surgescript_varpool_t* default_varpool = NULL;
+
+/* strings are immutable and shared among variables (reference counting).
+   var->string points to the data field of a surgescript_varstring_t */
+typedef struct surgescript_varstring_t surgescript_varstring_t;
+struct surgescript_varstring_t
+{
+    unsigned refcount; /* how many variables share this string (IMMORTAL if not reference counted) */
+    unsigned length; /* length in bytes */
+    unsigned utf8_length; /* length in (UTF-8) characters */
+    unsigned hash; /* cached hash; 0 if not yet computed */
+    bool ascii; /* is this a pure ASCII string? (if so, byte offsets and character indices match) */
+    char data[]; /* zero-terminated, valid UTF-8 */
+};
+#define VARSTRING(str) ((surgescript_varstring_t*)((str) - offsetof(surgescript_varstring_t, data)))
+#define IMMORTAL UINT_MAX /* immortal strings may be shared among threads */
+static surgescript_varstring_t* new_varstring(const char* string, size_t length);
+static inline char* retain_varstring(char* string);
+static inline void release_varstring(char* string);
+static inline unsigned varstring_hash(surgescript_varstring_t* str);
+
 /* helpers */
 #define RELEASE_DATA(var)       if((var)->type == SSVAR_STRING) \
-                                    (var)->string = ssfree((var)->string); \
+                                    release_varstring((var)->string); \
                                 (var)->raw = 0; /* must clear all bits */
 static inline bool is_number(const char* str);
 static inline void convert_to_ascii(char* str);
@@ -114,7 +129,14 @@ static inline void convert_to_ascii(char* str);
 surgescript_var_t* surgescript_var_create()
 {
 #ifndef DISABLE_VARPOOL
-    surgescript_var_t* var = (surgescript_var_t*)allocate_bucket();
+    surgescript_var_t* var;
+
+    if(current_varpool == NULL) {
+        surgescript_var_init_pool();
+        current_varpool = default_varpool;
+    }
+
+    var = (surgescript_var_t*)allocate_bucket(current_varpool);
     var->type = SSVAR_NULL;
     var->raw = 0;
     return var;
@@ -190,25 +212,53 @@ surgescript_var_t* surgescript_var_set_number(surgescript_var_t* var, double num
  */
 surgescript_var_t* surgescript_var_set_string(surgescript_var_t* var, const char* string)
 {
-    static const int MAXLEN = 1048576 - 1; /* 1 MB */
+    static const size_t MAXLEN = 1048576 - 1; /* 1 MB */
+    size_t length = (string != NULL) ? strlen(string) : 0;
+    char* data;
 
-    RELEASE_DATA(var);
-    if(string != NULL && strlen(string) <= MAXLEN) {
-        var->type = SSVAR_STRING;
-        var->string = ssstrdup(string);
-        if(!u8_isvalid(var->string, strlen(var->string)))
-            convert_to_ascii(var->string);
-    }
-    else if(string == NULL) {
-        var->type = SSVAR_STRING;
-        var->string = ssstrdup("");
-    }
-    else {
+    if(length > MAXLEN) {
         static char buf[128];
         surgescript_util_strncpy(buf, string, sizeof(buf));
         ssfatal("Runtime Error: string \"%s...\" is too large!", buf);
     }
 
+    data = new_varstring(string ? string : "", length)->data; /* string may be shared with var */
+    RELEASE_DATA(var);
+    var->type = SSVAR_STRING;
+    var->string = data;
+    return var;
+}
+
+/*
+ * surgescript_var_set_immortal_string()
+ * Sets the variable to an immortal string, i.e., one that isn't reference
+ * counted. Copies of var may then be made on multiple threads. The string
+ * lives until surgescript_var_release_immortal_string() is called
+ */
+surgescript_var_t* surgescript_var_set_immortal_string(surgescript_var_t* var, const char* string)
+{
+    surgescript_varstring_t* str;
+
+    surgescript_var_set_string(var, string);
+    str = VARSTRING(var->string);
+    str->refcount = IMMORTAL;
+    varstring_hash(str); /* the hash won't be computed lazily */
+
+    return var;
+}
+
+/*
+ * surgescript_var_release_immortal_string()
+ * Releases an immortal string stored in var, setting var to null. Make sure
+ * that no other variable stores the same string
+ */
+surgescript_var_t* surgescript_var_release_immortal_string(surgescript_var_t* var)
+{
+    if(var->type == SSVAR_STRING && VARSTRING(var->string)->refcount == IMMORTAL)
+        ssfree(VARSTRING(var->string));
+
+    var->type = SSVAR_NULL;
+    var->raw = 0;
     return var;
 }
 
@@ -382,7 +432,7 @@ surgescript_var_t* surgescript_var_copy(surgescript_var_t* dst, const surgescrip
             dst->number = src->number;
             break;
         case SSVAR_STRING:
-            dst->string = ssstrdup(src->string);
+            dst->string = retain_varstring(src->string); /* strings are immutable */
             break;
         case SSVAR_OBJECTHANDLE:
             dst->handle = src->handle;
@@ -509,6 +559,56 @@ const char* surgescript_var_fast_get_string(const surgescript_var_t* var)
     return var->type == SSVAR_STRING ? var->string : "";
 }
 
+/*
+ * surgescript_var_fast_get_string_length()
+ * gets the length, in UTF-8 characters, of a string variable (returns 0 if var is not a string)
+ */
+size_t surgescript_var_fast_get_string_length(const surgescript_var_t* var)
+{
+    return var->type == SSVAR_STRING ? VARSTRING(var->string)->utf8_length : 0;
+}
+
+/*
+ * surgescript_var_fast_get_string_offset()
+ * gets the byte offset of the index-th UTF-8 character of a string variable
+ * (index is clipped to the length of the string; returns 0 if var is not a string)
+ */
+size_t surgescript_var_fast_get_string_offset(const surgescript_var_t* var, size_t index)
+{
+    if(var->type == SSVAR_STRING) {
+        const surgescript_varstring_t* str = VARSTRING(var->string);
+        if(index >= str->utf8_length)
+            return str->length;
+        else if(str->ascii)
+            return index;
+        else
+            return u8_offset(var->string, index);
+    }
+
+    return 0;
+}
+
+/*
+ * surgescript_var_string_equals()
+ * Are a and b strings with the same contents? Faster than comparing them with surgescript_var_compare()
+ */
+bool surgescript_var_string_equals(const surgescript_var_t* a, const surgescript_var_t* b)
+{
+    surgescript_varstring_t *x, *y;
+
+    if(a->type != SSVAR_STRING || b->type != SSVAR_STRING)
+        return false;
+    else if(a->string == b->string)
+        return true;
+
+    x = VARSTRING(a->string);
+    y = VARSTRING(b->string);
+    if(x->length != y->length || varstring_hash(x) != varstring_hash(y))
+        return false;
+
+    return memcmp(x->data, y->data, x->length) == 0;
+}
+
 /*
  * surgescript_var_compare()
  * Compares a to b. Returns:
@@ -527,7 +627,7 @@ int surgescript_var_compare(const surgescript_var_t* a, const surgescript_var_t*
             case SSVAR_OBJECTHANDLE:
                 return (a->handle > b->handle) - (a->handle < b->handle);
             case SSVAR_STRING:
-                return strcmp(a->string, b->string);
+                return (a->string != b->string) ? strcmp(a->string, b->string) : 0;
             case SSVAR_NUMBER: {
                 /* encourage users to use approximatelyEqual() */
                 /* epsilon comparisons may cause underlying problems, e.g., with infinity */
@@ -616,7 +716,7 @@ surgescript_var_t* surgescript_var_set_rawbits(surgescript_var_t* var, int64_t r
 size_t surgescript_var_size(const surgescript_var_t* var)
 {
     if(var->type == SSVAR_STRING)
-        return sizeof(surgescript_var_t) + (1 + strlen(var->string)) * sizeof(char);
+        return sizeof(surgescript_var_t) + (1 + VARSTRING(var->string)->length) * sizeof(char);
     else
         return sizeof(surgescript_var_t);
 }
@@ -628,33 +728,144 @@ size_t surgescript_var_size(const surgescript_var_t* var)
 /* var pooling */
 
 /*
- * surgescript_var_init_pool()
- * Initializes the pool
+ * surgescript_varpool_create()
+ * Creates a new, empty pool of variables. Variables are allocated
+ * from the current pool of the calling thread (see surgescript_varpool_make_current())
  */
-void surgescript_var_init_pool()
+surgescript_varpool_t* surgescript_varpool_create()
+{
+    surgescript_varpool_t* pool = ssmalloc(sizeof *pool);
+
+#ifdef DISABLE_VARPOOL
+    sslog("Warning: SurgeScript has been compiled with disabled var pooling.");
+#endif
+
+    pool->chunk = NULL;
+    pool->free = NULL;
+    pool->num_chunks = 0;
+    pool->in_use = 0;
+    pool->peak = 0;
+
+    return pool;
+}
+
+/*
+ * surgescript_varpool_destroy()
+ * Destroys a pool of variables. All variables allocated from it must no longer be used
+ */
+surgescript_varpool_t* surgescript_varpool_destroy(surgescript_varpool_t* pool)
 {
+    if(current_varpool == pool)
+        current_varpool = NULL;
+    if(default_varpool == pool)
+        default_varpool = NULL;
+
 #ifndef DISABLE_VARPOOL
-    if(varpool == NULL) {
-        varpool = new_varpool(NULL);
-        varpool_currbucket = get_1stbucket(varpool);
+    if(pool->chunk != NULL)
+        delete_varchunks(pool->chunk);
+#endif
+
+    return ssfree(pool);
+}
+
+/*
+ * surgescript_varpool_make_current()
+ * Variables created by the calling thread will be allocated from the given pool.
+ * Returns the previous pool of the thread, possibly NULL
+ */
+surgescript_varpool_t* surgescript_varpool_make_current(surgescript_varpool_t* pool)
+{
+    surgescript_varpool_t* previous = current_varpool;
+    current_varpool = pool;
+    return previous;
+}
+
+/*
+ * surgescript_varpool_current()
+ * The current pool of the calling thread, possibly NULL
+ */
+surgescript_varpool_t* surgescript_varpool_current()
+{
+    return current_varpool;
+}
+
+/*
+ * surgescript_varpool_trim()
+ * Releases the chunks of memory of the pool that hold no variables.
+ * Returns the number of released chunks
+ */
+size_t surgescript_varpool_trim(surgescript_varpool_t* pool)
+{
+    size_t count = 0;
+
+#ifndef DISABLE_VARPOOL
+    surgescript_varchunk_t **it = &(pool->chunk), *chunk;
+
+    /* release the unused chunks */
+    while((chunk = *it) != NULL) {
+        if(chunk->used == 0) {
+            *it = chunk->next;
+            ssfree(chunk);
+            count++;
+        }
+        else
+            it = &(chunk->next);
+    }
+
+    /* rebuild the free list */
+    if(count > 0) {
+        pool->free = NULL;
+        pool->num_chunks -= count;
+        for(chunk = pool->chunk; chunk != NULL; chunk = chunk->next) {
+            for(int i = VARPOOL_NUM_BUCKETS - 1; i >= 0; i--) {
+                if(!chunk->bucket[i].in_use) {
+                    chunk->bucket[i].next = pool->free;
+                    pool->free = &(chunk->bucket[i]);
+                }
+            }
+        }
+        sslog("Released %lu chunk(s) of the var pool", (unsigned long)count);
     }
+#endif
+
+    return count;
+}
+
+/*
+ * surgescript_varpool_get_stats()
+ * Gets statistics of the pool
+ */
+void surgescript_varpool_get_stats(const surgescript_varpool_t* pool, surgescript_varpool_stats_t* stats)
+{
+    stats->chunks = pool->num_chunks;
+    stats->capacity = pool->num_chunks * VARPOOL_NUM_BUCKETS;
+    stats->in_use = pool->in_use;
+    stats->peak = pool->peak;
+#ifndef DISABLE_VARPOOL
+    stats->bytes = sizeof(*pool) + pool->num_chunks * sizeof(surgescript_varchunk_t);
 #else
-    sslog("Warning: SurgeScript has been compiled with disabled var pooling.");
+    stats->bytes = sizeof(*pool);
 #endif
 }
 
+/*
+ * surgescript_var_init_pool()
+ * Initializes the default pool of the calling thread
+ */
+void surgescript_var_init_pool()
+{
+    if(default_varpool == NULL)
+        default_varpool = surgescript_varpool_create();
+}
+
 /*
  * surgescript_var_release_pool()
- * Releases the pool
+ * Releases the default pool of the calling thread
  */
 void surgescript_var_release_pool()
 {
-#ifndef DISABLE_VARPOOL
-    if(varpool != NULL) {
-        varpool_currbucket = NULL;
-        varpool = delete_varpools(varpool);
-    }
-#endif
+    if(default_varpool != NULL)
+        surgescript_varpool_destroy(default_varpool);
 }
 
 
@@ -703,55 +914,122 @@ void convert_to_ascii(char* str)
     *q = 0;
 }
 
+/* creates a new string with refcount = 1, given its contents and its length in bytes */
+surgescript_varstring_t* new_varstring(const char* string, size_t length)
+{
+    surgescript_varstring_t* str = ssmalloc(sizeof(*str) + (length + 1) * sizeof(char));
+    unsigned utf8_length = 0;
+    bool ascii = true;
+
+    /* copy the data */
+    memcpy(str->data, string, length * sizeof(char));
+    str->data[length] = 0;
+
+    /* scan the string once */
+    for(size_t i = 0; i < length; i++) {
+        ascii = ascii && !(str->data[i] & 0x80);
+        utf8_length += ((str->data[i] & 0xC0) != 0x80); /* skip continuation bytes */
+    }
+
+    /* strings must be valid UTF-8 */
+    if(!ascii && !u8_isvalid(str->data, length)) {
+        convert_to_ascii(str->data);
+        utf8_length = length = strlen(str->data);
+        ascii = true;
+    }
+
+    /* done! */
+    str->refcount = 1;
+    str->length = length;
+    str->utf8_length = utf8_length;
+    str->hash = 0;
+    str->ascii = ascii;
+    return str;
+}
+
+/* shares an existing string (a pointer to its data), returning it */
+char* retain_varstring(char* string)
+{
+    surgescript_varstring_t* str = VARSTRING(string);
+    if(str->refcount != IMMORTAL)
+        str->refcount++;
+    return string;
+}
+
+/* releases a shared string (a pointer to its data) */
+void release_varstring(char* string)
+{
+    surgescript_varstring_t* str = VARSTRING(string);
+    if(str->refcount != IMMORTAL && --str->refcount == 0)
+        ssfree(str);
+}
+
+/* the (cached) hash of a string */
+unsigned varstring_hash(surgescript_varstring_t* str)
+{
+    if(str->hash == 0)
+        str->hash = XXH32(str->data, str->length, 0) | 1; /* never zero */
+    return str->hash;
+}
+
 /* private var pool routines */
 #ifndef DISABLE_VARPOOL
 
-/* Creates a new var pool */
-surgescript_varpool_t* new_varpool(surgescript_varpool_t* next)
+/* Creates a new chunk of buckets, adding them to the free list of the pool */
+surgescript_varchunk_t* new_varchunk(surgescript_varpool_t* pool)
 {
-    surgescript_varpool_t* pool;
-    sslog("Allocating a new var pool...");
+    surgescript_varchunk_t* chunk;
+    sslog("Allocating a new chunk of the var pool...");
 
-    pool = ssmalloc(sizeof *pool);
+    chunk = ssmalloc(sizeof *chunk);
     for(int i = 0; i < VARPOOL_NUM_BUCKETS - 1; i++) {
-        pool->bucket[i].next = &(pool->bucket[i + 1]);
-        pool->bucket[i].in_use = false;
+        chunk->bucket[i].next = &(chunk->bucket[i + 1]);
+        chunk->bucket[i].chunk = chunk;
+        chunk->bucket[i].in_use = false;
     }
-    pool->bucket[VARPOOL_NUM_BUCKETS - 1].next = NULL;
-    pool->bucket[VARPOOL_NUM_BUCKETS - 1].in_use = false;
-    pool->next = next;
-
-    return pool;
+    chunk->bucket[VARPOOL_NUM_BUCKETS - 1].next = pool->free;
+    chunk->bucket[VARPOOL_NUM_BUCKETS - 1].chunk = chunk;
+    chunk->bucket[VARPOOL_NUM_BUCKETS - 1].in_use = false;
+    chunk->pool = pool;
+    chunk->used = 0;
+
+    chunk->next = pool->chunk;
+    pool->chunk = chunk;
+    pool->free = &(chunk->bucket[0]);
+    pool->num_chunks++;
+
+    return chunk;
 }
 
-/* Deletes all var pools */
-surgescript_varpool_t* delete_varpools(surgescript_varpool_t* head)
+/* Deletes a list of chunks */
+surgescript_varchunk_t* delete_varchunks(surgescript_varchunk_t* head)
 {
-    if(head->next)
-        delete_varpools(head->next);
-    return ssfree(head);
-}
+    while(head != NULL) {
+        surgescript_varchunk_t* next = head->next;
+        ssfree(head);
+        head = next;
+    }
 
-/* Gets the 1st bucket of a pool */
-surgescript_varbucket_t* get_1stbucket(surgescript_varpool_t* pool)
-{
-    return &(pool->bucket[0]);
+    return NULL;
 }
 
 /* Allocates a bucket (must be fast) */
-surgescript_varbucket_t* allocate_bucket()
+surgescript_varbucket_t* allocate_bucket(surgescript_varpool_t* pool)
 {
-    surgescript_varbucket_t* bucket = varpool_currbucket;
-
-    /* consistency check */
-    /*ssassert(bucket && !bucket->in_use);*/
+    surgescript_varbucket_t* bucket;
 
     /* select bucket */
-    if(bucket->next == NULL)
-        bucket->next = get_1stbucket(varpool = new_varpool(varpool));
-    varpool_currbucket = bucket->next;
+    if(pool->free == NULL)
+        new_varchunk(pool);
+    bucket = pool->free;
+    pool->free = bucket->next;
     bucket->in_use = true;
 
+    /* update the stats */
+    bucket->chunk->used++;
+    if(++pool->in_use > pool->peak)
+        pool->peak = pool->in_use;
+
     /* done! */
     return bucket;
 }
@@ -759,13 +1037,20 @@ surgescript_varbucket_t* allocate_bucket()
 /* Deallocates a bucket (must be fast) */
 void free_bucket(surgescript_varbucket_t* bucket)
 {
+    /* the bucket goes back to the pool it came from */
+    surgescript_varpool_t* pool = bucket->chunk->pool;
+
     /* can't free if not in use */
     ssassert(bucket->in_use);
 
     /* put the bucket back in the pool */
     bucket->in_use = false;
-    bucket->next = varpool_currbucket;
-    varpool_currbucket = bucket;
+    bucket->next = pool->free;
+    pool->free = bucket;
+
+    /* update the stats */
+    bucket->chunk->used--;
+    pool->in_use--;
 }
 
 #endif
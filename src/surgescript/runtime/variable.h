@@ -29,6 +29,48 @@
 /* the variable type */
 typedef struct surgescript_var_t surgescript_var_t;
 
+/* possible variable types */
+enum surgescript_vartype_t {
+    SSVAR_NULL,
+    SSVAR_BOOL,
+    SSVAR_NUMBER,
+    SSVAR_STRING,
+    SSVAR_OBJECTHANDLE,
+    SSVAR_RAW,
+};
+
+/* the variable struct: a 16-byte tagged value. Variables may be stored inline
+   in arrays (a zero-filled variable is null), but please use the functions
+   below to read and write their contents */
+struct surgescript_var_t
+{
+    /* data */
+    union {
+        char* string; /* immutable & shared (reference counted) */
+        double number;
+        unsigned handle:32;
+        bool boolean;
+        int64_t raw;
+    };
+
+    /* metadata */
+    enum surgescript_vartype_t type;
+};
+
+/* a pool of variables */
+typedef struct surgescript_varpool_t surgescript_varpool_t;
+
+/* statistics of a pool of variables */
+typedef struct surgescript_varpool_stats_t surgescript_varpool_stats_t;
+struct surgescript_varpool_stats_t
+{
+    size_t chunks; /* number of allocated chunks of memory */
+    size_t capacity; /* how many variables fit in the allocated chunks */
+    size_t in_use; /* how many variables are currently in use */
+    size_t peak; /* the largest in_use since the creation of the pool */
+    size_t bytes; /* allocated memory, in bytes */
+};
+
 /* misc */
 struct surgescript_objectmanager_t;
 
@@ -54,6 +96,10 @@ surgescript_var_t* surgescript_var_set_number(surgescript_var_t* var, double num
 surgescript_var_t* surgescript_var_set_string(surgescript_var_t* var, const char* string);
 surgescript_var_t* surgescript_var_set_objecthandle(surgescript_var_t* var, unsigned handle);
 
+/* immortal strings aren't reference counted; copies of them may be made on multiple threads */
+surgescript_var_t* surgescript_var_set_immortal_string(surgescript_var_t* var, const char* string); /* sets var to an immortal string */
+surgescript_var_t* surgescript_var_release_immortal_string(surgescript_var_t* var); /* releases the immortal string stored in var, setting var to null */
+
 /* misc */
 int surgescript_var_typecode(const surgescript_var_t* var); /* the typecode */
 int surgescript_var_type2code(const char* type_name); /* typename -> typecode converter */
@@ -66,14 +112,28 @@ surgescript_var_t* surgescript_var_copy(surgescript_var_t* dst, const surgescrip
 surgescript_var_t* surgescript_var_clone(const surgescript_var_t* var); /* similar to strdup */
 char* surgescript_var_to_string(const surgescript_var_t* var, char* buf, size_t bufsize); /* copies var to buf and returns buf, converting var to string if necessary (similar to itoa / strncpy) */
 const char* surgescript_var_fast_get_string(const surgescript_var_t* var); /* gets the string contents of var without performing any type conversion */
+size_t surgescript_var_fast_get_string_length(const surgescript_var_t* var); /* the (cached) length of a string, in UTF-8 characters, without performing any type conversion */
+size_t surgescript_var_fast_get_string_offset(const surgescript_var_t* var, size_t index); /* the byte offset of the index-th UTF-8 character of a string */
+bool surgescript_var_string_equals(const surgescript_var_t* a, const surgescript_var_t* b); /* are a and b strings with the same contents? */
 int surgescript_var_compare(const surgescript_var_t* a, const surgescript_var_t* b); /* similar to strcmp */
 void surgescript_var_swap(surgescript_var_t* a, surgescript_var_t* b); /* swaps a <-> b */
 int64_t surgescript_var_get_rawbits(const surgescript_var_t* var); /* the binary value stored in var */
 surgescript_var_t* surgescript_var_set_rawbits(surgescript_var_t* var, int64_t raw); /* sets its binary value */
 size_t surgescript_var_size(const surgescript_var_t* var); /* used memory in user space, in bytes */
 
+/* fast access to numbers, without function calls */
+static inline bool surgescript_var_fast_is_number(const surgescript_var_t* var) { return var->type == SSVAR_NUMBER; }
+static inline double surgescript_var_fast_get_number(const surgescript_var_t* var) { return var->number; } /* var must be a number */
+static inline void surgescript_var_fast_set_number(surgescript_var_t* var, double number) { var->number = number; } /* var must be a number */
+
 /* var pooling */
-void surgescript_var_init_pool();
-void surgescript_var_release_pool();
+surgescript_varpool_t* surgescript_varpool_create(); /* creates a pool of variables */
+surgescript_varpool_t* surgescript_varpool_destroy(surgescript_varpool_t* pool); /* destroys a pool and all variables allocated from it */
+surgescript_varpool_t* surgescript_varpool_make_current(surgescript_varpool_t* pool); /* the calling thread will allocate variables from pool; returns the previous pool */
+surgescript_varpool_t* surgescript_varpool_current(); /* the current pool of the calling thread, possibly NULL */
+size_t surgescript_varpool_trim(surgescript_varpool_t* pool); /* releases unused memory; returns the number of released chunks */
+void surgescript_varpool_get_stats(const surgescript_varpool_t* pool, surgescript_varpool_stats_t* stats); /* gets statistics */
+void surgescript_var_init_pool(); /* initializes the default pool of the calling thread */
+void surgescript_var_release_pool(); /* releases the default pool of the calling thread */
 
 #endif
@@ -30,6 +30,9 @@
 #include "vm_time.h"
 #include "sslib/sslib.h"
 #include "../compiler/parser.h"
+#include "../compiler/bytecode.h"
+#include "../compiler/batch.h"
+#include "../util/ssarray.h"
 #include "../util/util.h"
 
 
@@ -43,6 +46,14 @@ struct surgescript_vm_updater_t {
     void (*late_update)(surgescript_object_t*,void*); /* runs immediately after surgescript_object_update() */
 };
 
+/* the layouts of the variables of the objects of each class, before a hot reload */
+typedef struct surgescript_vm_layouts_t surgescript_vm_layouts_t;
+struct surgescript_vm_layouts_t {
+    SSARRAY(surgescript_objectlayout_t*, layout); /* layout[class_id] */
+    SSARRAY(bool, saved); /* saved[class_id] is true if layout[class_id] has been taken (it may be NULL) */
+    SSARRAY(surgescript_objecthandle_t, object); /* the objects that existed before the reload */
+};
+
 /* VM command-line arguments */
 typedef struct surgescript_vmargs_t surgescript_vmargs_t;
 struct surgescript_vmargs_t {
@@ -64,16 +75,23 @@ struct surgescript_vm_t
     surgescript_parser_t* parser;
     surgescript_vmargs_t* args;
     surgescript_vmtime_t* time;
+    surgescript_varpool_t* varpool;
     bool is_paused;
 };
 
 /* misc */
-static void init_vm(surgescript_vm_t* vm);
+static void init_vm(surgescript_vm_t* vm, surgescript_vm_t* model);
 static void release_vm(surgescript_vm_t* vm);
 static bool call_updater1(surgescript_object_t* object, void* updater);
 static bool call_updater2(surgescript_object_t* object, void* updater);
 static bool call_updater3(surgescript_object_t* object, void* updater);
 static void install_plugin(const char* object_name, void* data);
+static bool save_layout(surgescript_object_t* object, void* layouts);
+static void reload_object(surgescript_object_t* object, const surgescript_vm_layouts_t* layouts);
+
+/* the variables created while running the VM are allocated from its own pool */
+#define ENTER_VM(vm)    surgescript_varpool_t* previous_varpool_ = surgescript_varpool_make_current((vm)->varpool)
+#define LEAVE_VM(vm)    surgescript_varpool_make_current(previous_varpool_)
 
 
 /*
@@ -89,8 +107,44 @@ surgescript_vm_t* surgescript_vm_create()
 
     /* set up the VM */
     sslog("Creating the VM...");
-    surgescript_var_init_pool();
-    init_vm(vm);
+    vm->varpool = surgescript_varpool_create();
+    ENTER_VM(vm);
+    init_vm(vm, NULL);
+    LEAVE_VM(vm);
+
+    /* done! */
+    return vm;
+}
+
+/*
+ * surgescript_vm_create_shared()
+ * Creates a VM that shares the compiled code of another VM (the model),
+ * i.e., its programs (including those of the standard library and the C
+ * functions bound to it) and its tags. This is much cheaper than creating
+ * a VM and compiling the same scripts again. The shared programs may be run
+ * on multiple threads. Compiling more code or binding functions later on
+ * will affect only the VM that does it (copy-on-write). The plugins found
+ * by the compiler of the model are installed in the new VM, but not those
+ * installed with surgescript_vm_install_plugin(). The model must not be in
+ * use by another thread during this call.
+ *
+ * The model keeps running its own programs at full speed. The VMs created
+ * from it share a read-only copy of them, made once for all of them, which
+ * they don't quicken or compile to machine code. Sharing thus trades some
+ * of their speed for memory and startup time (see
+ * surgescript_program_make_shareable()). Programs compiled later on by a
+ * VM are private to it and don't have this cost
+ */
+surgescript_vm_t* surgescript_vm_create_shared(surgescript_vm_t* model)
+{
+    surgescript_vm_t* vm = ssmalloc(sizeof *vm);
+
+    /* set up the VM */
+    sslog("Creating a VM that shares the code of another...");
+    vm->varpool = surgescript_varpool_create();
+    ENTER_VM(vm);
+    init_vm(vm, model);
+    LEAVE_VM(vm);
 
     /* done! */
     return vm;
@@ -103,8 +157,10 @@ surgescript_vm_t* surgescript_vm_create()
 surgescript_vm_t* surgescript_vm_destroy(surgescript_vm_t* vm)
 {
     sslog("Shutting down the VM...");
+    ENTER_VM(vm);
     release_vm(vm);
-    surgescript_var_release_pool();
+    LEAVE_VM(vm);
+    surgescript_varpool_destroy(vm->varpool);
     return ssfree(vm);
 }
 
@@ -117,17 +173,19 @@ bool surgescript_vm_reset(surgescript_vm_t* vm)
     sslog("Will reset the VM...");
 
     if(surgescript_vm_is_active(vm)) {
+        ENTER_VM(vm);
+
         /* shut down */
         sslog("Shutting down the VM...");
         release_vm(vm);
-        surgescript_var_release_pool();
 
         /* set up the VM again */
         sslog("Starting the VM again...");
-        surgescript_var_init_pool();
-        init_vm(vm);
+        surgescript_varpool_trim(vm->varpool);
+        init_vm(vm, NULL);
 
         /* done */
+        LEAVE_VM(vm);
         return true;
     }
     else {
@@ -143,7 +201,31 @@ bool surgescript_vm_reset(surgescript_vm_t* vm)
  */
 bool surgescript_vm_compile(surgescript_vm_t* vm, const char* absolute_path)
 {
-    return surgescript_parser_parsefile(vm->parser, absolute_path);
+    bool success;
+
+    ENTER_VM(vm);
+    success = surgescript_parser_parsefile(vm->parser, absolute_path);
+    LEAVE_VM(vm);
+
+    return success;
+}
+
+/*
+ * surgescript_vm_compile_batch()
+ * Compiles many files at once, parsing them on num_threads threads
+ * (if zero, one per CPU core). The result is the same as compiling
+ * them one by one, in order, with surgescript_vm_compile()
+ * Returns true on success; false otherwise
+ */
+bool surgescript_vm_compile_batch(surgescript_vm_t* vm, const char** absolute_paths, int count, int num_threads)
+{
+    bool success;
+
+    ENTER_VM(vm);
+    success = surgescript_batch_parsefiles(vm->parser, vm->program_pool, vm->tag_system, absolute_paths, count, num_threads);
+    LEAVE_VM(vm);
+
+    return success;
 }
 
 /*
@@ -153,7 +235,92 @@ bool surgescript_vm_compile(surgescript_vm_t* vm, const char* absolute_path)
  */
 bool surgescript_vm_compile_code_in_memory(surgescript_vm_t* vm, const char* code)
 {
-    return surgescript_parser_parsemem(vm->parser, code);
+    bool success;
+
+    ENTER_VM(vm);
+    success = surgescript_parser_parsemem(vm->parser, code);
+    LEAVE_VM(vm);
+
+    return success;
+}
+
+/*
+ * surgescript_vm_reload()
+ * Compiles a file again, replacing the code of the objects it defines
+ * (hot reload). Existing objects keep running with the new code, keeping
+ * their state and their variables (see surgescript_object_reload()).
+ * This must not be called while the VM is being updated
+ * Returns true on success; false otherwise
+ */
+bool surgescript_vm_reload(surgescript_vm_t* vm, const char* absolute_path)
+{
+    surgescript_parser_flags_t flags = surgescript_parser_get_flags(vm->parser);
+    surgescript_vm_layouts_t layouts;
+    bool success;
+
+    ENTER_VM(vm);
+
+    /* the variables of the objects will be matched by name with the new code */
+    ssarray_init(layouts.layout);
+    ssarray_init(layouts.saved);
+    ssarray_init(layouts.object);
+    if(surgescript_vm_is_active(vm))
+        surgescript_object_traverse_tree_ex(surgescript_vm_root_object(vm), &layouts, save_layout);
+
+    /* compile */
+    surgescript_parser_set_flags(vm->parser, flags | SSPARSER_REPLACE_DUPLICATES);
+    success = surgescript_parser_parsefile(vm->parser, absolute_path);
+    surgescript_parser_set_flags(vm->parser, flags);
+
+    /* the programs of the objects may have changed */
+    for(int i = 0; i < ssarray_length(layouts.object); i++) {
+        if(surgescript_objectmanager_exists(vm->object_manager, layouts.object[i]))
+            reload_object(surgescript_objectmanager_get(vm->object_manager, layouts.object[i]), &layouts);
+    }
+
+    for(int i = 0; i < ssarray_length(layouts.layout); i++) {
+        if(layouts.layout[i] != NULL)
+            surgescript_objectlayout_destroy(layouts.layout[i]);
+    }
+    ssarray_release(layouts.object);
+    ssarray_release(layouts.saved);
+    ssarray_release(layouts.layout);
+
+    LEAVE_VM(vm);
+    return success;
+}
+
+/*
+ * surgescript_vm_load_bytecode()
+ * Loads scripts precompiled with surgescript_vm_save_bytecode()
+ * Returns true on success; false if the file is invalid or incompatible
+ */
+bool surgescript_vm_load_bytecode(surgescript_vm_t* vm, const char* absolute_path)
+{
+    bool success;
+
+    ENTER_VM(vm);
+    success = surgescript_bytecode_load(absolute_path, vm->program_pool, vm->tag_system, vm->parser);
+    LEAVE_VM(vm);
+
+    return success;
+}
+
+/*
+ * surgescript_vm_save_bytecode()
+ * Saves the scripts compiled so far to a file, so that they can be
+ * loaded later without being parsed again
+ * Returns true on success; false otherwise
+ */
+bool surgescript_vm_save_bytecode(surgescript_vm_t* vm, const char* absolute_path)
+{
+    bool success;
+
+    ENTER_VM(vm);
+    success = surgescript_bytecode_save(absolute_path, vm->program_pool, vm->tag_system, vm->parser);
+    LEAVE_VM(vm);
+
+    return success;
 }
 
 /*
@@ -175,11 +342,16 @@ void surgescript_vm_launch_ex(surgescript_vm_t* vm, int argc, char** argv)
     if(surgescript_vm_is_active(vm))
         return;
 
+    /* Allocate variables from the pool of this VM */
+    ENTER_VM(vm);
+
     /* SurgeScript uses UTF-8 */
     setlocale(LC_ALL, "en_US.UTF-8");
 
-    /* Setup the pseudo-number generator */
-    surgescript_util_srand(time(NULL));
+    /* Setup the pseudo-number generator of this VM, unless the host has seeded it */
+    surgescript_prng_t* prng = surgescript_objectmanager_prng(vm->object_manager);
+    if(!(prng->state[0] | prng->state[1]))
+        surgescript_util_prng_seed(prng, (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)vm);
 
     /* Setup the command line arguments */
     surgescript_vmargs_configure(vm->args, argc, argv);
@@ -189,6 +361,19 @@ void surgescript_vm_launch_ex(surgescript_vm_t* vm, int argc, char** argv)
 
     /* Create the root object */
     surgescript_objectmanager_spawn_root(vm->object_manager);
+
+    /* done */
+    LEAVE_VM(vm);
+}
+
+/*
+ * surgescript_vm_srand()
+ * Seeds the pseudo-random number generator of the VM. If you call this
+ * before launching the VM, the random numbers will be reproducible
+ */
+void surgescript_vm_srand(surgescript_vm_t* vm, uint64_t seed)
+{
+    surgescript_util_prng_seed(surgescript_objectmanager_prng(vm->object_manager), seed);
 }
 
 /*
@@ -220,6 +405,10 @@ bool surgescript_vm_update_ex(surgescript_vm_t* vm, void* user_data, void (*user
     if(surgescript_vm_is_active(vm) && !vm->is_paused) {
         surgescript_object_t* root = surgescript_vm_root_object(vm);
         surgescript_vm_updater_t updater = { user_data, user_update, late_update };
+        bool is_active;
+
+        /* allocate variables from the pool of this VM */
+        ENTER_VM(vm);
 
         /* update time */
         surgescript_vmtime_update(vm->time);
@@ -235,7 +424,9 @@ bool surgescript_vm_update_ex(surgescript_vm_t* vm, void* user_data, void (*user
             surgescript_object_traverse_tree(root, surgescript_object_update);
 
         /* done! */
-        return surgescript_vm_is_active(vm);
+        is_active = surgescript_vm_is_active(vm);
+        LEAVE_VM(vm);
+        return is_active;
     }
     else {
         /* return true if the VM is still on */
@@ -346,6 +537,15 @@ const surgescript_vmtime_t* surgescript_vm_time(const surgescript_vm_t* vm)
     return vm->time;
 }
 
+/*
+ * surgescript_vm_varpool()
+ * Gets the pool of variables of the VM
+ */
+surgescript_varpool_t* surgescript_vm_varpool(const surgescript_vm_t* vm)
+{
+    return vm->varpool;
+}
+
 /*
  * surgescript_vm_root_object()
  * Gets the root object
@@ -363,7 +563,12 @@ surgescript_object_t* surgescript_vm_root_object(surgescript_vm_t* vm)
 surgescript_object_t* surgescript_vm_spawn_object(surgescript_vm_t* vm, surgescript_object_t* parent, const char* object_name, void* user_data)
 {
     surgescript_objecthandle_t parent_handle = surgescript_object_handle(parent);
-    surgescript_objecthandle_t child_handle = surgescript_objectmanager_spawn(vm->object_manager, parent_handle, object_name, user_data);
+    surgescript_objecthandle_t child_handle;
+
+    ENTER_VM(vm);
+    child_handle = surgescript_objectmanager_spawn(vm->object_manager, parent_handle, object_name, user_data);
+    LEAVE_VM(vm);
+
     return surgescript_objectmanager_get(vm->object_manager, child_handle);
 }
 
@@ -400,20 +605,26 @@ void surgescript_vm_install_plugin(surgescript_vm_t* vm, const char* object_name
 
 /* ----- private ----- */
 
-/* initializes the VM */
-void init_vm(surgescript_vm_t* vm)
+/* initializes the VM. If model isn't NULL, share its compiled code */
+void init_vm(surgescript_vm_t* vm, surgescript_vm_t* model)
 {
     vm->is_paused = false;
 
     /* create the VM components */
     vm->stack = surgescript_stack_create();
-    vm->program_pool = surgescript_programpool_create();
-    vm->tag_system = surgescript_tagsystem_create();
+    vm->program_pool = model ? surgescript_programpool_create_shared(model->program_pool) : surgescript_programpool_create();
+    vm->tag_system = model ? surgescript_tagsystem_create_shared(model->tag_system) : surgescript_tagsystem_create();
     vm->args = surgescript_vmargs_create();
     vm->time = surgescript_vmtime_create();
     vm->object_manager = surgescript_objectmanager_create(vm->program_pool, vm->tag_system, vm->stack, vm->args, vm->time);
     vm->parser = surgescript_parser_create(vm->program_pool, vm->tag_system);
 
+    /* the code of the model includes the standard library */
+    if(model != NULL) {
+        surgescript_parser_foreach_plugin(model->parser, vm, install_plugin);
+        return;
+    }
+
     /* load the SurgeScript standard library */
     surgescript_sslib_register_object(vm);
     surgescript_sslib_register_string(vm);
@@ -438,14 +649,15 @@ void init_vm(surgescript_vm_t* vm)
 /* releases the VM */
 void release_vm(surgescript_vm_t* vm)
 {
-    /* destroy the VM components */
+    /* destroy the VM components (the stack may hold
+       strings that belong to the programs of the pool) */
     surgescript_parser_destroy(vm->parser);
     surgescript_objectmanager_destroy(vm->object_manager);
     surgescript_vmtime_destroy(vm->time);
     surgescript_vmargs_destroy(vm->args);
+    surgescript_stack_destroy(vm->stack);
     surgescript_tagsystem_destroy(vm->tag_system);
     surgescript_programpool_destroy(vm->program_pool);
-    surgescript_stack_destroy(vm->stack);
 }
 
 /* these auxiliary functions help traversing the object tree */
@@ -494,6 +706,39 @@ void install_plugin(const char* object_name, void* data)
     surgescript_objectmanager_install_plugin(vm->object_manager, object_name);
 }
 
+/* takes the layout of the variables of the class of an object, before a hot reload */
+bool save_layout(surgescript_object_t* object, void* data)
+{
+    surgescript_vm_layouts_t* layouts = (surgescript_vm_layouts_t*)data;
+    int class_id = surgescript_object_class_id(object);
+
+    while(ssarray_length(layouts->saved) <= class_id) {
+        ssarray_push(layouts->layout, NULL);
+        ssarray_push(layouts->saved, false);
+    }
+
+    if(!layouts->saved[class_id]) {
+        layouts->layout[class_id] = surgescript_object_layout(object);
+        layouts->saved[class_id] = true;
+    }
+
+    /* objects spawned during the reload already run the new code */
+    ssarray_push(layouts->object, surgescript_object_handle(object));
+    return true;
+}
+
+/* picks up the new code of an object after a hot reload */
+void reload_object(surgescript_object_t* object, const surgescript_vm_layouts_t* layouts)
+{
+    int class_id = surgescript_object_class_id(object);
+    const surgescript_objectlayout_t* old_layout = NULL;
+
+    if(class_id < ssarray_length(layouts->layout))
+        old_layout = layouts->layout[class_id];
+
+    surgescript_object_reload(object, old_layout);
+}
+
 /* VM command-line arguments */
 surgescript_vmargs_t* surgescript_vmargs_create()
 {
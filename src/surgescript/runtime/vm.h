@@ -35,19 +35,26 @@ struct surgescript_objectmanager_t;
 struct surgescript_tagsystem_t;
 struct surgescript_vmargs_t;
 struct surgescript_vmtime_t;
+struct surgescript_varpool_t;
 
 /* api */
 surgescript_vm_t* surgescript_vm_create();
+surgescript_vm_t* surgescript_vm_create_shared(surgescript_vm_t* model); /* creates a VM that shares the compiled code of the model (copy-on-write); the new VM runs a shared copy that is slower, while the model keeps its own (see surgescript_vm_create_shared() in vm.c) */
 surgescript_vm_t* surgescript_vm_destroy(surgescript_vm_t* vm);
 
 /* SurgeScript Compiler */
 bool surgescript_vm_compile(surgescript_vm_t* vm, const char* absolute_path); /* compiles a file */
+bool surgescript_vm_compile_batch(surgescript_vm_t* vm, const char** absolute_paths, int count, int num_threads); /* compiles many files on multiple threads (0 = one per CPU core) */
 bool surgescript_vm_compile_code_in_memory(surgescript_vm_t* vm, const char* code); /* compiles the given code */
+bool surgescript_vm_reload(surgescript_vm_t* vm, const char* absolute_path); /* compiles a file again, replacing the code of its objects (hot reload) */
+bool surgescript_vm_load_bytecode(surgescript_vm_t* vm, const char* absolute_path); /* loads precompiled scripts (.ssc) */
+bool surgescript_vm_save_bytecode(surgescript_vm_t* vm, const char* absolute_path); /* saves the compiled scripts to a file (.ssc) */
 
 /* VM lifecycle */
 bool surgescript_vm_is_active(surgescript_vm_t* vm); /* is the vm active? (i.e., turned on) */
 void surgescript_vm_launch(surgescript_vm_t* vm); /* boots up the vm */
 void surgescript_vm_launch_ex(surgescript_vm_t* vm, int argc, char** argv); /* boots up the vm with command line arguments */
+void surgescript_vm_srand(surgescript_vm_t* vm, uint64_t seed); /* seeds the pseudo-random number generator of the vm (reproducible if called before launching) */
 void surgescript_vm_terminate(surgescript_vm_t* vm); /* terminates the vm */
 bool surgescript_vm_reset(surgescript_vm_t* vm); /* resets the VM, clearing up all its programs and objects */
 bool surgescript_vm_update(surgescript_vm_t* vm); /* updates the vm */
@@ -63,6 +70,7 @@ struct surgescript_objectmanager_t* surgescript_vm_objectmanager(const surgescri
 struct surgescript_parser_t* surgescript_vm_parser(const surgescript_vm_t* vm); /* gets the parser */
 const struct surgescript_vmargs_t* surgescript_vm_args(const surgescript_vm_t* vm); /* gets the command-line arguments */
 const struct surgescript_vmtime_t* surgescript_vm_time(const surgescript_vm_t* vm); /* gets the VM time */
+struct surgescript_varpool_t* surgescript_vm_varpool(const surgescript_vm_t* vm); /* gets the pool of variables */
 
 /* utilities */
 surgescript_object_t* surgescript_vm_root_object(surgescript_vm_t* vm); /* root object */
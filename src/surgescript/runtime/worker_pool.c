@@ -0,0 +1,330 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/worker_pool.c
+ * SurgeScript Worker Pool - updates many independent VMs on multiple threads
+ */
+
+#include "worker_pool.h"
+#include "vm.h"
+#include "variable.h"
+#include "../util/util.h"
+#include "../util/ssarray.h"
+
+/* multithread support */
+#if !defined(SURGESCRIPT_DISABLE_THREADS) && !__STDC_NO_THREADS__
+#define USE_THREADS 1
+#include <threads.h>
+#else
+#define USE_THREADS 0
+#endif
+
+/* a VM of the pool */
+typedef struct surgescript_workerpool_entry_t surgescript_workerpool_entry_t;
+struct surgescript_workerpool_entry_t
+{
+    surgescript_vm_t* vm;
+    bool is_active; /* was the VM active after the last update? */
+};
+
+#if USE_THREADS
+/* a worker thread. At each frame, it updates the VMs of its own queue
+   and then steals VMs from the queues of the other workers */
+typedef struct surgescript_worker_t surgescript_worker_t;
+struct surgescript_worker_t
+{
+    surgescript_workerpool_t* pool;
+    thrd_t thread;
+    mtx_t lock; /* protects the queue */
+    SSARRAY(int, queue); /* indices of the VMs to be updated: the worker takes from the back, thieves take from the front */
+    size_t front; /* index of the front of the queue */
+};
+
+static int worker_main(void* worker);
+static inline int take_task(surgescript_worker_t* worker);
+static inline int steal_task(surgescript_worker_t* worker);
+#endif
+
+/* the worker pool */
+struct surgescript_workerpool_t
+{
+    SSARRAY(surgescript_workerpool_entry_t, entry); /* VMs */
+    int num_threads; /* number of workers */
+
+#if USE_THREADS
+    surgescript_worker_t* worker; /* worker[0 .. num_threads-1] */
+    mtx_t mutex; /* protects the fields below */
+    cnd_t frame_begin; /* signaled when a new frame begins */
+    cnd_t frame_end; /* signaled when all workers are done with the current frame (frame barrier) */
+    unsigned frame; /* frame counter */
+    int busy_workers; /* how many workers haven't finished the current frame */
+    bool quit; /* will the workers quit? */
+#endif
+};
+
+
+
+/*
+ * surgescript_workerpool_create()
+ * Creates a pool with num_threads worker threads (if zero, one per CPU core)
+ */
+surgescript_workerpool_t* surgescript_workerpool_create(int num_threads)
+{
+    surgescript_workerpool_t* pool = ssmalloc(sizeof *pool);
+
+    ssarray_init(pool->entry);
+    pool->num_threads = (num_threads > 0) ? num_threads : surgescript_util_cpucount();
+
+#if USE_THREADS
+    sslog("Creating a worker pool with %d thread(s)...", pool->num_threads);
+    pool->frame = 0;
+    pool->busy_workers = 0;
+    pool->quit = false;
+    if(mtx_init(&pool->mutex, mtx_plain) != thrd_success || cnd_init(&pool->frame_begin) != thrd_success || cnd_init(&pool->frame_end) != thrd_success)
+        ssfatal("Can't create the worker pool: synchronization error");
+
+    pool->worker = ssmalloc(pool->num_threads * sizeof(*(pool->worker)));
+    for(int i = 0; i < pool->num_threads; i++) {
+        surgescript_worker_t* worker = &(pool->worker[i]);
+        worker->pool = pool;
+        worker->front = 0;
+        ssarray_init(worker->queue);
+        if(mtx_init(&worker->lock, mtx_plain) != thrd_success)
+            ssfatal("Can't create the worker pool: synchronization error");
+    }
+
+    for(int i = 0; i < pool->num_threads; i++) {
+        if(thrd_create(&(pool->worker[i].thread), worker_main, &(pool->worker[i])) != thrd_success)
+            ssfatal("Can't create the worker pool: unable to create a thread");
+    }
+#else
+    sslog("Warning: SurgeScript has been compiled without multithreading. The worker pool will run on a single thread.");
+    pool->num_threads = 1;
+#endif
+
+    return pool;
+}
+
+/*
+ * surgescript_workerpool_destroy()
+ * Destroys the pool, stopping its worker threads. The VMs are not destroyed.
+ */
+surgescript_workerpool_t* surgescript_workerpool_destroy(surgescript_workerpool_t* pool)
+{
+#if USE_THREADS
+    /* stop the workers */
+    mtx_lock(&pool->mutex);
+    pool->quit = true;
+    cnd_broadcast(&pool->frame_begin);
+    mtx_unlock(&pool->mutex);
+
+    for(int i = 0; i < pool->num_threads; i++)
+        thrd_join(pool->worker[i].thread, NULL);
+
+    /* release the workers */
+    for(int i = 0; i < pool->num_threads; i++) {
+        mtx_destroy(&(pool->worker[i].lock));
+        ssarray_release(pool->worker[i].queue);
+    }
+    ssfree(pool->worker);
+
+    cnd_destroy(&pool->frame_end);
+    cnd_destroy(&pool->frame_begin);
+    mtx_destroy(&pool->mutex);
+#endif
+
+    ssarray_release(pool->entry);
+    return ssfree(pool);
+}
+
+/*
+ * surgescript_workerpool_add()
+ * Adds a VM to the pool, returning its index. Don't call this during an update.
+ * The VM should have been launched. Once added, it must only be updated by the pool.
+ */
+int surgescript_workerpool_add(surgescript_workerpool_t* pool, surgescript_vm_t* vm)
+{
+    surgescript_workerpool_entry_t entry = { vm, surgescript_vm_is_active(vm) };
+    ssarray_push(pool->entry, entry);
+    return ssarray_length(pool->entry) - 1;
+}
+
+/*
+ * surgescript_workerpool_vm()
+ * The index-th VM of the pool, or NULL if there is no such VM
+ */
+surgescript_vm_t* surgescript_workerpool_vm(const surgescript_workerpool_t* pool, int index)
+{
+    if(index >= 0 && index < ssarray_length(pool->entry))
+        return pool->entry[index].vm;
+    else
+        return NULL;
+}
+
+/*
+ * surgescript_workerpool_count()
+ * Number of VMs in the pool
+ */
+int surgescript_workerpool_count(const surgescript_workerpool_t* pool)
+{
+    return ssarray_length(pool->entry);
+}
+
+/*
+ * surgescript_workerpool_update()
+ * Updates each active VM of the pool exactly once, concurrently, and waits
+ * until all of them are done (frame barrier). Returns the number of VMs that
+ * are still active after this update cycle
+ */
+int surgescript_workerpool_update(surgescript_workerpool_t* pool)
+{
+    int count = 0;
+
+#if USE_THREADS
+    /* the workers are idle; distribute the active VMs among them.
+       A VM goes to the same worker at every frame, unless it's stolen */
+    for(int i = 0; i < pool->num_threads; i++) {
+        ssarray_reset(pool->worker[i].queue);
+        pool->worker[i].front = 0;
+    }
+
+    for(int i = 0; i < ssarray_length(pool->entry); i++) {
+        if(pool->entry[i].is_active)
+            ssarray_push(pool->worker[i % pool->num_threads].queue, i);
+    }
+
+    /* begin a new frame and wait for the workers */
+    mtx_lock(&pool->mutex);
+    pool->busy_workers = pool->num_threads;
+    pool->frame++;
+    cnd_broadcast(&pool->frame_begin);
+    while(pool->busy_workers > 0)
+        cnd_wait(&pool->frame_end, &pool->mutex);
+    mtx_unlock(&pool->mutex);
+#else
+    /* update the VMs sequentially */
+    for(int i = 0; i < ssarray_length(pool->entry); i++) {
+        if(pool->entry[i].is_active)
+            pool->entry[i].is_active = surgescript_vm_update(pool->entry[i].vm);
+    }
+#endif
+
+    /* count the active VMs */
+    for(int i = 0; i < ssarray_length(pool->entry); i++)
+        count += pool->entry[i].is_active ? 1 : 0;
+
+    /* done! */
+    return count;
+}
+
+/*
+ * surgescript_workerpool_is_active()
+ * Was the index-th VM active after the last update cycle?
+ */
+bool surgescript_workerpool_is_active(const surgescript_workerpool_t* pool, int index)
+{
+    if(index >= 0 && index < ssarray_length(pool->entry))
+        return pool->entry[index].is_active;
+    else
+        return false;
+}
+
+/*
+ * surgescript_workerpool_num_threads()
+ * Number of worker threads
+ */
+int surgescript_workerpool_num_threads(const surgescript_workerpool_t* pool)
+{
+    return pool->num_threads;
+}
+
+
+
+/* private */
+
+#if USE_THREADS
+
+/* the routine of a worker thread */
+int worker_main(void* arg)
+{
+    surgescript_worker_t* worker = (surgescript_worker_t*)arg;
+    surgescript_workerpool_t* pool = worker->pool;
+    unsigned frame = 0;
+    int index;
+
+    for(;;) {
+        /* wait for a new frame */
+        mtx_lock(&pool->mutex);
+        while(pool->frame == frame && !pool->quit)
+            cnd_wait(&pool->frame_begin, &pool->mutex);
+        if(pool->quit) {
+            mtx_unlock(&pool->mutex);
+            break;
+        }
+        frame = pool->frame;
+        mtx_unlock(&pool->mutex);
+
+        /* update my VMs, and then the VMs of the other workers */
+        while((index = take_task(worker)) >= 0 || (index = steal_task(worker)) >= 0) {
+            surgescript_workerpool_entry_t* entry = &(pool->entry[index]);
+            entry->is_active = surgescript_vm_update(entry->vm);
+        }
+
+        /* frame barrier */
+        mtx_lock(&pool->mutex);
+        if(--pool->busy_workers == 0)
+            cnd_signal(&pool->frame_end);
+        mtx_unlock(&pool->mutex);
+    }
+
+    /* release the default pool of variables of this thread, if it has been created */
+    surgescript_var_release_pool();
+    return 0;
+}
+
+/* takes a VM from the back of the queue of the worker; returns -1 if there is none */
+int take_task(surgescript_worker_t* worker)
+{
+    int index = -1;
+
+    mtx_lock(&worker->lock);
+    if(ssarray_length(worker->queue) > worker->front)
+        ssarray_pop(worker->queue, index);
+    mtx_unlock(&worker->lock);
+
+    return index;
+}
+
+/* steals a VM from the front of the queue of another worker; returns -1 if there is none */
+int steal_task(surgescript_worker_t* worker)
+{
+    surgescript_workerpool_t* pool = worker->pool;
+    int me = worker - pool->worker;
+    int index = -1;
+
+    for(int i = 1; i < pool->num_threads && index < 0; i++) {
+        surgescript_worker_t* victim = &(pool->worker[(me + i) % pool->num_threads]);
+        mtx_lock(&victim->lock);
+        if(ssarray_length(victim->queue) > victim->front)
+            index = victim->queue[victim->front++];
+        mtx_unlock(&victim->lock);
+    }
+
+    return index;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * runtime/worker_pool.h
+ * SurgeScript Worker Pool - updates many independent VMs on multiple threads
+ */
+
+#ifndef _SURGESCRIPT_RUNTIME_WORKER_POOL_H
+#define _SURGESCRIPT_RUNTIME_WORKER_POOL_H
+
+#include <stdbool.h>
+
+typedef struct surgescript_workerpool_t surgescript_workerpool_t;
+struct surgescript_vm_t;
+
+/* create & destroy */
+surgescript_workerpool_t* surgescript_workerpool_create(int num_threads); /* create a pool with num_threads worker threads (0 = one per CPU core) */
+surgescript_workerpool_t* surgescript_workerpool_destroy(surgescript_workerpool_t* pool); /* destroy the pool (the VMs are not destroyed) */
+
+/* VMs */
+int surgescript_workerpool_add(surgescript_workerpool_t* pool, struct surgescript_vm_t* vm); /* add a launched VM to the pool; returns its index */
+struct surgescript_vm_t* surgescript_workerpool_vm(const surgescript_workerpool_t* pool, int index); /* the index-th VM of the pool */
+int surgescript_workerpool_count(const surgescript_workerpool_t* pool); /* number of VMs in the pool */
+
+/* update */
+int surgescript_workerpool_update(surgescript_workerpool_t* pool); /* update each active VM once (a frame); returns the number of VMs that are still active */
+bool surgescript_workerpool_is_active(const surgescript_workerpool_t* pool, int index); /* was the index-th VM active after the last update? */
+int surgescript_workerpool_num_threads(const surgescript_workerpool_t* pool); /* number of worker threads */
+
+#endif
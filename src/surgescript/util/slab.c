@@ -0,0 +1,184 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * util/slab.c
+ * SurgeScript slab allocator: blocks of memory of a few size classes
+ */
+
+#include "slab.h"
+#include "ssarray.h"
+#include "util.h"
+
+/*
+ * Blocks are carved out of large chunks of memory. The size of a block is
+ * rounded up to a power of two (its size class), and freed blocks are kept
+ * in a free list of their size class, to be reused by the next allocation
+ * of that class. Chunks are only released when the slab is destroyed.
+ * Blocks larger than the largest size class go to the system allocator.
+ */
+
+/* slab config */
+/*#define DISABLE_SLABS*/
+#define SLAB_MIN_SHIFT 4 /* the smallest class has 16 bytes */
+#define SLAB_NUM_CLASSES 9 /* the largest class has 4096 bytes */
+#define SLAB_MAX_SIZE ((size_t)1 << (SLAB_MIN_SHIFT + SLAB_NUM_CLASSES - 1))
+#define SLAB_CHUNK_SIZE ((size_t)65536) /* 64 KB */
+
+/* a free block */
+typedef struct surgescript_slabblock_t surgescript_slabblock_t;
+struct surgescript_slabblock_t
+{
+    surgescript_slabblock_t* next; /* free list */
+};
+
+/* slab structure */
+struct surgescript_slab_t
+{
+    surgescript_slabblock_t* free[SLAB_NUM_CLASSES]; /* free lists of the size classes */
+    SSARRAY(char*, chunk); /* chunks of memory */
+    char* cursor; /* the unused part of the last chunk */
+    size_t remaining; /* bytes left at cursor */
+};
+
+static inline int size_class(size_t size);
+
+
+/* -------------------------------
+ * public methods
+ * ------------------------------- */
+
+/*
+ * surgescript_slab_create()
+ * Creates a slab allocator. It's not thread-safe
+ */
+surgescript_slab_t* surgescript_slab_create()
+{
+    surgescript_slab_t* slab = ssmalloc(sizeof *slab);
+
+    for(int i = 0; i < SLAB_NUM_CLASSES; i++)
+        slab->free[i] = NULL;
+
+    ssarray_init(slab->chunk);
+    slab->cursor = NULL;
+    slab->remaining = 0;
+
+    return slab;
+}
+
+/*
+ * surgescript_slab_destroy()
+ * Destroys a slab allocator. The blocks allocated from it, except the
+ * ones larger than the largest size class, must no longer be used
+ */
+surgescript_slab_t* surgescript_slab_destroy(surgescript_slab_t* slab)
+{
+    for(int i = 0; i < ssarray_length(slab->chunk); i++)
+        ssfree(slab->chunk[i]);
+
+    ssarray_release(slab->chunk);
+    return ssfree(slab);
+}
+
+/*
+ * surgescript_slab_alloc()
+ * Allocates a block of size bytes
+ */
+void* surgescript_slab_alloc(surgescript_slab_t* slab, size_t size)
+{
+#ifndef DISABLE_SLABS
+    size_t block_size;
+    void* block;
+    int k;
+
+    /* large block? */
+    if(size > SLAB_MAX_SIZE)
+        return ssmalloc(size);
+
+    /* find the size class */
+    k = size_class(size);
+    block_size = (size_t)1 << (SLAB_MIN_SHIFT + k);
+
+    /* reuse a free block of the same size class */
+    if(slab->free[k] != NULL) {
+        block = slab->free[k];
+        slab->free[k] = slab->free[k]->next;
+        return block;
+    }
+
+    /* carve a new block out of the last chunk */
+    if(slab->remaining < block_size) {
+        slab->cursor = ssmalloc(SLAB_CHUNK_SIZE);
+        slab->remaining = SLAB_CHUNK_SIZE;
+        ssarray_push(slab->chunk, slab->cursor);
+    }
+
+    block = slab->cursor;
+    slab->cursor += block_size;
+    slab->remaining -= block_size;
+    return block;
+#else
+    (void)slab;
+    return ssmalloc(size);
+#endif
+}
+
+/*
+ * surgescript_slab_free()
+ * Deallocates a block of size bytes. The size must be the one that
+ * was requested when the block was allocated
+ */
+void* surgescript_slab_free(surgescript_slab_t* slab, void* ptr, size_t size)
+{
+#ifndef DISABLE_SLABS
+    surgescript_slabblock_t* block = (surgescript_slabblock_t*)ptr;
+    int k;
+
+    if(ptr == NULL)
+        return NULL;
+
+    /* large block? */
+    if(size > SLAB_MAX_SIZE)
+        return ssfree(ptr);
+
+    /* put the block in the free list of its size class */
+    k = size_class(size);
+    block->next = slab->free[k];
+    slab->free[k] = block;
+    return NULL;
+#else
+    (void)slab;
+    (void)size;
+    return ssfree(ptr);
+#endif
+}
+
+
+
+/* -------------------------------
+ * private methods
+ * ------------------------------- */
+
+/* the size class of a block of size bytes (size <= SLAB_MAX_SIZE) */
+int size_class(size_t size)
+{
+    int k = 0;
+
+    while(((size_t)1 << (SLAB_MIN_SHIFT + k)) < size)
+        k++;
+
+    return k;
+}
@@ -0,0 +1,37 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2022  Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * util/slab.h
+ * SurgeScript slab allocator: blocks of memory of a few size classes
+ */
+
+#ifndef _SURGESCRIPT_SLAB_H
+#define _SURGESCRIPT_SLAB_H
+
+#include <stdlib.h>
+
+/* types */
+typedef struct surgescript_slab_t surgescript_slab_t;
+struct surgescript_slab_t;
+
+/* public methods */
+surgescript_slab_t* surgescript_slab_create(); /* creates a slab allocator (not thread-safe) */
+surgescript_slab_t* surgescript_slab_destroy(surgescript_slab_t* slab); /* destroys a slab allocator and the memory of all blocks allocated from it */
+void* surgescript_slab_alloc(surgescript_slab_t* slab, size_t size); /* allocates a block of size bytes */
+void* surgescript_slab_free(surgescript_slab_t* slab, void* ptr, size_t size); /* deallocates a block of size bytes; returns NULL */
+
+#endif
@@ -69,6 +69,12 @@
  */
 #define ssarray_length(arr)                   (arr##_len)
 
+/*
+ * ssarray_truncate()
+ * shrinks the array to the given length, without freeing anything
+ */
+#define ssarray_truncate(arr, length)         (arr##_len = ssmin(arr##_len, (size_t)(length)))
+
 /*
  * ssarray_reset()
  * sets the length of the array to zero, without freeing anything
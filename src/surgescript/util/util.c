@@ -19,6 +19,10 @@
  * SurgeScript utilities
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* pthread_getattr_np() */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -32,14 +36,26 @@
 #include <wchar.h>
 #else
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#if defined(__APPLE__) || (defined(__GLIBC__) && !defined(SURGESCRIPT_DISABLE_THREADS))
+#include <pthread.h>
 #endif
 
 /* private stuff */
+#if defined(_WIN32)
+static wchar_t* to_wide(const char* utf8);
+#endif
 static void mem_crash(const char* file, int line);
 static void my_log(const char* message);
 static void my_fatal(const char* message);
 static void (*log_function)(const char* message) = my_log;
 static void (*fatal_function)(const char* message) = my_fatal;
+static surgescript_prng_t* default_prng();
+static uintptr_t stack_limit();
 
 
 
@@ -294,40 +310,104 @@ uint64_t surgescript_util_gettickcount()
 #endif
 }
 
+/*
+ * surgescript_util_cpucount()
+ * The number of CPU cores of the machine (at least 1)
+ * This is a system-specific routine
+ */
+int surgescript_util_cpucount()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return ssmax(1, (int)info.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return ssmax(1, (int)count);
+#else
+    return 1;
+#endif
+}
+
+/*
+ * surgescript_util_stackoverflow()
+ * Checks if the native stack of the calling thread is about to overflow
+ * This is a system-specific routine; it returns false if it can't tell
+ */
+bool surgescript_util_stackoverflow()
+{
+    static SS_THREADLOCAL uintptr_t limit = 0;
+    static SS_THREADLOCAL bool has_limit = false;
+    char here;
+
+    if(!has_limit) {
+        limit = stack_limit();
+        has_limit = true;
+    }
+
+    return (uintptr_t)&here < limit;
+}
+
 /*
  * surgescript_util_srand()
- * Sets the seed of the pseudo-random number generator
+ * Sets the seed of the default pseudo-random number generator of the calling thread
  */
 void surgescript_util_srand(uint64_t seed)
+{
+    surgescript_util_prng_seed(default_prng(), seed);
+}
+
+/*
+ * surgescript_util_random64()
+ * Generates a pseudo-random 64-bit unsigned integer using the default generator of the calling thread
+ */
+uint64_t surgescript_util_random64()
+{
+    return surgescript_util_prng_random64(default_prng());
+}
+
+/*
+ * surgescript_util_random()
+ * Generates a pseudo-random double in the [0,1) range using the default generator of the calling thread
+ */
+double surgescript_util_random()
+{
+    return surgescript_util_prng_random(default_prng());
+}
+
+/*
+ * surgescript_util_prng_seed()
+ * Sets the seed of a pseudo-random number generator
+ */
+void surgescript_util_prng_seed(surgescript_prng_t* prng, uint64_t seed)
 {
     /* using splitmix64 to seed the generator */
-    extern uint64_t* xor_seed;
     for(int i = 0; i <= 1; i++) {
         uint64_t x = (seed += UINT64_C(0x9e3779b97f4a7c15));
         x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
         x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
-        xor_seed[i] = x ^ (x >> 31);
+        prng->state[i] = x ^ (x >> 31);
     }
 }
 
 /*
- * surgescript_util_random64()
- * Generates a pseudo-random 64-bit unsigned integer
+ * surgescript_util_prng_random64()
+ * Generates a pseudo-random 64-bit unsigned integer using the given generator
  */
-uint64_t surgescript_util_random64()
+uint64_t surgescript_util_prng_random64(surgescript_prng_t* prng)
 {
-    extern uint64_t (*xor_next)(void);
-    return xor_next();
+    extern uint64_t (*xor_next)(uint64_t*);
+    return xor_next(prng->state);
 }
 
 /*
- * surgescript_util_random()
- * Generates a pseudo-random double in the [0,1) range
+ * surgescript_util_prng_random()
+ * Generates a pseudo-random double in the [0,1) range using the given generator
  */
-double surgescript_util_random()
+double surgescript_util_prng_random(surgescript_prng_t* prng)
 {
     /* assuming IEEE-754 */
-    uint64_t x = surgescript_util_random64();
+    uint64_t x = surgescript_util_prng_random64(prng);
     x = (x >> 12) | UINT64_C(0x3FF0000000000000); /* sign bit = 0; exponent = 1023 */
     return *((double*)&x) - 1.0;
 }
@@ -365,6 +445,51 @@ FILE* surgescript_util_fopen_utf8(const char* filepath, const char* mode)
 #endif
 }
 
+/*
+ * surgescript_util_mkdir_utf8()
+ * Creates a directory (UTF-8 path), unless it already exists.
+ * Returns true if the directory exists after the call
+ */
+bool surgescript_util_mkdir_utf8(const char* dirpath)
+{
+#if defined(_WIN32)
+    wchar_t* wpath = to_wide(dirpath);
+    bool success = false;
+
+    if(wpath != NULL) {
+        success = CreateDirectoryW(wpath, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+        ssfree(wpath);
+    }
+
+    return success;
+#else
+    return mkdir(dirpath, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+/*
+ * surgescript_util_rename_utf8()
+ * Renames a file (UTF-8 paths), replacing the destination if it exists.
+ * Returns true on success
+ */
+bool surgescript_util_rename_utf8(const char* old_filepath, const char* new_filepath)
+{
+#if defined(_WIN32)
+    wchar_t* wold = to_wide(old_filepath);
+    wchar_t* wnew = to_wide(new_filepath);
+    bool success = (wold != NULL && wnew != NULL && MoveFileExW(wold, wnew, MOVEFILE_REPLACE_EXISTING));
+
+    if(wnew != NULL)
+        ssfree(wnew);
+    if(wold != NULL)
+        ssfree(wold);
+
+    return success;
+#else
+    return rename(old_filepath, new_filepath) == 0;
+#endif
+}
+
 /* -------------------------------
  * private methods
  * ------------------------------- */
@@ -387,4 +512,69 @@ void mem_crash(const char* file, int line) /* out of memory error */
     fatal_function(buf);
 
     exit(1); /* just in case */
-}
\ No newline at end of file
+}
+
+/* the default pseudo-random number generator of the calling thread, seeded on first use */
+surgescript_prng_t* default_prng()
+{
+    static SS_THREADLOCAL surgescript_prng_t prng = { { 0, 0 } };
+
+    if(!(prng.state[0] | prng.state[1]))
+        surgescript_util_prng_seed(&prng, (uint64_t)time(NULL));
+
+    return &prng;
+}
+
+/* the lowest address of the native stack of the calling thread we let the calls reach, or 0 if unknown */
+uintptr_t stack_limit()
+{
+    const size_t margin = 256 * 1024; /* leave room for native code */
+    uintptr_t low = 0, high = 0;
+    char here;
+
+#if defined(_WIN32)
+    MEMORY_BASIC_INFORMATION info;
+    if(VirtualQuery(&here, &info, sizeof(info)) != 0) {
+        low = (uintptr_t)info.AllocationBase;
+        high = (uintptr_t)&here;
+    }
+#elif defined(__APPLE__)
+    pthread_t self = pthread_self();
+    high = (uintptr_t)pthread_get_stackaddr_np(self);
+    low = high - (uintptr_t)pthread_get_stacksize_np(self);
+#elif defined(__GLIBC__) && !defined(SURGESCRIPT_DISABLE_THREADS)
+    pthread_attr_t attr;
+    void* addr = NULL;
+    size_t size = 0;
+    if(pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if(pthread_attr_getstack(&attr, &addr, &size) == 0) {
+            low = (uintptr_t)addr;
+            high = low + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+#else
+    (void)here;
+#endif
+
+    /* small stacks get a proportional margin */
+    if(low >= high)
+        return 0;
+    return low + ssmin(margin, (high - low) / 4);
+}
+
+#if defined(_WIN32)
+/* converts a UTF-8 string to a newly allocated wide string; returns NULL on error */
+wchar_t* to_wide(const char* utf8)
+{
+    int size = MultiByteToWideChar(CP_UTF8, 0, utf8, -1, NULL, 0);
+    wchar_t* wstr = NULL;
+
+    if(size > 0) {
+        wstr = ssmalloc(size * sizeof(*wstr));
+        MultiByteToWideChar(CP_UTF8, 0, utf8, -1, wstr, size);
+    }
+
+    return wstr;
+}
+#endif
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 /* macros */
 #define ssmin(a, b)                 ((a) < (b) ? (a) : (b))
@@ -43,9 +44,37 @@
 #define ssfatal                     surgescript_util_fatal
 #define ssstrdup(str)               surgescript_util_strdup((str), __FILE__, __LINE__)
 
+/* thread-local storage */
+#if defined(_MSC_VER)
+#define SS_THREADLOCAL              __declspec(thread)
+#else
+#define SS_THREADLOCAL              _Thread_local
+#endif
+
+/* reference counters that may be shared among threads */
+#if !defined(SURGESCRIPT_DISABLE_THREADS) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_int ssrefcount_t;
+#define ssrefcount_init(r, n)       atomic_init(&(r), (n))
+#define ssrefcount_get(r)           atomic_load(&(r))
+#define ssrefcount_inc(r)           atomic_fetch_add(&(r), 1)
+#define ssrefcount_dec(r)           (atomic_fetch_sub(&(r), 1) - 1) /* returns the new count */
+#else
+typedef int ssrefcount_t;
+#define ssrefcount_init(r, n)       ((r) = (n))
+#define ssrefcount_get(r)           (r)
+#define ssrefcount_inc(r)           ((r)++)
+#define ssrefcount_dec(r)           (--(r))
+#endif
+
 /* constants */
 #define SS_NAMEMAX                  63 /* names can't be larger than this (computes hashes quickly) */
 
+/* pseudo-random number generator (xoroshiro128+) */
+typedef struct surgescript_prng_t {
+    uint64_t state[2];
+} surgescript_prng_t;
+
 /* public routines */
 int surgescript_util_versioncode(const char* version); /* converts a version string to a comparable number */
 const char* surgescript_util_version(); /* compiled version of SurgeScript */
@@ -69,11 +98,19 @@ char* surgescript_util_accessorfun(const char* prefix, const char* text); /* get
 unsigned surgescript_util_htob(unsigned x); /* host to big-endian */
 unsigned surgescript_util_btoh(unsigned x); /* big to host-endian */
 uint64_t surgescript_util_gettickcount(); /* number of milliseconds since some arbitrary zero */
+int surgescript_util_cpucount(); /* number of CPU cores */
+bool surgescript_util_stackoverflow(); /* is the native stack of the calling thread about to overflow? */
+
+void surgescript_util_srand(uint64_t seed); /* sets the seed of the default pseudo-random number generator of the calling thread */
+uint64_t surgescript_util_random64(); /* generates a pseudo-random 64-bit unsigned integer using the default generator of the calling thread */
+double surgescript_util_random(); /* generates a pseudo-random double in the [0,1) range using the default generator of the calling thread */
 
-void surgescript_util_srand(uint64_t seed); /* sets the seed of the pseudo-random number generator */
-uint64_t surgescript_util_random64(); /* generates a pseudo-random 64-bit unsigned integer */
-double surgescript_util_random(); /* generates a pseudo-random double in the [0,1) range */
+void surgescript_util_prng_seed(surgescript_prng_t* prng, uint64_t seed); /* sets the seed of a pseudo-random number generator */
+uint64_t surgescript_util_prng_random64(surgescript_prng_t* prng); /* generates a pseudo-random 64-bit unsigned integer using the given generator */
+double surgescript_util_prng_random(surgescript_prng_t* prng); /* generates a pseudo-random double in the [0,1) range using the given generator */
 
 FILE* surgescript_util_fopen_utf8(const char* filepath, const char* mode); /* fopen() with UTF-8 support for filenames */
+bool surgescript_util_mkdir_utf8(const char* dirpath); /* creates a directory, unless it exists; returns true if it exists afterwards */
+bool surgescript_util_rename_utf8(const char* old_filepath, const char* new_filepath); /* renames a file, replacing the destination */
 
 #endif
@@ -36,10 +36,9 @@ static inline uint64_t rotl(const uint64_t x, int k) {
 }
 
 
-static uint64_t s[2];
+/* the state s is given by the caller, so that each VM has its own generator */
 
-
-uint64_t next(void) {
+uint64_t next(uint64_t* s) {
 	const uint64_t s0 = s[0];
 	uint64_t s1 = s[1];
 	const uint64_t result = s0 + s1;
@@ -56,7 +55,7 @@ uint64_t next(void) {
    to 2^64 calls to next(); it can be used to generate 2^64
    non-overlapping subsequences for parallel computations. */
 
-void jump(void) {
+void jump(uint64_t* s) {
 	static const uint64_t JUMP[] = { 0xdf900294d8f554a5, 0x170865df4b3201fc };
 
 	uint64_t s0 = 0;
@@ -67,7 +66,7 @@ void jump(void) {
 				s0 ^= s[0];
 				s1 ^= s[1];
 			}
-			next();
+			next(s);
 		}
 
 	s[0] = s0;
@@ -80,7 +79,7 @@ void jump(void) {
    from each of which jump() will generate 2^32 non-overlapping
    subsequences for parallel distributed computations. */
 
-void long_jump(void) {
+void long_jump(uint64_t* s) {
 	static const uint64_t LONG_JUMP[] = { 0xd2a98b26625eee7b, 0xdddf9b1090aa7ac1 };
 
 	uint64_t s0 = 0;
@@ -91,12 +90,11 @@ void long_jump(void) {
 				s0 ^= s[0];
 				s1 ^= s[1];
 			}
-			next();
+			next(s);
 		}
 
 	s[0] = s0;
 	s[1] = s1;
 }
 
-uint64_t* xor_seed = s;
-uint64_t (*xor_next)(void) = next;
\ No newline at end of file
+uint64_t (*xor_next)(uint64_t*) = next;
\ No newline at end of file
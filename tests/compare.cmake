@@ -0,0 +1,65 @@
+# ------------------------------------------------------------------------------
+# SurgeScript
+# Runs a program in different ways and checks that its output is always the
+# same as when it's compiled from source, in a single thread
+#
+# Usage:
+# cmake -DSURGESCRIPT=<cli> -DWORK_DIR=<dir> -DMODE=<mode> -DSCRIPTS=<list> -P compare.cmake
+#
+# Modes:
+# bytecode    compiles the scripts to a .ssc file and runs it
+# cache       runs the scripts twice with a compile cache, then checks that
+#             the second run didn't compile anything
+# batch       compiles the scripts in parallel
+# ------------------------------------------------------------------------------
+
+# Runs the CLI, failing if it fails
+function(run_surgescript output_var)
+    execute_process(
+        COMMAND "${SURGESCRIPT}" ${ARGN}
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE error
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "surgescript ${ARGN} has failed (${result}):\n${output}${error}")
+    endif()
+    set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+# Compares two outputs
+function(expect_same_output expected actual description)
+    if(NOT expected STREQUAL actual)
+        message(FATAL_ERROR "${description} has changed the output. Expected:\n${expected}\nGot:\n${actual}")
+    endif()
+endfunction()
+
+# Run from source
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+run_surgescript(expected -j 1 ${SCRIPTS})
+
+# Run in another way
+if(MODE STREQUAL "bytecode")
+    run_surgescript(ignored -c "${WORK_DIR}/program.ssc" ${SCRIPTS})
+    run_surgescript(output "${WORK_DIR}/program.ssc")
+    expect_same_output("${expected}" "${output}" "Loading the bytecode")
+elseif(MODE STREQUAL "cache")
+    run_surgescript(output -C "${WORK_DIR}/cache" ${SCRIPTS})
+    expect_same_output("${expected}" "${output}" "Filling the compile cache")
+    run_surgescript(output -C "${WORK_DIR}/cache" ${SCRIPTS})
+    expect_same_output("${expected}" "${output}" "Reading the compile cache")
+    run_surgescript(log -D -C "${WORK_DIR}/cache" ${SCRIPTS})
+    foreach(script ${SCRIPTS})
+        get_filename_component(filename "${script}" NAME)
+        string(FIND "${log}" "Loaded ${filename} from the compile cache" position)
+        if(position EQUAL -1)
+            message(FATAL_ERROR "${filename} hasn't been loaded from the compile cache:\n${log}")
+        endif()
+    endforeach()
+elseif(MODE STREQUAL "batch")
+    run_surgescript(output -j 4 ${SCRIPTS})
+    expect_same_output("${expected}" "${output}" "Compiling in parallel")
+else()
+    message(FATAL_ERROR "Unknown mode: ${MODE}")
+endif()
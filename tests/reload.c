@@ -0,0 +1,70 @@
+/*
+ * SurgeScript
+ * A scripting language for games
+ * Copyright 2016-2022 Alexandre Martins <alemartf(at)gmail(dot)com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * tests/reload.c
+ * Hot reload test: runs a script for a few frames, replaces its code with
+ * the code of another script and runs it until it exits. The new code
+ * checks that the objects kept their state and their variables
+ */
+
+#include <stdio.h>
+#include <surgescript.h>
+
+#define FRAMES_BEFORE_RELOAD 4
+#define MAX_FRAMES 100
+
+int main(int argc, char* argv[])
+{
+    surgescript_vm_t* vm;
+    int frames = 0;
+
+    if(argc != 3) {
+        fprintf(stderr, "Usage: %s <before.ss> <after.ss>\n", argv[0]);
+        return 1;
+    }
+
+    vm = surgescript_vm_create();
+    if(!surgescript_vm_compile(vm, argv[1])) {
+        fprintf(stderr, "Can't compile %s\n", argv[1]);
+        return 1;
+    }
+
+    surgescript_vm_launch(vm);
+    while(frames < FRAMES_BEFORE_RELOAD && surgescript_vm_update(vm))
+        frames++;
+
+    if(frames < FRAMES_BEFORE_RELOAD) {
+        fprintf(stderr, "The script exited before the reload\n");
+        return 1;
+    }
+
+    if(!surgescript_vm_reload(vm, argv[2])) {
+        fprintf(stderr, "Can't reload %s\n", argv[2]);
+        return 1;
+    }
+
+    while(frames < MAX_FRAMES && surgescript_vm_update(vm))
+        frames++;
+
+    if(frames == MAX_FRAMES) {
+        fprintf(stderr, "The script didn't exit after the reload\n");
+        return 1;
+    }
+
+    surgescript_vm_destroy(vm);
+    return 0;
+}